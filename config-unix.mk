@@ -30,6 +30,7 @@ CPPFLAGS += -D_FILE_OFFSET_BITS=64
 OBJS += src/unix/core.o
 OBJS += src/unix/dl.o
 OBJS += src/unix/fs.o
+OBJS += src/unix/getaddrinfo.o
 OBJS += src/unix/cares.o
 OBJS += src/unix/udp.o
 OBJS += src/unix/error.o
@@ -38,6 +39,9 @@ OBJS += src/unix/tcp.o
 OBJS += src/unix/pipe.o
 OBJS += src/unix/tty.o
 OBJS += src/unix/stream.o
+OBJS += src/unix/io.o
+OBJS += src/unix/post.o
+OBJS += src/unix/threadpool.o
 
 ifeq (SunOS,$(uname_S))
 EV_CONFIG=config_sunos.h
@@ -132,6 +136,9 @@ EIO_CPPFLAGS += $(CPPFLAGS)
 EIO_CPPFLAGS += -DEIO_CONFIG_H=\"$(EIO_CONFIG)\"
 EIO_CPPFLAGS += -DEIO_STACKSIZE=262144
 EIO_CPPFLAGS += -D_GNU_SOURCE
+# Call the finish callback of cancelled requests too, uv_cancel() reports
+# UV_ECANCELED from it and drops the loop ref there.
+EIO_CPPFLAGS += -D'EIO_FINISH(req)=((req)->finish ? (req)->finish (req) : 0)'
 
 src/unix/eio/eio.o: src/unix/eio/eio.c
 	$(CC) $(EIO_CPPFLAGS) $(CFLAGS) -c src/unix/eio/eio.c -o src/unix/eio/eio.o
@@ -190,6 +190,7 @@ extern "C" {
 #define ARES_FLAG_NOSEARCH      (1 << 5)
 #define ARES_FLAG_NOALIASES     (1 << 6)
 #define ARES_FLAG_NOCHECKRESP   (1 << 7)
+#define ARES_FLAG_COALESCE      (1 << 8)
 
 /* Option mask values */
 #define ARES_OPT_FLAGS          (1 << 0)
@@ -533,6 +534,24 @@ CARES_EXTERN int ares_parse_aaaa_reply(const unsigned char *abuf,
                                        struct ares_addr6ttl *addrttls,
                                        int *naddrttls);
 
+/*
+** Like ares_parse_a_reply() (family AF_INET) and ares_parse_aaaa_reply()
+** (family AF_INET6), but the hostent, its names, its addresses and their
+** TTLs are laid out in a single block. The block is written to buf when it
+** fits in buflen bytes (buf must be suitably aligned for a struct hostent);
+** otherwise it is allocated with one malloc() and the caller releases it
+** with free() when *host != buf. If ttls is nonnull, *ttls points at the
+** TTL of each address in h_addr_list, within the same block.
+*/
+
+CARES_EXTERN int ares_parse_hostent_reply(const unsigned char *abuf,
+                                          int alen,
+                                          int family,
+                                          void *buf,
+                                          size_t buflen,
+                                          struct hostent **host,
+                                          int **ttls);
+
 CARES_EXTERN int ares_parse_ptr_reply(const unsigned char *abuf,
                                       int alen,
                                       const void *addr,
@@ -34,6 +34,8 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <termios.h>
+#include <dirent.h>
+#include <sys/stat.h>
 
 /* Note: May be cast to struct iovec. See writev(2). */
 typedef struct {
@@ -43,6 +45,35 @@ typedef struct {
 
 typedef int uv_file;
 
+typedef struct stat uv_statbuf_t;
+
+/* A unit of work for the thread pool. See src/unix/threadpool.c. */
+struct uv__work {
+  void (*work)(struct uv__work* w);
+  void (*done)(struct uv__work* w, int status);
+  struct uv_loop_s* loop;
+  void* worker;
+  ngx_queue_t wq;
+  struct uv__work* next_done;
+  int lane;
+  int in_flight; /* From submission until done is called. */
+  /* Work that may outlive its loop, see uv__work_detach(). */
+  void (*orphan)(struct uv__work* w);
+  int orphaned;
+};
+
+/* Per-loop admission state of a thread pool lane, indexed by uv_lane_t. */
+struct uv__lane {
+  unsigned int limit;
+  unsigned int active;
+  ngx_queue_t queue;
+};
+
+#define UV__LANES 3
+
+/* The limit of a lane that uv_lane_set_limit() hasn't been called for. */
+#define UV__LANE_LIMIT_DEFAULT ((unsigned int) -1)
+
 /* Platform-specific definitions for uv_dlopen support. */
 typedef void* uv_lib_t;
 #define UV_DYNAMIC /* empty */
@@ -50,12 +81,26 @@ typedef void* uv_lib_t;
 #define UV_LOOP_PRIVATE_FIELDS \
   ares_channel channel; \
   /* \
-   * While the channel is active this timer is called once per second to be \
-   * sure that we're always calling ares_process. See the warning above the \
-   * definition of ares_timeout(). \
+   * Re-armed from ares_timeout() by ares_prepare on every loop iteration \
+   * while c-ares has sockets open, so that it fires exactly when the next \
+   * query times out. \
    */ \
   ev_timer timer; \
-  struct ev_loop* ev;
+  ev_prepare ares_prepare; \
+  struct ev_loop* ev; \
+  /* Requests posted from other threads, newest first. See uv_post(). */ \
+  uv_post_t* volatile post_head; \
+  ev_async post_watcher; \
+  /* Thread pool work that has run, newest first. */ \
+  struct uv__work* volatile work_done_head; \
+  ev_async work_watcher; \
+  struct uv__lane lanes[UV__LANES]; \
+  /* uv_getaddrinfo() lookups in flight and cached answers. */ \
+  struct uv__gai* gai; \
+  /* uv_fs_read()s done on the loop thread, their callbacks not yet run. */ \
+  ngx_queue_t fs_inline_queue; \
+  ev_prepare fs_inline_prepare; \
+  ev_idle fs_inline_idle;
 
 #define UV_REQ_BUFSML_SIZE (4)
 
@@ -67,10 +112,23 @@ typedef void* uv_lib_t;
   uv_buf_t* bufs; \
   int bufcnt; \
   int error; \
-  uv_buf_t bufsml[UV_REQ_BUFSML_SIZE];
+  uv_buf_t bufsml[UV_REQ_BUFSML_SIZE]; \
+  /* uv_write_sendfile(), sendfile_fd is -1 for other writes */ \
+  int sendfile_fd; \
+  off_t sendfile_offset; \
+  size_t sendfile_len;
 
 #define UV_SHUTDOWN_PRIVATE_FIELDS /* empty */
 
+#define UV_STREAM_PIPE_PRIVATE_FIELDS \
+  int fds[2]; /* splice(2) pipe, -1 when copying through buf */ \
+  char* buf; \
+  size_t offset; /* of the pending data in buf */ \
+  size_t pending; /* read from src but not yet written to dst */
+
+#define UV_POST_PRIVATE_FIELDS \
+  uv_post_t* next_post;
+
 #define UV_CONNECT_PRIVATE_FIELDS \
   ngx_queue_t queue;
 
@@ -108,7 +166,14 @@ typedef void* uv_lib_t;
   int delayed_error; \
   uv_connection_cb connection_cb; \
   int accepted_fd; \
-  int blocking;
+  int blocking; \
+  size_t write_low_watermark; \
+  size_t write_high_watermark; \
+  uv_watermark_cb write_pause_cb; \
+  uv_watermark_cb write_drain_cb; \
+  /* uv_stream_pipe() requests reading from and writing to this stream */ \
+  struct uv_stream_pipe_s* pipe_from; \
+  struct uv_stream_pipe_s* pipe_to;
 
 
 /* UV_TCP */
@@ -166,17 +231,63 @@ typedef void* uv_lib_t;
   char* hostname; \
   char* service; \
   struct addrinfo* res; \
-  int retcode;
+  int retcode; \
+  int cached; \
+  unsigned int hash; \
+  ngx_queue_t inflight; \
+  ngx_queue_t waiters; \
+  struct uv__work work_req;
+
+#define UV_CONNECT_NAME_PRIVATE_FIELDS \
+  uv_getaddrinfo_t getaddrinfo_req; \
+  ev_timer timer; \
+  struct addrinfo* addrinfo; \
+  /* resolved addresses in the order they are tried */ \
+  struct addrinfo** addrs; \
+  int naddrs; \
+  int next_addr; \
+  ngx_queue_t attempts; \
+  uv_err_t error;
 
 #define UV_PROCESS_PRIVATE_FIELDS \
   ev_child child_watcher;
 
 #define UV_FS_PRIVATE_FIELDS \
   struct stat statbuf; \
-  eio_req* eio;
+  eio_req* eio; \
+  /* uv_fs_readv() and uv_fs_writev() */ \
+  uv_file file; \
+  off_t offset; \
+  uv_buf_t* bufs; \
+  int nbufs; \
+  uv_buf_t bufsml[UV_REQ_BUFSML_SIZE]; \
+  /* uv_fs_batch() */ \
+  struct uv_fs_op_s* ops; \
+  int nops; \
+  /* uv_fs_mmap() and uv_fs_munmap() */ \
+  size_t length; \
+  int flags; \
+  /* uv_fs_read() that completed without the thread pool */ \
+  ngx_queue_t inline_queue;
+
+#define UV_DIR_PRIVATE_FIELDS \
+  DIR* dir; \
+  char* names; \
+  size_t names_size;
+
+#define UV_FS_WALK_PRIVATE_FIELDS \
+  char* path; \
+  int flags; \
+  unsigned int concurrency; \
+  unsigned int batch; \
+  unsigned int active; \
+  char* pending; \
+  size_t pending_len; \
+  size_t pending_size; \
+  uv_err_t error;
 
 #define UV_WORK_PRIVATE_FIELDS \
-  eio_req* eio;
+  struct uv__work work_req;
 
 #define UV_TTY_PRIVATE_FIELDS \
   struct termios orig_termios; \
@@ -137,6 +137,8 @@ typedef struct uv_buf_t {
 
 typedef int uv_file;
 
+typedef struct _stati64 uv_statbuf_t;
+
 /* Platform-specific definitions for uv_dlopen support. */
 typedef HMODULE uv_lib_t;
 #define UV_DYNAMIC FAR WINAPI
@@ -205,6 +207,9 @@ RB_HEAD(uv_timer_tree_s, uv_timer_s);
 #define UV_SHUTDOWN_PRIVATE_FIELDS        \
   /* empty */
 
+#define UV_STREAM_PIPE_PRIVATE_FIELDS     \
+  /* empty */
+
 #define UV_UDP_SEND_PRIVATE_FIELDS        \
   /* empty */
 
@@ -401,6 +406,15 @@ RB_HEAD(uv_timer_tree_s, uv_timer_s);
     };                                    \
   };
 
+#define UV_CONNECT_NAME_PRIVATE_FIELDS    \
+
+#define UV_POST_PRIVATE_FIELDS            \
+  uv_post_t* next_post;
+
+#define UV_DIR_PRIVATE_FIELDS             \
+
+#define UV_FS_WALK_PRIVATE_FIELDS         \
+
 #define UV_WORK_PRIVATE_FIELDS            \
 
 #define UV_FS_EVENT_PRIVATE_FIELDS        \
@@ -115,7 +115,8 @@ typedef enum {
   UV_EAISERVICE,
   UV_EAISOCKTYPE,
   UV_ESHUTDOWN,
-  UV_EEXIST
+  UV_EEXIST,
+  UV_ECANCELED
 } uv_err_code;
 
 typedef enum {
@@ -148,6 +149,10 @@ typedef enum {
   UV_FS,
   UV_WORK,
   UV_GETADDRINFO,
+  UV_POST,
+  UV_CONNECT_NAME,
+  UV_FS_WALK,
+  UV_STREAM_PIPE,
   UV_REQ_TYPE_PRIVATE
 } uv_req_type;
 
@@ -176,8 +181,13 @@ typedef struct uv_req_s uv_req_t;
 typedef struct uv_shutdown_s uv_shutdown_t;
 typedef struct uv_write_s uv_write_t;
 typedef struct uv_connect_s uv_connect_t;
+typedef struct uv_connect_name_s uv_connect_name_t;
+typedef struct uv_stream_pipe_s uv_stream_pipe_t;
 typedef struct uv_udp_send_s uv_udp_send_t;
+typedef struct uv_post_s uv_post_t;
 typedef struct uv_fs_s uv_fs_t;
+typedef struct uv_dir_s uv_dir_t;
+typedef struct uv_fs_walk_s uv_fs_walk_t;
 /* uv_fs_event_t is a subclass of uv_handle_t. */
 typedef struct uv_fs_event_s uv_fs_event_t;
 typedef struct uv_work_s uv_work_t;
@@ -236,13 +246,16 @@ typedef void (*uv_read_cb)(uv_stream_t* stream, ssize_t nread, uv_buf_t buf);
 typedef void (*uv_read2_cb)(uv_pipe_t* pipe, ssize_t nread, uv_buf_t buf,
     uv_handle_type pending);
 typedef void (*uv_write_cb)(uv_write_t* req, int status);
+typedef void (*uv_watermark_cb)(uv_stream_t* stream);
 typedef void (*uv_connect_cb)(uv_connect_t* req, int status);
+typedef void (*uv_connect_name_cb)(uv_connect_name_t* req, int status);
 typedef void (*uv_shutdown_cb)(uv_shutdown_t* req, int status);
 typedef void (*uv_connection_cb)(uv_stream_t* server, int status);
 typedef void (*uv_close_cb)(uv_handle_t* handle);
 typedef void (*uv_timer_cb)(uv_timer_t* handle, int status);
 /* TODO: do these really need a status argument? */
 typedef void (*uv_async_cb)(uv_async_t* handle, int status);
+typedef void (*uv_post_cb)(uv_post_t* req);
 typedef void (*uv_prepare_cb)(uv_prepare_t* handle, int status);
 typedef void (*uv_check_cb)(uv_check_t* handle, int status);
 typedef void (*uv_idle_cb)(uv_idle_t* handle, int status);
@@ -455,6 +468,62 @@ UV_EXTERN int uv_write(uv_write_t* req, uv_stream_t* handle,
 UV_EXTERN int uv_write2(uv_write_t* req, uv_stream_t* handle, uv_buf_t bufs[],
     int bufcnt, uv_stream_t* send_handle, uv_write_cb cb);
 
+/*
+ * Queues up to length bytes of in_fd, starting at offset, like a uv_write()
+ * of its contents: they go out after the writes queued before and before
+ * those queued after, count towards the write watermarks and cb is called
+ * when they are sent. The data is moved by the kernel with sendfile(2) from
+ * the loop thread whenever the stream is writable, so no thread pool thread
+ * waits on a full socket. The file position of in_fd is not changed. If
+ * the file ends before length bytes were sent the request fails with
+ * UV_EOF; what came before the end has been written to the stream.
+ */
+UV_EXTERN int uv_write_sendfile(uv_write_t* req, uv_stream_t* handle,
+    uv_file in_fd, off_t offset, size_t length, uv_write_cb cb);
+
+/*
+ * Write queue backpressure. Once stream->io.write_queue_size rises to or
+ * above `high` the pause_cb is called; once it falls back to or below `low`
+ * the drain_cb is called. Each callback fires once per crossing, so a proxy
+ * can uv_read_stop() its upstream in pause_cb and uv_read_start() it again
+ * in drain_cb. pause_cb may be called from inside uv_write().
+ *
+ * A `high` of 0 disables the watermarks. Returns -1 and sets UV_EINVAL if
+ * `low` is greater than `high`.
+ */
+UV_EXTERN int uv_write_watermarks(uv_stream_t* handle, size_t low,
+    size_t high, uv_watermark_cb pause_cb, uv_watermark_cb drain_cb);
+
+/*
+ * Forwards everything src receives to dst until src reaches EOF, like a
+ * read_cb that uv_write()s each buffer but without the copies: on Linux the
+ * data moves between the sockets inside the kernel with splice(2) through
+ * a pipe, elsewhere or for fds splice() doesn't support it goes through a
+ * buffer owned by the request. src is only read while dst accepts data, so
+ * a slow dst slows down src instead of queueing data in memory. Writes
+ * queued on dst before the call go out first.
+ *
+ * Don't read src or write to dst until cb is called. cb gets status 0 when
+ * src reached EOF, dst is left open so the caller can uv_shutdown() it, and
+ * -1 on errors of either stream, or with UV_EINTR when one of them is
+ * closed. req->nbytes counts the bytes forwarded. Both directions of a
+ * proxy can run at once with one request each.
+ */
+typedef void (*uv_stream_pipe_cb)(uv_stream_pipe_t* req, int status);
+
+/* uv_stream_pipe_t is a subclass of uv_req_t */
+struct uv_stream_pipe_s {
+  UV_REQ_FIELDS
+  uv_stream_t* src;
+  uv_stream_t* dst;
+  uv_stream_pipe_cb cb;
+  uint64_t nbytes;
+  UV_STREAM_PIPE_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_stream_pipe(uv_stream_pipe_t* req, uv_stream_t* src,
+    uv_stream_t* dst, uv_stream_pipe_cb cb);
+
 /* uv_write_t is a subclass of uv_req_t */
 struct uv_write_s {
   UV_REQ_FIELDS
@@ -849,6 +918,28 @@ UV_EXTERN int uv_async_init(uv_loop_t*, uv_async_t* async,
 UV_EXTERN int uv_async_send(uv_async_t* async);
 
 
+/*
+ * uv_post_t is a subclass of uv_req_t.
+ *
+ * Hands a callback to a loop from any thread. The loop runs the callbacks of
+ * all requests posted since its last wakeup in one batch, in the order in
+ * which they were posted. Unlike uv_async_send() nothing is coalesced: every
+ * successful uv_post() leads to exactly one callback. Use req->data to carry
+ * the payload. The request must stay valid until its callback is called.
+ *
+ * Pending posts do not keep the loop alive. Hold a reference with uv_ref()
+ * for as long as other threads may post.
+ */
+struct uv_post_s {
+  UV_REQ_FIELDS
+  uv_loop_t* loop;
+  uv_post_cb cb;
+  UV_POST_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_post(uv_loop_t* loop, uv_post_t* req, uv_post_cb cb);
+
+
 /*
  * uv_timer_t is a subclass of uv_handle_t.
  *
@@ -885,7 +976,16 @@ UV_EXTERN void uv_timer_set_repeat(uv_timer_t* timer, int64_t repeat);
 UV_EXTERN int64_t uv_timer_get_repeat(uv_timer_t* timer);
 
 
-/* c-ares integration initialize and terminate */
+/*
+ * c-ares integration initialize and terminate
+ *
+ * Unless optmask has ARES_OPT_FLAGS, the channel is created with
+ * ARES_FLAG_COALESCE: a query that is the same as one already in flight
+ * waits for that one's answer, which still carries the first query's ID.
+ * ares_gethostbyname() and friends don't mind; plain ares_send() callers
+ * that check the ID should pass ARES_OPT_FLAGS without ARES_FLAG_COALESCE.
+ * options is not modified.
+ */
 UV_EXTERN  int uv_ares_init_options(uv_loop_t*,
     ares_channel *channelptr, struct ares_options *options, int optmask);
 
@@ -924,6 +1024,52 @@ UV_EXTERN int uv_getaddrinfo(uv_loop_t*, uv_getaddrinfo_t* handle,
 
 UV_EXTERN void uv_freeaddrinfo(struct addrinfo* ai);
 
+/*
+ * Caches uv_getaddrinfo() answers on the loop, keyed by node, service and
+ * hints. getaddrinfo(3) doesn't report record TTLs, so answers are kept for
+ * ttl milliseconds and UV_ENOENT failures for negative_ttl milliseconds.
+ * For another stale milliseconds after that an expired answer is still
+ * returned while a fresh one is looked up in the background. Other errors
+ * are not cached.
+ *
+ * Hits and misses are counted in loop->counters. Passing a ttl of 0 turns
+ * the cache off and empties it.
+ */
+UV_EXTERN int uv_getaddrinfo_cache(uv_loop_t* loop, unsigned int ttl,
+    unsigned int negative_ttl, unsigned int stale);
+
+
+/*
+ * uv_connect_name_t is a subclass of uv_req_t.
+ *
+ * Resolves node and service with uv_getaddrinfo() and connects handle to
+ * whichever address answers first ("Happy Eyeballs", RFC 8305). Addresses
+ * are tried alternating between the two families, starting with the first
+ * one returned. A new attempt is started every `delay` milliseconds while
+ * the earlier ones are still pending, or right away when one fails. Once an
+ * attempt succeeds the others are closed.
+ *
+ * Passing 0 for delay uses UV_CONNECT_NAME_DELAY. handle must be initialized
+ * but not bound or connected, and must not be used until the callback runs.
+ * The callback gets status 0 when handle is connected, or -1 with the error
+ * of the last attempt that failed.
+ */
+#define UV_CONNECT_NAME_DELAY 250
+
+struct uv_connect_name_s {
+  UV_REQ_FIELDS
+  /* read-only */
+  uv_loop_t* loop;
+  uv_tcp_t* handle;
+  uv_connect_name_cb cb;
+  unsigned int delay;
+  UV_CONNECT_NAME_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_tcp_connect_name(uv_connect_name_t* req, uv_tcp_t* handle,
+    const char* node, const char* service, unsigned int delay,
+    uv_connect_name_cb cb);
+
 /* uv_spawn() options */
 typedef struct uv_process_options_s {
   uv_exit_cb exit_cb; /* Called after the process exits. */
@@ -997,6 +1143,58 @@ struct uv_work_s {
 UV_EXTERN int uv_queue_work(uv_loop_t* loop, uv_work_t* req,
     uv_work_cb work_cb, uv_after_work_cb after_work_cb);
 
+/*
+ * Thread pool lanes. Requests of one lane never queue behind those of
+ * another: uv_fs_* requests run on libeio's threads, uv_queue_work() and
+ * uv_getaddrinfo() share uv's own pool but are admitted separately.
+ */
+typedef enum {
+  UV_LANE_FS,
+  UV_LANE_WORK,
+  UV_LANE_DNS
+} uv_lane_t;
+
+/*
+ * Limits how many requests of a lane the loop keeps on the thread pool at
+ * once, the rest wait in the loop until one finishes. Use it to keep bulk
+ * work from occupying every thread. 0 means no limit.
+ *
+ * By default UV_LANE_WORK gets all but one of the pool's threads, which
+ * keeps one free for DNS, and UV_LANE_DNS has no limit. The reserve is per
+ * loop: the work of other loops can still fill the pool.
+ *
+ * UV_LANE_FS can't be limited per loop, this fails with UV_ENOTSUP. See
+ * uv_fs_set_max_parallel().
+ */
+UV_EXTERN int uv_lane_set_limit(uv_loop_t* loop, uv_lane_t lane,
+    unsigned int limit);
+
+/*
+ * Sets how many of libeio's threads run uv_fs_* requests at once (default
+ * 4). libeio has a single pool, this applies to every loop in the process.
+ */
+UV_EXTERN void uv_fs_set_max_parallel(unsigned int n);
+
+/*
+ * Cancels a pending uv_work_t, uv_fs_t or uv_getaddrinfo_t request.
+ *
+ * Only requests that no thread has picked up yet can be cancelled. The
+ * request's callback is still invoked, from the event loop, with a
+ * UV_ECANCELED error: after_work_cb sees it in uv_last_error() (which is
+ * UV_OK for work that ran), uv_fs_t callbacks get result == -1 and
+ * errorno == UV_ECANCELED and uv_getaddrinfo_t callbacks get status -1.
+ *
+ * Work and getaddrinfo requests are cancelled synchronously: -1 with
+ * UV_EBUSY means a thread is already running it or it is done. For fs
+ * requests libeio can't tell right away, 0 only means the request is
+ * marked; if a thread already started on it the callback reports the real
+ * result.
+ *
+ * Returns -1 with UV_EINVAL for any other kind of request or a request that
+ * isn't in flight.
+ */
+UV_EXTERN int uv_cancel(uv_loop_t* loop, uv_req_t* req);
+
 
 
 
@@ -1041,7 +1239,18 @@ typedef enum {
   UV_FS_SYMLINK,
   UV_FS_READLINK,
   UV_FS_CHOWN,
-  UV_FS_FCHOWN
+  UV_FS_FCHOWN,
+  UV_FS_READV,
+  UV_FS_WRITEV,
+  UV_FS_OPENDIR,
+  UV_FS_READDIR_CHUNK,
+  UV_FS_CLOSEDIR,
+  UV_FS_BATCH,
+  UV_FS_READ_FILE,
+  UV_FS_MMAP,
+  UV_FS_MUNMAP,
+  UV_FS_FADVISE,
+  UV_FS_READAHEAD
 } uv_fs_type;
 
 /* uv_fs_t is a subclass of uv_req_t */
@@ -1065,6 +1274,15 @@ UV_EXTERN int uv_fs_close(uv_loop_t* loop, uv_fs_t* req, uv_file file,
 UV_EXTERN int uv_fs_open(uv_loop_t* loop, uv_fs_t* req, const char* path,
     int flags, int mode, uv_fs_cb cb);
 
+/*
+ * On Linux an async read at an explicit offset is first tried on the loop
+ * thread with preadv2(RWF_NOWAIT), which only succeeds when the data is in
+ * the page cache. Reads that would block or come up short go to the thread
+ * pool, as do reads at the current position (offset < 0) so that they stay
+ * in order with the ones already queued there. The callback is
+ * called from the loop either way, never from within uv_fs_read().
+ * loop->counters.fs_read_inline and fs_read_offloaded count the two paths.
+ */
 UV_EXTERN int uv_fs_read(uv_loop_t* loop, uv_fs_t* req, uv_file file,
     void* buf, size_t length, off_t offset, uv_fs_cb cb);
 
@@ -1074,15 +1292,236 @@ UV_EXTERN int uv_fs_unlink(uv_loop_t* loop, uv_fs_t* req, const char* path,
 UV_EXTERN int uv_fs_write(uv_loop_t* loop, uv_fs_t* req, uv_file file,
     void* buf, size_t length, off_t offset, uv_fs_cb cb);
 
+/*
+ * Vectored uv_fs_read() and uv_fs_write(). The buffers are filled or written
+ * in order with a single preadv(2) or pwritev(2), or readv(2) and writev(2)
+ * when offset is negative. req->result is the number of bytes transferred,
+ * which may be short. The bufs array is copied but the memory it points to
+ * must stay valid until the callback.
+ */
+UV_EXTERN int uv_fs_readv(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    uv_buf_t bufs[], int nbufs, off_t offset, uv_fs_cb cb);
+
+UV_EXTERN int uv_fs_writev(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    uv_buf_t bufs[], int nbufs, off_t offset, uv_fs_cb cb);
+
+/*
+ * One step of a uv_fs_batch(). Set type and the fields it uses:
+ *
+ *   UV_FS_OPEN      path, flags, mode
+ *   UV_FS_CLOSE     file
+ *   UV_FS_READ      file, buf, offset
+ *   UV_FS_WRITE     file, buf, offset
+ *   UV_FS_FSTAT     file, statbuf receives the result
+ *   UV_FS_STAT      path, statbuf receives the result
+ *   UV_FS_FSYNC     file
+ *   UV_FS_UNLINK    path
+ *
+ * A negative file means the file opened by the latest UV_FS_OPEN of the
+ * batch, a negative offset the current file position. result and errorno
+ * are filled in like those of the equivalent uv_fs_t.
+ */
+typedef struct uv_fs_op_s {
+  uv_fs_type type;
+  const char* path;
+  int flags;
+  int mode;
+  uv_file file;
+  uv_buf_t buf;
+  off_t offset;
+  uv_statbuf_t statbuf;
+  ssize_t result;
+  int errorno;
+} uv_fs_op_t;
+
+/*
+ * Runs nops operations in order on a single thread pool thread and calls cb
+ * once, saving a thread pool round trip per operation. The batch stops at
+ * the first failing operation: req->result is -1 and the error that of the
+ * failed operation, the operations after it are not run and get errorno
+ * UV_ECANCELED, except for UV_FS_CLOSE ones so that files opened by the
+ * batch are still closed. req->result is 0 when everything succeeded. ops
+ * must stay valid until cb.
+ */
+UV_EXTERN int uv_fs_batch(uv_loop_t* loop, uv_fs_t* req, uv_fs_op_t ops[],
+    int nops, uv_fs_cb cb);
+
+/*
+ * Reads a whole file in one thread pool hop: open, fstat to size the
+ * buffer, read until EOF and close. req->ptr is the contents, followed by
+ * a NUL that is not counted in req->result, the length. The buffer is freed
+ * by uv_fs_req_cleanup().
+ */
+UV_EXTERN int uv_fs_read_file(uv_loop_t* loop, uv_fs_t* req,
+    const char* path, uv_fs_cb cb);
+
+/* uv_fs_mmap() flags. */
+#define UV_FS_MMAP_WILLNEED 0x0001 /* madvise(MADV_WILLNEED) */
+#define UV_FS_MMAP_POPULATE 0x0002 /* fault every page in */
+#define UV_FS_MMAP_LOCK     0x0004 /* mlock(), implies UV_FS_MMAP_POPULATE */
+
+/*
+ * Maps length bytes of file starting at offset, which must be a multiple of
+ * the page size, read-only and shared with the page cache. A length of 0
+ * maps the file up to its current end. req->ptr is the mapping and
+ * req->result its length; when there is nothing to map req->result is 0
+ * and req->ptr NULL. The flags prefetch on the thread pool so that the loop
+ * thread does not take the page faults later. The mapping outlives the file
+ * descriptor and the request; release it with uv_fs_munmap().
+ */
+UV_EXTERN int uv_fs_mmap(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    size_t length, off_t offset, int flags, uv_fs_cb cb);
+
+/*
+ * Unmaps a mapping made by uv_fs_mmap(). Tearing down a large mapping can
+ * take a while, hence the thread pool.
+ */
+UV_EXTERN int uv_fs_munmap(uv_loop_t* loop, uv_fs_t* req, void* addr,
+    size_t length, uv_fs_cb cb);
+
+/* uv_fs_fadvise() advice, see posix_fadvise(2). */
+typedef enum {
+  UV_FS_ADVISE_NORMAL,
+  UV_FS_ADVISE_SEQUENTIAL,
+  UV_FS_ADVISE_RANDOM,
+  UV_FS_ADVISE_WILLNEED,
+  UV_FS_ADVISE_DONTNEED,
+  UV_FS_ADVISE_NOREUSE
+} uv_fs_advice;
+
+/*
+ * Tells the kernel how length bytes of file from offset will be accessed;
+ * a length of 0 means up to the end of the file. SEQUENTIAL widens the
+ * readahead window for streaming, RANDOM turns readahead off for index
+ * files, DONTNEED drops cached pages that will not be read again.
+ * Fails with UV_ENOSYS where the platform has no posix_fadvise().
+ */
+UV_EXTERN int uv_fs_fadvise(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    off_t offset, size_t length, uv_fs_advice advice, uv_fs_cb cb);
+
+/*
+ * Reads length bytes of file from offset into the page cache without
+ * copying them anywhere, so that a later uv_fs_read() of that range does
+ * not wait for the disk. Typically issued for the next chunk while the
+ * current one is being served.
+ */
+UV_EXTERN int uv_fs_readahead(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    off_t offset, size_t length, uv_fs_cb cb);
+
 UV_EXTERN int uv_fs_mkdir(uv_loop_t* loop, uv_fs_t* req, const char* path,
     int mode, uv_fs_cb cb);
 
 UV_EXTERN int uv_fs_rmdir(uv_loop_t* loop, uv_fs_t* req, const char* path,
     uv_fs_cb cb);
 
+/*
+ * Lists the entries of a directory other than "." and "..". req->result is
+ * the number of entries and req->ptr holds their names, separated by NULs.
+ *
+ * With UV_FS_READDIR_TYPES req->ptr is an array of req->result uv_dirent_t
+ * instead, which also gives each entry's type and inode number as far as
+ * the file system reports them, so that walkers only need to stat() entries
+ * of type UV_DIRENT_UNKNOWN. UV_FS_READDIR_STAT_ORDER implies
+ * UV_FS_READDIR_TYPES and sorts the entries by inode, which is a good order
+ * for stat()ing all of them.
+ */
+#define UV_FS_READDIR_TYPES       0x0001
+#define UV_FS_READDIR_STAT_ORDER  0x0002
+
+typedef enum {
+  UV_DIRENT_UNKNOWN,
+  UV_DIRENT_FILE,
+  UV_DIRENT_DIR,
+  UV_DIRENT_LINK,
+  UV_DIRENT_FIFO,
+  UV_DIRENT_SOCKET,
+  UV_DIRENT_CHAR,
+  UV_DIRENT_BLOCK
+} uv_dirent_type_t;
+
+typedef struct uv_dirent_s {
+  const char* name;
+  uv_dirent_type_t type;
+  uint64_t ino;
+} uv_dirent_t;
+
 UV_EXTERN int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req,
     const char* path, int flags, uv_fs_cb cb);
 
+/*
+ * Streaming alternative to uv_fs_readdir() for directories too large to list
+ * in one go. uv_fs_opendir() sets req->ptr to a new uv_dir_t. Before each
+ * uv_fs_readdir_chunk() point dir->dirents at an array and set dir->nentries
+ * to its size; up to that many entries other than "." and ".." are filled in
+ * and req->result is their number, 0 once the directory is exhausted. The
+ * names live in a buffer owned by dir that is reused by the next chunk, so
+ * memory use is bounded by the chunk size rather than the directory size.
+ * uv_fs_closedir() closes the directory and frees dir.
+ */
+struct uv_dir_s {
+  uv_dirent_t* dirents;
+  unsigned int nentries;
+  UV_DIR_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_fs_opendir(uv_loop_t* loop, uv_fs_t* req,
+    const char* path, uv_fs_cb cb);
+
+UV_EXTERN int uv_fs_readdir_chunk(uv_loop_t* loop, uv_fs_t* req,
+    uv_dir_t* dir, uv_fs_cb cb);
+
+UV_EXTERN int uv_fs_closedir(uv_loop_t* loop, uv_fs_t* req, uv_dir_t* dir,
+    uv_fs_cb cb);
+
+/*
+ * Walks the tree below path on the thread pool, reading up to
+ * options->concurrency directories at once. Every directory is read in
+ * batches of up to options->batch entries and each batch is passed to
+ * entries_cb on the loop, together with the path of its directory. Entries
+ * of type UV_DIRENT_DIR are walked in turn; symlinks are not followed.
+ * Entries the file system has no type for are lstat()ed on the thread pool,
+ * with UV_FS_WALK_STAT all of them are and stats holds the results,
+ * otherwise stats is NULL. Names, dirents and stats are only valid during
+ * entries_cb.
+ *
+ * At most concurrency * batch entries are held at any time. Subdirectories
+ * that wait their turn are kept as a stack of paths, which grows with the
+ * number of directories found but not read yet. Directories that can't be
+ * read (or queued, for lack of memory) are skipped and counted in
+ * req->nerrors. cb is called
+ * once the walk is done, with status -1 if path itself couldn't be read.
+ * options may be NULL for the defaults.
+ */
+#define UV_FS_WALK_STAT         0x0001
+#define UV_FS_WALK_CONCURRENCY  4
+#define UV_FS_WALK_BATCH        256
+
+typedef void (*uv_fs_walk_entries_cb)(uv_fs_walk_t* req, const char* dir,
+    const uv_dirent_t* dirents, const uv_statbuf_t* stats, int n);
+typedef void (*uv_fs_walk_cb)(uv_fs_walk_t* req, int status);
+
+typedef struct uv_fs_walk_options_s {
+  int flags;
+  unsigned int concurrency; /* 0 means UV_FS_WALK_CONCURRENCY */
+  unsigned int batch;       /* 0 means UV_FS_WALK_BATCH */
+} uv_fs_walk_options_t;
+
+/* uv_fs_walk_t is a subclass of uv_req_t */
+struct uv_fs_walk_s {
+  UV_REQ_FIELDS
+  uv_loop_t* loop;
+  uv_fs_walk_entries_cb entries_cb;
+  uv_fs_walk_cb cb;
+  uint64_t ndirs;
+  uint64_t nentries;
+  uint64_t nerrors;
+  UV_FS_WALK_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_fs_walk(uv_loop_t* loop, uv_fs_walk_t* req,
+    const char* path, const uv_fs_walk_options_t* options,
+    uv_fs_walk_entries_cb entries_cb, uv_fs_walk_cb cb);
+
 UV_EXTERN int uv_fs_stat(uv_loop_t* loop, uv_fs_t* req, const char* path,
     uv_fs_cb cb);
 
@@ -1228,9 +1667,13 @@ union uv_any_req {
   uv_req_t req;
   uv_write_t write;
   uv_connect_t connect;
+  uv_connect_name_t connect_name;
+  uv_stream_pipe_t stream_pipe;
   uv_shutdown_t shutdown;
   uv_fs_t fs_req;
+  uv_fs_walk_t fs_walk;
   uv_work_t work_req;
+  uv_post_t post;
 };
 
 
@@ -1250,13 +1693,19 @@ struct uv_counters_s {
   uint64_t timer_init;
   uint64_t process_init;
   uint64_t fs_event_init;
+  uint64_t getaddrinfo_cache_hit;
+  uint64_t getaddrinfo_cache_miss;
+  uint64_t fs_read_inline;
+  uint64_t fs_read_offloaded;
 };
 
 
 struct uv_loop_s {
   UV_LOOP_PRIVATE_FIELDS
-  /* list used for ares task handles */
-  uv_ares_task_t* uv_ares_handles_;
+  /* ares task handles, hashed by socket */
+  uv_ares_task_t** uv_ares_handles_;
+  unsigned int uv_ares_handles_size_;
+  unsigned int uv_ares_handles_count_;
   /* Various thing for libeio. */
   uv_async_t uv_eio_want_poll_notifier;
   uv_async_t uv_eio_done_poll_notifier;
@@ -0,0 +1,121 @@
+
+/* Copyright 1998 by the Massachusetts Institute of Technology.
+ *
+ * Permission to use, copy, modify, and distribute this
+ * software and its documentation for any purpose and without
+ * fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting
+ * documentation, and that the name of M.I.T. not be used in
+ * advertising or publicity pertaining to distribution of the
+ * software without specific, written prior permission.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include "ares_setup.h"
+
+#ifdef HAVE_ARPA_NAMESER_H
+#  include <arpa/nameser.h>
+#else
+#  include "nameser.h"
+#endif
+
+#include <stdlib.h>
+
+#include "ares.h"
+#include "ares_private.h"
+
+/*
+ * A small per-channel cache of the buffers used for TCP traffic: send
+ * requests, their private copies of query packets, and the buffers TCP
+ * answers are read into. Blocks come in a few size classes and up to
+ * ARES_POOL_MAX_FREE of each are kept around once released, so a channel
+ * that resolves over TCP settles into reusing the same few blocks.
+ */
+
+static const size_t class_sizes[ARES_POOL_CLASSES] = {
+  PACKETSZ, 4096, 65536
+};
+
+/* Precedes every block handed out. */
+union pool_header {
+  union pool_header *next;   /* while on a free list */
+  int cls;                   /* while in use; -1 if too big to pool */
+  /* for alignment */
+  double d;
+  void *p;
+  long l;
+};
+
+void *ares__pool_alloc(ares_channel channel, size_t size)
+{
+  struct ares_buf_pool *pool = &channel->buf_pool;
+  union pool_header *block;
+  int cls;
+
+  for (cls = 0; cls < ARES_POOL_CLASSES; cls++)
+    if (size <= class_sizes[cls])
+      break;
+
+  if (cls < ARES_POOL_CLASSES && pool->free_list[cls])
+    {
+      block = pool->free_list[cls];
+      pool->free_list[cls] = block->next;
+      pool->nfree[cls]--;
+    }
+  else
+    {
+      if (cls < ARES_POOL_CLASSES)
+        size = class_sizes[cls];
+      else
+        cls = -1;
+      block = malloc(sizeof(union pool_header) + size);
+      if (!block)
+        return NULL;
+    }
+
+  block->cls = cls;
+  return block + 1;
+}
+
+void ares__pool_free(ares_channel channel, void *ptr)
+{
+  struct ares_buf_pool *pool = &channel->buf_pool;
+  union pool_header *block;
+  int cls;
+
+  if (!ptr)
+    return;
+
+  block = (union pool_header *)ptr - 1;
+  cls = block->cls;
+
+  if (cls < 0 || pool->nfree[cls] >= ARES_POOL_MAX_FREE)
+    {
+      free(block);
+      return;
+    }
+
+  block->next = pool->free_list[cls];
+  pool->free_list[cls] = block;
+  pool->nfree[cls]++;
+}
+
+void ares__pool_destroy(ares_channel channel)
+{
+  struct ares_buf_pool *pool = &channel->buf_pool;
+  union pool_header *block;
+  int cls;
+
+  for (cls = 0; cls < ARES_POOL_CLASSES; cls++)
+    {
+      while ((block = pool->free_list[cls]) != NULL)
+        {
+          pool->free_list[cls] = block->next;
+          free(block);
+        }
+      pool->nfree[cls] = 0;
+    }
+}
@@ -34,15 +34,13 @@ void ares__close_sockets(ares_channel channel, struct server_state *server)
       /* Advance server->qhead; pull out query as we go. */
       sendreq = server->qhead;
       server->qhead = sendreq->next;
-      if (sendreq->data_storage != NULL)
-        free(sendreq->data_storage);
-      free(sendreq);
+      ares__pool_free(channel, sendreq->data_storage);
+      ares__pool_free(channel, sendreq);
     }
   server->qtail = NULL;
 
   /* Reset any existing input buffer. */
-  if (server->tcp_buffer)
-    free(server->tcp_buffer);
+  ares__pool_free(channel, server->tcp_buffer);
   server->tcp_buffer = NULL;
   server->tcp_lenbuf_pos = 0;
 
@@ -0,0 +1,422 @@
+/* Copyright 1998, 2010 by the Massachusetts Institute of Technology.
+ *
+ * Permission to use, copy, modify, and distribute this
+ * software and its documentation for any purpose and without
+ * fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting
+ * documentation, and that the name of M.I.T. not be used in
+ * advertising or publicity pertaining to distribution of the
+ * software without specific, written prior permission.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include "ares_setup.h"
+
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif
+#ifdef HAVE_NETDB_H
+#  include <netdb.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#ifdef HAVE_STRINGS_H
+#include <strings.h>
+#endif
+
+#include "ares.h"
+#include "ares_platform.h"
+#include "ares_private.h"
+
+#ifdef WATT32
+#undef WIN32
+#endif
+
+/*
+ * The hosts file is parsed once per channel and kept in memory, indexed by
+ * every host name and alias, so that the 'f' lookup no longer reads the
+ * file line by line for each query.  The file is stat()ed at most once every
+ * HOSTS_RECHECK_INTERVAL seconds and reloaded when its mtime or size change.
+ */
+
+#define HOSTS_RECHECK_INTERVAL 1
+#define HOSTS_PATH_MAX 260
+
+struct hosts_name {
+  const char *name;          /* points into host */
+  unsigned int hash;
+  struct hostent *host;
+  struct hosts_name *next;   /* bucket chain, in file order */
+};
+
+struct ares_hosts_file {
+  time_t checked;            /* last time the file was stat()ed */
+  time_t mtime;
+  long size;
+
+  struct hostent **hosts;    /* one entry per line, in file order */
+  size_t nhosts;
+
+  struct hosts_name *names;
+  struct hosts_name **buckets;
+  unsigned int nbuckets;     /* power of two */
+};
+
+static unsigned int name_hash(const char *name)
+{
+  unsigned int h = 2166136261U;
+
+  while (*name)
+    {
+      h ^= (unsigned char)tolower((unsigned char)*name++);
+      h *= 16777619U;
+    }
+  return h;
+}
+
+/* Fill in the hosts file location; returns NULL if there is none. */
+static const char *hosts_path(char *buf)
+{
+#ifdef WIN32
+  win_platform platform;
+
+  buf[0] = '\0';
+
+  platform = ares__getplatform();
+
+  if (platform == WIN_NT) {
+    char tmp[HOSTS_PATH_MAX];
+    HKEY hkeyHosts;
+
+    if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, WIN_NS_NT_KEY, 0, KEY_READ,
+                     &hkeyHosts) == ERROR_SUCCESS)
+    {
+      DWORD dwLength = HOSTS_PATH_MAX;
+      RegQueryValueEx(hkeyHosts, DATABASEPATH, NULL, NULL, (LPBYTE)tmp,
+                      &dwLength);
+      ExpandEnvironmentStrings(tmp, buf, HOSTS_PATH_MAX);
+      RegCloseKey(hkeyHosts);
+    }
+  }
+  else if (platform == WIN_9X)
+    GetWindowsDirectory(buf, HOSTS_PATH_MAX);
+  else
+    return NULL;
+
+  strcat(buf, WIN_PATH_HOSTS);
+  return buf;
+
+#elif defined(WATT32)
+  extern const char *_w32_GetHostsFile (void);
+
+  (void)buf;
+  return _w32_GetHostsFile();
+
+#else
+  (void)buf;
+  return PATH_HOSTS;
+#endif
+}
+
+void ares__hosts_free(struct ares_hosts_file *hosts)
+{
+  size_t i;
+
+  if (!hosts)
+    return;
+
+  for (i = 0; i < hosts->nhosts; i++)
+    ares_free_hostent(hosts->hosts[i]);
+  free(hosts->hosts);
+  free(hosts->names);
+  free(hosts->buckets);
+  free(hosts);
+}
+
+/* Build the name index once all lines have been read. */
+static int hosts_index(struct ares_hosts_file *hosts)
+{
+  struct hosts_name *n;
+  char **alias;
+  size_t nnames;
+  size_t i;
+  unsigned int b;
+
+  nnames = 0;
+  for (i = 0; i < hosts->nhosts; i++)
+    {
+      nnames++;
+      for (alias = hosts->hosts[i]->h_aliases; *alias; alias++)
+        nnames++;
+    }
+
+  hosts->nbuckets = 16;
+  while (hosts->nbuckets < nnames)
+    hosts->nbuckets <<= 1;
+
+  hosts->buckets = calloc(hosts->nbuckets, sizeof(struct hosts_name *));
+  if (!hosts->buckets)
+    return ARES_ENOMEM;
+
+  if (nnames == 0)
+    return ARES_SUCCESS;
+
+  hosts->names = malloc(nnames * sizeof(struct hosts_name));
+  if (!hosts->names)
+    return ARES_ENOMEM;
+
+  n = hosts->names;
+  for (i = 0; i < hosts->nhosts; i++)
+    {
+      n->name = hosts->hosts[i]->h_name;
+      n->host = hosts->hosts[i];
+      n++;
+      for (alias = hosts->hosts[i]->h_aliases; *alias; alias++)
+        {
+          n->name = *alias;
+          n->host = hosts->hosts[i];
+          n++;
+        }
+    }
+
+  /* Link back to front so each chain ends up in file order. */
+  while (n-- != hosts->names)
+    {
+      n->hash = name_hash(n->name);
+      b = n->hash & (hosts->nbuckets - 1);
+      n->next = hosts->buckets[b];
+      hosts->buckets[b] = n;
+    }
+
+  return ARES_SUCCESS;
+}
+
+static int hosts_load(const char *path, struct ares_hosts_file **result)
+{
+  struct ares_hosts_file *hosts;
+  struct hostent **tmp;
+  struct hostent *host;
+  size_t alloced;
+  FILE *fp;
+  int status;
+  int error;
+#ifdef HAVE_SYS_STAT_H
+  struct stat st;
+#endif
+
+  *result = NULL;
+
+  fp = fopen(path, "r");
+  if (!fp)
+    {
+      error = ERRNO;
+      switch(error)
+        {
+        case ENOENT:
+        case ESRCH:
+          return ARES_ENOTFOUND;
+        default:
+          DEBUGF(fprintf(stderr, "fopen() failed with error: %d %s\n",
+                         error, strerror(error)));
+          DEBUGF(fprintf(stderr, "Error opening file: %s\n",
+                         path));
+          return ARES_EFILE;
+        }
+    }
+
+  hosts = calloc(1, sizeof(struct ares_hosts_file));
+  if (!hosts)
+    {
+      fclose(fp);
+      return ARES_ENOMEM;
+    }
+
+#ifdef HAVE_SYS_STAT_H
+  if (fstat(fileno(fp), &st) == 0)
+    {
+      hosts->mtime = st.st_mtime;
+      hosts->size = (long)st.st_size;
+    }
+#endif
+
+  alloced = 0;
+  while ((status = ares__get_hostent(fp, AF_UNSPEC, &host)) == ARES_SUCCESS)
+    {
+      if (hosts->nhosts == alloced)
+        {
+          alloced = alloced ? alloced * 2 : 32;
+          tmp = realloc(hosts->hosts, alloced * sizeof(struct hostent *));
+          if (!tmp)
+            {
+              ares_free_hostent(host);
+              status = ARES_ENOMEM;
+              break;
+            }
+          hosts->hosts = tmp;
+        }
+      hosts->hosts[hosts->nhosts++] = host;
+    }
+  fclose(fp);
+
+  if (status == ARES_EOF)
+    status = hosts_index(hosts);
+
+  if (status != ARES_SUCCESS)
+    {
+      ares__hosts_free(hosts);
+      return status;
+    }
+
+  hosts->checked = time(NULL);
+  *result = hosts;
+  return ARES_SUCCESS;
+}
+
+/* Make sure channel->hosts_file reflects the file on disk. */
+static int hosts_update(ares_channel channel)
+{
+  struct ares_hosts_file *hosts;
+  char buf[HOSTS_PATH_MAX];
+  const char *path;
+  time_t now;
+  int status;
+#ifdef HAVE_SYS_STAT_H
+  struct stat st;
+#endif
+
+  hosts = channel->hosts_file;
+  now = time(NULL);
+
+  if (hosts)
+    {
+      if (now - hosts->checked < HOSTS_RECHECK_INTERVAL &&
+          now >= hosts->checked)
+        return ARES_SUCCESS;
+
+#ifdef HAVE_SYS_STAT_H
+      path = hosts_path(buf);
+      if (path && stat(path, &st) == 0 &&
+          st.st_mtime == hosts->mtime && (long)st.st_size == hosts->size)
+        {
+          hosts->checked = now;
+          return ARES_SUCCESS;
+        }
+#endif
+    }
+
+  path = hosts_path(buf);
+  if (!path)
+    status = ARES_ENOTFOUND;
+  else
+    status = hosts_load(path, &hosts);
+
+  if (status == ARES_SUCCESS)
+    {
+      ares__hosts_free(channel->hosts_file);
+      channel->hosts_file = hosts;
+    }
+  else if (status != ARES_ENOMEM)
+    {
+      /* The file went away or became unreadable; forget the old contents. */
+      ares__hosts_free(channel->hosts_file);
+      channel->hosts_file = NULL;
+    }
+
+  return status;
+}
+
+/* Deep copy a hostent so that ares_free_hostent() can release it. */
+static struct hostent *copy_hostent(const struct hostent *src)
+{
+  struct hostent *host;
+  size_t naliases;
+  size_t i;
+
+  for (naliases = 0; src->h_aliases[naliases]; naliases++)
+    ;
+
+  host = calloc(1, sizeof(struct hostent));
+  if (!host)
+    return NULL;
+
+  host->h_addrtype = src->h_addrtype;
+  host->h_length = src->h_length;
+
+  host->h_name = strdup(src->h_name);
+  host->h_aliases = calloc(naliases + 1, sizeof(char *));
+  host->h_addr_list = calloc(2, sizeof(char *));
+  if (!host->h_name || !host->h_aliases || !host->h_addr_list)
+    goto fail;
+
+  host->h_addr_list[0] = malloc(src->h_length);
+  if (!host->h_addr_list[0])
+    goto fail;
+  memcpy(host->h_addr_list[0], src->h_addr_list[0], src->h_length);
+
+  for (i = 0; i < naliases; i++)
+    {
+      host->h_aliases[i] = strdup(src->h_aliases[i]);
+      if (!host->h_aliases[i])
+        goto fail;
+    }
+
+  return host;
+
+fail:
+  if (host->h_aliases)
+    {
+      for (i = 0; host->h_aliases[i]; i++)
+        free(host->h_aliases[i]);
+      free(host->h_aliases);
+    }
+  if (host->h_addr_list)
+    {
+      free(host->h_addr_list[0]);
+      free(host->h_addr_list);
+    }
+  free(host->h_name);
+  free(host);
+  return NULL;
+}
+
+int ares__hosts_lookup(ares_channel channel, const char *name, int family,
+                       struct hostent **host)
+{
+  struct hosts_name *n;
+  unsigned int hash;
+  int status;
+
+  *host = NULL;
+
+  status = hosts_update(channel);
+  if (status != ARES_SUCCESS)
+    return status;
+
+  hash = name_hash(name);
+  n = channel->hosts_file->buckets[hash & (channel->hosts_file->nbuckets - 1)];
+  for (; n; n = n->next)
+    {
+      if (n->hash != hash || strcasecmp(n->name, name) != 0)
+        continue;
+      if (family != AF_UNSPEC && n->host->h_addrtype != family)
+        continue;
+
+      *host = copy_hostent(n->host);
+      return *host ? ARES_SUCCESS : ARES_ENOMEM;
+    }
+
+  return ARES_ENOTFOUND;
+}
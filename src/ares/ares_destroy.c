@@ -50,7 +50,7 @@ void ares_destroy(ares_channel channel)
     {
       query = list_node->data;
       list_node = list_node->next;  /* since we're deleting the query */
-      query->callback(query->arg, ARES_EDESTRUCTION, 0, NULL, 0);
+      ares__query_callbacks(query, ARES_EDESTRUCTION, 0, NULL, 0);
       ares__free_query(query);
     }
 #ifndef NDEBUG
@@ -82,6 +82,9 @@ void ares_destroy(ares_channel channel)
   if (channel->lookups)
     free(channel->lookups);
 
+  ares__hosts_free(channel->hosts_file);
+  ares__pool_destroy(channel);
+
   free(channel);
 }
 
@@ -37,6 +37,9 @@
 
 static int name_length(const unsigned char *encoded, const unsigned char *abuf,
                        int alen);
+static void expand_name(const unsigned char *encoded,
+                        const unsigned char *abuf, size_t nlen,
+                        char *s, long *enclen);
 
 /* Expand an RFC1035-encoded domain name given by encoded.  The
  * containing message is given by abuf and alen.  The result given by
@@ -65,9 +68,6 @@ static int name_length(const unsigned char *encoded, const unsigned char *abuf,
 int ares_expand_name(const unsigned char *encoded, const unsigned char *abuf,
                      int alen, char **s, long *enclen)
 {
-  int len, indir = 0;
-  char *q;
-  const unsigned char *p;
   union {
     ssize_t sig;
      size_t uns;
@@ -80,9 +80,23 @@ int ares_expand_name(const unsigned char *encoded, const unsigned char *abuf,
   *s = malloc(nlen.uns + 1);
   if (!*s)
     return ARES_ENOMEM;
-  q = *s;
 
-  if (nlen.uns == 0) {
+  expand_name(encoded, abuf, nlen.uns, *s, enclen);
+  return ARES_SUCCESS;
+}
+
+/* Writes the expansion of an encoded name, already validated by
+ * name_length() to be nlen bytes long, to s.
+ */
+static void expand_name(const unsigned char *encoded,
+                        const unsigned char *abuf, size_t nlen,
+                        char *s, long *enclen)
+{
+  int len, indir = 0;
+  char *q = s;
+  const unsigned char *p;
+
+  if (nlen == 0) {
     /* RFC2181 says this should be ".": the root of the DNS tree.
      * Since this function strips trailing dots though, it becomes ""
      */
@@ -95,7 +109,7 @@ int ares_expand_name(const unsigned char *encoded, const unsigned char *abuf,
     else
       *enclen = 1;  /* the caller should move one byte to get past this */
 
-    return ARES_SUCCESS;
+    return;
   }
 
   /* No error-checking necessary; it was all done by name_length(). */
@@ -129,12 +143,10 @@ int ares_expand_name(const unsigned char *encoded, const unsigned char *abuf,
     *enclen = p + 1 - encoded;
 
   /* Nuke the trailing period if we wrote one. */
-  if (q > *s)
+  if (q > s)
     *(q - 1) = 0;
   else
     *q = 0; /* zero terminate */
-
-  return ARES_SUCCESS;
 }
 
 /* Return the length of the expansion of an encoded domain name, or
@@ -198,3 +210,21 @@ int ares__expand_name_for_response(const unsigned char *encoded,
     status = ARES_EBADRESP;
   return status;
 }
+
+/* Like ares__expand_name_for_response() but expands into buf rather than
+ * an allocated string. Names that do not fit in buflen bytes (including
+ * the terminating NUL) are treated as a bad response.
+ */
+int ares__expand_name_into(const unsigned char *encoded,
+                           const unsigned char *abuf, int alen,
+                           char *buf, size_t buflen, long *enclen)
+{
+  int nlen;
+
+  nlen = name_length(encoded, abuf, alen);
+  if (nlen < 0 || (size_t)nlen + 1 > buflen)
+    return ARES_EBADRESP;
+
+  expand_name(encoded, abuf, nlen, buf, enclen);
+  return ARES_SUCCESS;
+}
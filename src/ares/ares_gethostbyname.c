@@ -55,6 +55,9 @@
 #undef WIN32
 #endif
 
+/* Answers up to this size are parsed on the stack. */
+#define HOSTENT_BUFSZ 2048
+
 struct host_query {
   /* Arguments passed to ares_gethostbyname() */
   ares_channel channel;
@@ -72,9 +75,11 @@ static void host_callback(void *arg, int status, int timeouts,
                           unsigned char *abuf, int alen);
 static void end_hquery(struct host_query *hquery, int status,
                        struct hostent *host);
+static void free_hquery(struct host_query *hquery);
 static int fake_hostent(const char *name, int family,
                         ares_host_callback callback, void *arg);
-static int file_lookup(const char *name, int family, struct hostent **host);
+static int file_lookup(ares_channel channel, const char *name, int family,
+                       struct hostent **host);
 static void sort_addresses(struct hostent *host,
                            const struct apattern *sortlist, int nsort);
 static void sort6_addresses(struct hostent *host,
@@ -158,7 +163,8 @@ static void next_lookup(struct host_query *hquery, int status_code)
 
         case 'f':
           /* Host file lookup */
-          status = file_lookup(hquery->name, hquery->want_family, &host);
+          status = file_lookup(hquery->channel, hquery->name,
+                               hquery->want_family, &host);
 
           /* this status check below previously checked for !ARES_ENOTFOUND,
              but we should not assume that this single error code is the one
@@ -181,19 +187,25 @@ static void host_callback(void *arg, int status, int timeouts,
   struct host_query *hquery = (struct host_query *) arg;
   ares_channel channel = hquery->channel;
   struct hostent *host = NULL;
+  union {
+    struct hostent host;
+    char buf[HOSTENT_BUFSZ];
+  } block;
 
   hquery->timeouts += timeouts;
   if (status == ARES_SUCCESS)
     {
       if (hquery->sent_family == AF_INET)
         {
-          status = ares_parse_a_reply(abuf, alen, &host, NULL, NULL);
+          status = ares_parse_hostent_reply(abuf, alen, AF_INET, &block,
+                                            sizeof(block), &host, NULL);
           if (host && channel->nsort)
             sort_addresses(host, channel->sortlist, channel->nsort);
         }
       else if (hquery->sent_family == AF_INET6)
         {
-          status = ares_parse_aaaa_reply(abuf, alen, &host, NULL, NULL);
+          status = ares_parse_hostent_reply(abuf, alen, AF_INET6, &block,
+                                            sizeof(block), &host, NULL);
           if ((status == ARES_ENODATA || status == ARES_EBADRESP) &&
                hquery->want_family == AF_UNSPEC) {
             /* The query returned something but either there were no AAAA
@@ -207,7 +219,11 @@ static void host_callback(void *arg, int status, int timeouts,
           if (host && channel->nsort)
             sort6_addresses(host, channel->sortlist, channel->nsort);
         }
-      end_hquery(hquery, status, host);
+      hquery->callback(hquery->arg, status, hquery->timeouts, host);
+      /* The answer lives in block unless it did not fit. */
+      if (host != &block.host)
+        free(host);
+      free_hquery(hquery);
     }
   else if ((status == ARES_ENODATA || status == ARES_EBADRESP ||
             status == ARES_ETIMEOUT) && (hquery->sent_family == AF_INET6 &&
@@ -230,6 +246,11 @@ static void end_hquery(struct host_query *hquery, int status,
   hquery->callback(hquery->arg, status, hquery->timeouts, host);
   if (host)
     ares_free_hostent(host);
+  free_hquery(hquery);
+}
+
+static void free_hquery(struct host_query *hquery)
+{
   free(hquery->name);
   free(hquery);
 }
@@ -314,7 +335,7 @@ int ares_gethostbyname_file(ares_channel channel, const char *name,
 {
   int result;
 
-  /* We only take the channel to ensure that ares_init() been called. */
+  /* The channel holds the parsed hosts file. */
   if(channel == NULL)
     {
       /* Anything will do, really.  This seems fine, and is consistent with
@@ -326,7 +347,7 @@ int ares_gethostbyname_file(ares_channel channel, const char *name,
   /* Just chain to the internal implementation we use here; it's exactly
    * what we want.
    */
-  result = file_lookup(name, family, host);
+  result = file_lookup(channel, name, family, host);
   if(result != ARES_SUCCESS)
     {
       /* We guarantee a NULL hostent on failure. */
@@ -335,87 +356,11 @@ int ares_gethostbyname_file(ares_channel channel, const char *name,
   return result;
 }
 
-static int file_lookup(const char *name, int family, struct hostent **host)
+static int file_lookup(ares_channel channel, const char *name, int family,
+                       struct hostent **host)
 {
-  FILE *fp;
-  char **alias;
-  int status;
-  int error;
-
-#ifdef WIN32
-  char PATH_HOSTS[MAX_PATH];
-  win_platform platform;
-
-  PATH_HOSTS[0] = '\0';
-
-  platform = ares__getplatform();
-
-  if (platform == WIN_NT) {
-    char tmp[MAX_PATH];
-    HKEY hkeyHosts;
-
-    if (RegOpenKeyEx(HKEY_LOCAL_MACHINE, WIN_NS_NT_KEY, 0, KEY_READ,
-                     &hkeyHosts) == ERROR_SUCCESS)
-    {
-      DWORD dwLength = MAX_PATH;
-      RegQueryValueEx(hkeyHosts, DATABASEPATH, NULL, NULL, (LPBYTE)tmp,
-                      &dwLength);
-      ExpandEnvironmentStrings(tmp, PATH_HOSTS, MAX_PATH);
-      RegCloseKey(hkeyHosts);
-    }
-  }
-  else if (platform == WIN_9X)
-    GetWindowsDirectory(PATH_HOSTS, MAX_PATH);
-  else
-    return ARES_ENOTFOUND;
-
-  strcat(PATH_HOSTS, WIN_PATH_HOSTS);
-
-#elif defined(WATT32)
-  extern const char *_w32_GetHostsFile (void);
-  const char *PATH_HOSTS = _w32_GetHostsFile();
-
-  if (!PATH_HOSTS)
-    return ARES_ENOTFOUND;
-#endif
-
-  fp = fopen(PATH_HOSTS, "r");
-  if (!fp)
-    {
-      error = ERRNO;
-      switch(error)
-        {
-        case ENOENT:
-        case ESRCH:
-          return ARES_ENOTFOUND;
-        default:
-          DEBUGF(fprintf(stderr, "fopen() failed with error: %d %s\n",
-                         error, strerror(error)));
-          DEBUGF(fprintf(stderr, "Error opening file: %s\n",
-                         PATH_HOSTS));
-          *host = NULL;
-          return ARES_EFILE;
-        }
-    }
-  while ((status = ares__get_hostent(fp, family, host)) == ARES_SUCCESS)
-    {
-      if (strcasecmp((*host)->h_name, name) == 0)
-        break;
-      for (alias = (*host)->h_aliases; *alias; alias++)
-        {
-          if (strcasecmp(*alias, name) == 0)
-            break;
-        }
-      if (*alias)
-        break;
-      ares_free_hostent(*host);
-    }
-  fclose(fp);
-  if (status == ARES_EOF)
-    status = ARES_ENOTFOUND;
-  if (status != ARES_SUCCESS)
-    *host = NULL;
-  return status;
+  /* Served from the channel's in-memory copy of the hosts file. */
+  return ares__hosts_lookup(channel, name, family, host);
 }
 
 static void sort_addresses(struct hostent *host,
@@ -171,6 +171,8 @@ int ares_init_options(ares_channel *channelptr, struct ares_options *options,
   channel->sock_state_cb_data = NULL;
   channel->sock_create_cb = NULL;
   channel->sock_create_cb_data = NULL;
+  channel->hosts_file = NULL;
+  memset(&channel->buf_pool, 0, sizeof(channel->buf_pool));
 
   channel->last_server = 0;
   channel->last_timeout_processed = (time_t)now.tv_sec;
@@ -189,6 +191,10 @@ int ares_init_options(ares_channel *channelptr, struct ares_options *options,
     {
       ares__init_list_head(&(channel->queries_by_timeout[i]));
     }
+  for (i = 0; i < ARES_QUESTION_TABLE_SIZE; i++)
+    {
+      ares__init_list_head(&(channel->queries_by_question[i]));
+    }
 
   /* Initialize configuration by each of the four sources, from highest
    * precedence to lowest.
@@ -1805,5 +1811,9 @@ void ares__init_servers_state(ares_channel channel)
       ares__init_list_head(&server->queries_to_server);
       server->channel = channel;
       server->is_broken = 0;
+      server->rtt = 0;
+      server->failures = 0;
+      server->probe_time.tv_sec = 0;
+      server->probe_time.tv_usec = 0;
     }
 }
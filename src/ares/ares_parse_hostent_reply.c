@@ -0,0 +1,285 @@
+
+/* Copyright 1998 by the Massachusetts Institute of Technology.
+ *
+ * Permission to use, copy, modify, and distribute this
+ * software and its documentation for any purpose and without
+ * fee is hereby granted, provided that the above copyright
+ * notice appear in all copies and that both that copyright
+ * notice and this permission notice appear in supporting
+ * documentation, and that the name of M.I.T. not be used in
+ * advertising or publicity pertaining to distribution of the
+ * software without specific, written prior permission.
+ * M.I.T. makes no representations about the suitability of
+ * this software for any purpose.  It is provided "as is"
+ * without express or implied warranty.
+ */
+
+#include "ares_setup.h"
+
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+#ifdef HAVE_NETINET_IN_H
+#  include <netinet/in.h>
+#endif
+#ifdef HAVE_NETDB_H
+#  include <netdb.h>
+#endif
+#ifdef HAVE_ARPA_INET_H
+#  include <arpa/inet.h>
+#endif
+#ifdef HAVE_ARPA_NAMESER_H
+#  include <arpa/nameser.h>
+#else
+#  include "nameser.h"
+#endif
+#ifdef HAVE_ARPA_NAMESER_COMPAT_H
+#  include <arpa/nameser_compat.h>
+#endif
+
+#ifdef HAVE_STRINGS_H
+#  include <strings.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_LIMITS_H
+#  include <limits.h>
+#endif
+
+#include "ares.h"
+#include "ares_dns.h"
+#include "ares_private.h"
+
+/*
+ * ares_parse_hostent_reply() gives the same answer as ares_parse_a_reply()
+ * and ares_parse_aaaa_reply() but lays the hostent out in one block:
+ *
+ *   struct hostent
+ *   char *h_addr_list[naddrs + 1]
+ *   char *h_aliases[naliases + 1]
+ *   int ttls[naddrs]
+ *   addresses
+ *   alias names, then h_name
+ *
+ * The answer is walked twice, once to size the block and once to fill it
+ * in. Names are expanded into fixed scratch buffers so neither pass
+ * allocates.
+ */
+
+/* Large enough for any name that fits in a DNS message, escapes included. */
+#define NAME_BUFSZ 1024
+
+struct hostent_layout {
+  int type;
+  int addrlen;
+  int naddrs;
+  int naliases;
+  size_t namelen;              /* bytes of all names, NULs included */
+  int cname_ttl;
+
+  /* Only set for the second pass. */
+  char **addr_list;
+  char **aliases;
+  int *ttls;
+  char *addrs;
+  char *names;
+
+  char hostname[NAME_BUFSZ];
+  char rr_name[NAME_BUFSZ];
+};
+
+static int walk_answers(const unsigned char *abuf, int alen,
+                        struct hostent_layout *l)
+{
+  unsigned int qdcount, ancount, i;
+  int status, rr_type, rr_class, rr_len, rr_ttl;
+  const unsigned char *aptr;
+  size_t n;
+  long len;
+
+  l->naddrs = 0;
+  l->naliases = 0;
+  l->namelen = 0;
+  l->cname_ttl = INT_MAX;
+
+  /* Give up if abuf doesn't have room for a header. */
+  if (alen < HFIXEDSZ)
+    return ARES_EBADRESP;
+
+  /* Fetch the question and answer count from the header. */
+  qdcount = DNS_HEADER_QDCOUNT(abuf);
+  ancount = DNS_HEADER_ANCOUNT(abuf);
+  if (qdcount != 1)
+    return ARES_EBADRESP;
+
+  /* Expand the name from the question, and skip past the question. */
+  aptr = abuf + HFIXEDSZ;
+  status = ares__expand_name_into(aptr, abuf, alen, l->hostname,
+                                  sizeof(l->hostname), &len);
+  if (status != ARES_SUCCESS)
+    return status;
+  if (aptr + len + QFIXEDSZ > abuf + alen)
+    return ARES_EBADRESP;
+  aptr += len + QFIXEDSZ;
+
+  /* Examine each answer resource record (RR) in turn. */
+  for (i = 0; i < ancount; i++)
+    {
+      /* Decode the RR up to the data field. */
+      status = ares__expand_name_into(aptr, abuf, alen, l->rr_name,
+                                      sizeof(l->rr_name), &len);
+      if (status != ARES_SUCCESS)
+        return status;
+      aptr += len;
+      if (aptr + RRFIXEDSZ > abuf + alen)
+        return ARES_EBADRESP;
+      rr_type = DNS_RR_TYPE(aptr);
+      rr_class = DNS_RR_CLASS(aptr);
+      rr_len = DNS_RR_LEN(aptr);
+      rr_ttl = DNS_RR_TTL(aptr);
+      aptr += RRFIXEDSZ;
+
+      if (rr_class == C_IN && rr_type == l->type
+          && rr_len == l->addrlen
+          && strcasecmp(l->rr_name, l->hostname) == 0)
+        {
+          if (aptr + l->addrlen > abuf + alen)
+            return ARES_EBADRESP;
+          if (l->addrs)
+            {
+              l->addr_list[l->naddrs] = l->addrs + l->naddrs * l->addrlen;
+              memcpy(l->addr_list[l->naddrs], aptr, l->addrlen);
+              l->ttls[l->naddrs] = rr_ttl;
+            }
+          l->naddrs++;
+        }
+
+      if (rr_class == C_IN && rr_type == T_CNAME)
+        {
+          /* Record the RR name as an alias. */
+          n = strlen(l->rr_name) + 1;
+          if (l->names)
+            {
+              l->aliases[l->naliases] = l->names + l->namelen;
+              memcpy(l->aliases[l->naliases], l->rr_name, n);
+            }
+          l->namelen += n;
+          l->naliases++;
+
+          /* Decode the RR data and replace the hostname with it. */
+          status = ares__expand_name_into(aptr, abuf, alen, l->hostname,
+                                          sizeof(l->hostname), &len);
+          if (status != ARES_SUCCESS)
+            return status;
+
+          /* Take the min of the TTLs we see in the CNAME chain. */
+          if (l->cname_ttl > rr_ttl)
+            l->cname_ttl = rr_ttl;
+        }
+
+      aptr += rr_len;
+      if (aptr > abuf + alen)
+        return ARES_EBADRESP;
+    }
+
+  /* The last name in the CNAME chain is the official name. */
+  n = strlen(l->hostname) + 1;
+  if (l->names)
+    memcpy(l->names + l->namelen, l->hostname, n);
+  l->namelen += n;
+
+  return ARES_SUCCESS;
+}
+
+int ares_parse_hostent_reply(const unsigned char *abuf, int alen, int family,
+                             void *buf, size_t buflen,
+                             struct hostent **host, int **ttls)
+{
+  struct hostent_layout l;
+  struct hostent *hostent;
+  size_t size;
+  char *p;
+  int status, i;
+
+  *host = NULL;
+  if (ttls)
+    *ttls = NULL;
+
+  switch (family)
+    {
+    case AF_INET:
+      l.type = T_A;
+      l.addrlen = sizeof(struct in_addr);
+      break;
+    case AF_INET6:
+      l.type = T_AAAA;
+      l.addrlen = sizeof(struct ares_in6_addr);
+      break;
+    default:
+      return ARES_EBADFAMILY;
+    }
+
+  /* First pass: count. */
+  l.addrs = NULL;
+  l.names = NULL;
+  status = walk_answers(abuf, alen, &l);
+  if (status != ARES_SUCCESS)
+    return status;
+
+  /* A CNAME chain without addresses still counts as an answer for A
+     queries, as it does in ares_parse_a_reply(); not for AAAA ones. */
+  if (l.naddrs == 0 && (family == AF_INET6 || l.naliases == 0))
+    return ARES_ENODATA;
+
+  size = sizeof(struct hostent)
+       + (l.naddrs + 1) * sizeof(char *)
+       + (l.naliases + 1) * sizeof(char *)
+       + l.naddrs * sizeof(int)
+       + l.naddrs * l.addrlen
+       + l.namelen;
+
+  if (buf && buflen >= size)
+    hostent = buf;
+  else
+    {
+      hostent = malloc(size);
+      if (!hostent)
+        return ARES_ENOMEM;
+    }
+
+  p = (char *)(hostent + 1);
+  l.addr_list = (char **)p;
+  p += (l.naddrs + 1) * sizeof(char *);
+  l.aliases = (char **)p;
+  p += (l.naliases + 1) * sizeof(char *);
+  l.ttls = (int *)p;
+  p += l.naddrs * sizeof(int);
+  l.addrs = p;
+  p += l.naddrs * l.addrlen;
+  l.names = p;
+
+  /* Second pass: fill in. The answer was validated by the first. */
+  walk_answers(abuf, alen, &l);
+
+  l.addr_list[l.naddrs] = NULL;
+  l.aliases[l.naliases] = NULL;
+
+  /* Ensure that each address TTL is no larger than the CNAME TTL. */
+  for (i = 0; i < l.naddrs; i++)
+    {
+      if (l.ttls[i] > l.cname_ttl)
+        l.ttls[i] = l.cname_ttl;
+    }
+
+  hostent->h_name = l.names + l.namelen - (strlen(l.hostname) + 1);
+  hostent->h_aliases = l.aliases;
+  hostent->h_addrtype = family;
+  hostent->h_length = l.addrlen;
+  hostent->h_addr_list = l.addr_list;
+
+  *host = hostent;
+  if (ttls)
+    *ttls = l.ttls;
+  return ARES_SUCCESS;
+}
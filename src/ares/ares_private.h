@@ -173,6 +173,15 @@ struct server_state {
    * request that is queued for sending times out.
    */
   int is_broken;
+
+  /* Smoothed round trip time in microseconds; 0 until the first answer. */
+  int rtt;
+  /* Consecutive timeouts and errors, reset by an answer. A failing server
+   * only gets new queries once probe_time has passed, or when every other
+   * server is failing too.
+   */
+  int failures;
+  struct timeval probe_time;
 };
 
 /* State to represent a DNS query */
@@ -180,6 +189,7 @@ struct query {
   /* Query ID from qbuf, for faster lookup, and current timeout */
   unsigned short qid;
   struct timeval timeout;
+  struct timeval sent;  /* when the current attempt was sent */
 
   /*
    * Links for the doubly-linked lists in which we insert a query.
@@ -191,6 +201,7 @@ struct query {
   struct list_node queries_by_timeout;
   struct list_node queries_to_server;
   struct list_node all_queries;
+  struct list_node queries_by_question;
 
   /* Query buf with length at beginning, for TCP transmission */
   unsigned char *tcpbuf;
@@ -209,12 +220,26 @@ struct query {
   int using_tcp;
   int error_status;
   int timeouts; /* number of timeouts we saw for this request */
+
+  /* Callers of ares_send() that asked the same question while this query
+   * was in flight, most recent first. They get the same answer.
+   */
+  unsigned int question_hash;
+  struct query_waiter *waiters;
+};
+
+/* A caller waiting on an identical query that is already in flight */
+struct query_waiter {
+  ares_callback callback;
+  void *arg;
+  struct query_waiter *next;
 };
 
 /* Per-server state for a query */
 struct query_server_info {
   int skip_server;  /* should we skip server, due to errors, etc? */
   int tcp_connection_generation;  /* into which TCP connection did we send? */
+  int sends;        /* how many times did we send the query there? */
 };
 
 /* An IP address pattern; matches an IP address X if X & mask == addr */
@@ -244,6 +269,14 @@ typedef struct rc4_key
   unsigned char y;
 } rc4_key;
 
+/* Free TCP buffers kept by a channel, see ares__buf_pool.c */
+#define ARES_POOL_CLASSES  3
+#define ARES_POOL_MAX_FREE 16
+struct ares_buf_pool {
+  union pool_header *free_list[ARES_POOL_CLASSES];
+  int nfree[ARES_POOL_CLASSES];
+};
+
 struct ares_channeldata {
   /* Configuration data */
   int flags;
@@ -298,12 +331,20 @@ struct ares_channeldata {
   /* Queries bucketed by timeout, for quickly handling timeouts: */
 #define ARES_TIMEOUT_TABLE_SIZE 1024
   struct list_node queries_by_timeout[ARES_TIMEOUT_TABLE_SIZE];
+  /* Queries bucketed by a hash of the question, for coalescing: */
+#define ARES_QUESTION_TABLE_SIZE 1024
+  struct list_node queries_by_question[ARES_QUESTION_TABLE_SIZE];
 
   ares_sock_state_cb sock_state_cb;
   void *sock_state_cb_data;
 
   ares_sock_create_callback sock_create_cb;
   void *sock_create_cb_data;
+
+  /* Parsed hosts file, loaded on first use (see ares__hosts_file.c) */
+  struct ares_hosts_file *hosts_file;
+
+  struct ares_buf_pool buf_pool;
 };
 
 /* return true if now is exactly check time or later */
@@ -322,14 +363,27 @@ void ares__send_query(ares_channel channel, struct query *query,
                       struct timeval *now);
 void ares__close_sockets(ares_channel channel, struct server_state *server);
 int ares__get_hostent(FILE *fp, int family, struct hostent **host);
+void *ares__pool_alloc(ares_channel channel, size_t size);
+void ares__pool_free(ares_channel channel, void *ptr);
+void ares__pool_destroy(ares_channel channel);
+int ares__hosts_lookup(ares_channel channel, const char *name, int family,
+                       struct hostent **host);
+void ares__hosts_free(struct ares_hosts_file *hosts);
 int ares__read_line(FILE *fp, char **buf, size_t *bufsize);
 void ares__free_query(struct query *query);
+void ares__query_callbacks(struct query *query, int status, int timeouts,
+                           unsigned char *abuf, int alen);
 unsigned short ares__generate_new_id(rc4_key* key);
 struct timeval ares__tvnow(void);
 int ares__expand_name_for_response(const unsigned char *encoded,
                                    const unsigned char *abuf, int alen,
                                    char **s, long *enclen);
+int ares__expand_name_into(const unsigned char *encoded,
+                           const unsigned char *abuf, int alen,
+                           char *buf, size_t buflen, long *enclen);
 void ares__init_servers_state(ares_channel channel);
+int ares__pick_server(ares_channel channel, struct query *query,
+                      struct timeval *now);
 void ares__destroy_servers_state(ares_channel channel);
 #if 0 /* Not used */
 long ares__tvdiff(struct timeval t1, struct timeval t2);
@@ -69,6 +69,8 @@
 #include "ares_nowarn.h"
 #include "ares_private.h"
 
+/* Most queued TCP requests handed to a single writev() */
+#define ARES_TCP_IOVECS 16
 
 static int try_again(int errnum);
 static void write_tcp_data(ares_channel channel, fd_set *write_fds,
@@ -89,6 +91,10 @@ static void handle_error(ares_channel channel, int whichserver,
                          struct timeval *now);
 static void skip_server(ares_channel channel, struct query *query,
                         int whichserver);
+static void server_answered(ares_channel channel, struct query *query,
+                            int whichserver, struct timeval *now);
+static void server_failed(ares_channel channel, struct query *query,
+                          int whichserver, struct timeval *now);
 static void next_server(ares_channel channel, struct query *query,
                         struct timeval *now);
 static int open_tcp_socket(ares_channel channel, struct server_state *server);
@@ -210,9 +216,8 @@ static void write_tcp_data(ares_channel channel,
 {
   struct server_state *server;
   struct send_request *sendreq;
-  struct iovec *vec;
+  struct iovec vec[ARES_TCP_IOVECS];
   int i;
-  ssize_t scount;
   ssize_t wcount;
   size_t n;
 
@@ -246,51 +251,29 @@ static void write_tcp_data(ares_channel channel,
          * extra system calls and confusion. */
         FD_CLR(server->tcp_socket, write_fds);
 
-      /* Count the number of send queue items. */
+      /* Send as much of the queue as fits in our iovecs at once. */
       n = 0;
-      for (sendreq = server->qhead; sendreq; sendreq = sendreq->next)
-        n++;
-
-      /* Allocate iovecs so we can send all our data at once. */
-      vec = malloc(n * sizeof(struct iovec));
-      if (vec)
+      for (sendreq = server->qhead; sendreq && n < ARES_TCP_IOVECS;
+           sendreq = sendreq->next)
         {
-          /* Fill in the iovecs and send. */
-          n = 0;
-          for (sendreq = server->qhead; sendreq; sendreq = sendreq->next)
-            {
-              vec[n].iov_base = (char *) sendreq->data;
-              vec[n].iov_len = sendreq->len;
-              n++;
-            }
-          wcount = (ssize_t)writev(server->tcp_socket, vec, (int)n);
-          free(vec);
-          if (wcount < 0)
-            {
-              if (!try_again(SOCKERRNO))
-                  handle_error(channel, i, now);
-              continue;
-            }
-
-          /* Advance the send queue by as many bytes as we sent. */
-          advance_tcp_send_queue(channel, i, wcount);
+          vec[n].iov_base = (char *) sendreq->data;
+          vec[n].iov_len = sendreq->len;
+          n++;
         }
+
+      if (n > 1)
+        wcount = (ssize_t)writev(server->tcp_socket, vec, (int)n);
       else
+        wcount = swrite(server->tcp_socket, vec[0].iov_base, vec[0].iov_len);
+      if (wcount < 0)
         {
-          /* Can't allocate iovecs; just send the first request. */
-          sendreq = server->qhead;
-
-          scount = swrite(server->tcp_socket, sendreq->data, sendreq->len);
-          if (scount < 0)
-            {
-              if (!try_again(SOCKERRNO))
-                  handle_error(channel, i, now);
-              continue;
-            }
-
-          /* Advance the send queue by as many bytes as we sent. */
-          advance_tcp_send_queue(channel, i, scount);
+          if (!try_again(SOCKERRNO))
+              handle_error(channel, i, now);
+          continue;
         }
+
+      /* Advance the send queue by as many bytes as we sent. */
+      advance_tcp_send_queue(channel, i, wcount);
     }
 }
 
@@ -305,9 +288,8 @@ static void advance_tcp_send_queue(ares_channel channel, int whichserver,
     if ((size_t)num_bytes >= sendreq->len) {
       num_bytes -= sendreq->len;
       server->qhead = sendreq->next;
-      if (sendreq->data_storage)
-        free(sendreq->data_storage);
-      free(sendreq);
+      ares__pool_free(channel, sendreq->data_storage);
+      ares__pool_free(channel, sendreq);
       if (server->qhead == NULL) {
         SOCK_STATE_CALLBACK(channel, server->tcp_socket, 1, 0);
         server->qtail = NULL;
@@ -386,7 +368,8 @@ static void read_tcp_data(ares_channel channel, fd_set *read_fds,
                */
               server->tcp_length = server->tcp_lenbuf[0] << 8
                 | server->tcp_lenbuf[1];
-              server->tcp_buffer = malloc(server->tcp_length);
+              server->tcp_buffer = ares__pool_alloc(channel,
+                                                    server->tcp_length);
               if (!server->tcp_buffer)
                 handle_error(channel, i, now);
               server->tcp_buffer_pos = 0;
@@ -413,8 +396,7 @@ static void read_tcp_data(ares_channel channel, fd_set *read_fds,
                */
               process_answer(channel, server->tcp_buffer, server->tcp_length,
                              i, 1, now);
-          if (server->tcp_buffer)
-                        free(server->tcp_buffer);
+              ares__pool_free(channel, server->tcp_buffer);
               server->tcp_buffer = NULL;
               server->tcp_lenbuf_pos = 0;
               server->tcp_buffer_pos = 0;
@@ -524,6 +506,7 @@ static void process_timeouts(ares_channel channel, struct timeval *now)
             {
               query->error_status = ARES_ETIMEOUT;
               ++query->timeouts;
+              server_failed(channel, query, query->server, now);
               next_server(channel, query, now);
             }
         }
@@ -601,6 +584,7 @@ static void process_answer(ares_channel channel, unsigned char *abuf,
     {
       if (rcode == SERVFAIL || rcode == NOTIMP || rcode == REFUSED)
         {
+          server_failed(channel, NULL, whichserver, now);
           skip_server(channel, query, whichserver);
           if (query->server == whichserver)
             next_server(channel, query, now);
@@ -608,6 +592,7 @@ static void process_answer(ares_channel channel, unsigned char *abuf,
         }
     }
 
+  server_answered(channel, query, whichserver, now);
   end_query(channel, query, ARES_SUCCESS, abuf, alen);
 }
 
@@ -638,6 +623,7 @@ static void handle_error(ares_channel channel, int whichserver,
 
   /* Reset communications with this server. */
   ares__close_sockets(channel, server);
+  server_failed(channel, NULL, whichserver, now);
 
   /* Tell all queries talking to this server to move on and not try
    * this server again. We steal the current list of queries that were
@@ -678,43 +664,143 @@ static void skip_server(ares_channel channel, struct query *query,
     }
 }
 
-static void next_server(ares_channel channel, struct query *query,
-                        struct timeval *now)
+/* Folds a round trip time sample into the server's running average. */
+static void sample_rtt(struct server_state *server, struct query *query,
+                       struct timeval *now)
 {
-  /* We need to try each server channel->tries times. We have channel->nservers
-   * servers to try. In total, we need to do channel->nservers * channel->tries
-   * attempts. Use query->try to remember how many times we already attempted
-   * this query. Use modular arithmetic to find the next server to try. */
-  while (++(query->try_count) < (channel->nservers * channel->tries))
-    {
-      struct server_state *server;
+  long rtt = (now->tv_sec - query->sent.tv_sec) * 1000000 +
+             (now->tv_usec - query->sent.tv_usec);
 
-      /* Move on to the next server. */
-      query->server = (query->server + 1) % channel->nservers;
-      server = &channel->servers[query->server];
+  if (rtt < 1)
+    rtt = 1;
+  if (server->rtt == 0)
+    server->rtt = (int)rtt;
+  else
+    server->rtt += (int)((rtt - server->rtt) / 8);
+}
 
-      /* We don't want to use this server if (1) we decided this
-       * connection is broken, and thus about to be closed, (2)
-       * we've decided to skip this server because of earlier
-       * errors we encountered, or (3) we already sent this query
-       * over this exact connection.
-       */
-      if (!server->is_broken &&
-           !query->server_info[query->server].skip_server &&
-           !(query->using_tcp &&
-             (query->server_info[query->server].tcp_connection_generation ==
-              server->tcp_connection_generation)))
+static void server_answered(ares_channel channel, struct query *query,
+                            int whichserver, struct timeval *now)
+{
+  struct server_state *server = &channel->servers[whichserver];
+
+  /* A late answer to an earlier attempt says nothing about timing. */
+  if (query->server == whichserver)
+    sample_rtt(server, query, now);
+  server->failures = 0;
+}
+
+/* Notes a timeout or error and benches the server for a while; the bench
+ * doubles with each consecutive failure, up to 32 seconds.
+ */
+static void server_failed(ares_channel channel, struct query *query,
+                          int whichserver, struct timeval *now)
+{
+  struct server_state *server = &channel->servers[whichserver];
+  int shift;
+
+  if (query)
+    sample_rtt(server, query, now);
+
+  shift = server->failures < 5 ? server->failures : 5;
+  server->failures++;
+  server->probe_time = *now;
+  ares__timeadd(&server->probe_time, 1000 << shift);
+}
+
+/* Whether a retry of the query may go to the server: not (1) a
+ * connection we decided is broken, and thus about to be closed, (2) a
+ * server we've decided to skip because of earlier errors we encountered,
+ * (3) the exact connection we already sent this query over, or (4) one
+ * that already had its channel->tries attempts.
+ */
+static int server_usable(ares_channel channel, struct query *query, int i)
+{
+  struct server_state *server = &channel->servers[i];
+
+  return !server->is_broken &&
+         !query->server_info[i].skip_server &&
+         !(query->using_tcp &&
+           (query->server_info[i].tcp_connection_generation ==
+            server->tcp_connection_generation)) &&
+         query->server_info[i].sends < channel->tries;
+}
+
+/* Picks the server for a new query: the healthy one with the lowest round
+ * trip time, preferring those not measured yet so that every server gets
+ * measured, and configuration order on ties. A failing server whose bench
+ * time is up is given the query as a probe.
+ *
+ * For a retry of query, only the usable servers it has been sent to the
+ * fewest times are considered, so every server is tried once before any is
+ * tried again. Returns -1 if there is none left.
+ */
+int ares__pick_server(ares_channel channel, struct query *query,
+                      struct timeval *now)
+{
+  struct server_state *server;
+  int i, best = -1, fallback = -1, fewest = -1;
+
+  if (query)
+    {
+      for (i = 0; i < channel->nservers; i++)
         {
-           ares__send_query(channel, query, now);
-           return;
+          if (server_usable(channel, query, i) &&
+              (fewest == -1 || query->server_info[i].sends < fewest))
+            fewest = query->server_info[i].sends;
         }
+      if (fewest == -1)
+        return -1;
+    }
 
-      /* You might think that with TCP we only need one try. However,
-       * even when using TCP, servers can time-out our connection just
-       * as we're sending a request, or close our connection because
-       * they die, or never send us a reply because they get wedged or
-       * tickle a bug that drops our request.
-       */
+  for (i = 0; i < channel->nservers; i++)
+    {
+      if (query && (query->server_info[i].sends != fewest ||
+                    !server_usable(channel, query, i)))
+        continue;
+      server = &channel->servers[i];
+      if (server->failures)
+        {
+          if (ares__timedout(now, &server->probe_time))
+            {
+              /* One probe per bench period. */
+              server->probe_time = *now;
+              ares__timeadd(&server->probe_time, 1000);
+              return i;
+            }
+          if (fallback == -1 ||
+              server->failures < channel->servers[fallback].failures)
+            fallback = i;
+          continue;
+        }
+      if (best == -1 || server->rtt < channel->servers[best].rtt)
+        best = i;
+    }
+
+  return best != -1 ? best : fallback;
+}
+
+static void next_server(ares_channel channel, struct query *query,
+                        struct timeval *now)
+{
+  /* We need to try each server channel->tries times. Each retry goes where
+   * a new query would, among the servers we can still use for it; see
+   * ares__pick_server(). query->try_count counts the attempts so far.
+   *
+   * You might think that with TCP we only need one try. However, even
+   * when using TCP, servers can time-out our connection just as we're
+   * sending a request, or close our connection because they die, or never
+   * send us a reply because they get wedged or tickle a bug that drops
+   * our request.
+   */
+  int server = ares__pick_server(channel, query, now);
+
+  if (server != -1)
+    {
+      query->try_count++;
+      query->server = server;
+      ares__send_query(channel, query, now);
+      return;
     }
 
   /* If we are here, all attempts to perform query failed. */
@@ -729,6 +815,7 @@ void ares__send_query(ares_channel channel, struct query *query,
   int timeplus;
 
   server = &channel->servers[query->server];
+  query->server_info[query->server].sends++;
   if (query->using_tcp)
     {
       /* Make sure the TCP socket for this server is set up and queue
@@ -738,12 +825,13 @@ void ares__send_query(ares_channel channel, struct query *query,
         {
           if (open_tcp_socket(channel, server) == -1)
             {
+              server_failed(channel, NULL, query->server, now);
               skip_server(channel, query, query->server);
               next_server(channel, query, now);
               return;
             }
         }
-      sendreq = calloc(1, sizeof(struct send_request));
+      sendreq = ares__pool_alloc(channel, sizeof(struct send_request));
       if (!sendreq)
         {
         end_query(channel, query, ARES_ENOMEM, NULL, 0);
@@ -777,6 +865,7 @@ void ares__send_query(ares_channel channel, struct query *query,
         {
           if (open_udp_socket(channel, server) == -1)
             {
+              server_failed(channel, NULL, query->server, now);
               skip_server(channel, query, query->server);
               next_server(channel, query, now);
               return;
@@ -785,6 +874,7 @@ void ares__send_query(ares_channel channel, struct query *query,
       if (swrite(server->udp_socket, query->qbuf, query->qlen) == -1)
         {
           /* FIXME: Handle EAGAIN here since it likely can happen. */
+          server_failed(channel, NULL, query->server, now);
           skip_server(channel, query, query->server);
           next_server(channel, query, now);
           return;
@@ -792,6 +882,7 @@ void ares__send_query(ares_channel channel, struct query *query,
     }
     timeplus = channel->timeout << (query->try_count / channel->nservers);
     timeplus = (timeplus * (9 + (rand () & 7))) / 16;
+    query->sent = *now;
     query->timeout = *now;
     ares__timeadd(&query->timeout,
                   timeplus);
@@ -1237,7 +1328,8 @@ static void end_query (ares_channel channel, struct query *query, int status,
                  * handle these cases, we just give such sendreqs
                  * their own copy of the query packet.
                  */
-               sendreq->data_storage = malloc(sendreq->len);
+               sendreq->data_storage = ares__pool_alloc(channel,
+                                                        sendreq->len);
                if (sendreq->data_storage != NULL)
                  {
                    memcpy(sendreq->data_storage, sendreq->data, sendreq->len);
@@ -1264,7 +1356,7 @@ static void end_query (ares_channel channel, struct query *query, int status,
     }
 
   /* Invoke the callback */
-  query->callback(query->arg, status, query->timeouts, abuf, alen);
+  ares__query_callbacks(query, status, query->timeouts, abuf, alen);
   ares__free_query(query);
 
   /* Simple cleanup policy: if no queries are remaining, close all
@@ -1278,13 +1370,54 @@ static void end_query (ares_channel channel, struct query *query, int status,
     }
 }
 
+/* Invokes the query's callback and those of the callers that were waiting
+ * on it, in the order they asked.
+ */
+void ares__query_callbacks(struct query *query, int status, int timeouts,
+                           unsigned char *abuf, int alen)
+{
+  struct query_waiter *waiter;
+  struct query_waiter *next;
+  struct query_waiter *prev;
+
+  /* Callbacks that ask the same question again must get a new query. */
+  ares__remove_from_list(&(query->queries_by_question));
+
+  prev = NULL;
+  for (waiter = query->waiters; waiter; waiter = next)
+    {
+      next = waiter->next;
+      waiter->next = prev;
+      prev = waiter;
+    }
+  query->waiters = NULL;
+
+  query->callback(query->arg, status, timeouts, abuf, alen);
+
+  for (waiter = prev; waiter; waiter = next)
+    {
+      next = waiter->next;
+      waiter->callback(waiter->arg, status, timeouts, abuf, alen);
+      free(waiter);
+    }
+}
+
 void ares__free_query(struct query *query)
 {
+  struct query_waiter *waiter;
+
   /* Remove the query from all the lists in which it is linked */
   ares__remove_from_list(&(query->queries_by_qid));
   ares__remove_from_list(&(query->queries_by_timeout));
   ares__remove_from_list(&(query->queries_to_server));
   ares__remove_from_list(&(query->all_queries));
+  ares__remove_from_list(&(query->queries_by_question));
+  while (query->waiters)
+    {
+      waiter = query->waiters;
+      query->waiters = waiter->next;
+      free(waiter);
+    }
   /* Zero out some important stuff, to help catch bugs */
   query->callback = NULL;
   query->arg = NULL;
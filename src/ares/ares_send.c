@@ -38,10 +38,44 @@
 #include "ares_dns.h"
 #include "ares_private.h"
 
+/* Hashes everything but the query ID, which differs between callers. */
+static unsigned int question_hash(const unsigned char *qbuf, int qlen)
+{
+  unsigned int hash = 2166136261U;
+  int i;
+
+  for (i = 2; i < qlen; i++)
+    hash = (hash ^ qbuf[i]) * 16777619U;
+
+  return hash;
+}
+
+static struct query *find_query(ares_channel channel, unsigned int hash,
+                                const unsigned char *qbuf, int qlen)
+{
+  struct query *query;
+  struct list_node* list_head;
+  struct list_node* list_node;
+
+  list_head = &(channel->queries_by_question[hash % ARES_QUESTION_TABLE_SIZE]);
+  for (list_node = list_head->next; list_node != list_head;
+       list_node = list_node->next)
+    {
+      query = list_node->data;
+      if (query->question_hash == hash && query->qlen == qlen &&
+          memcmp(query->qbuf + 2, qbuf + 2, qlen - 2) == 0)
+        return query;
+    }
+
+  return NULL;
+}
+
 void ares_send(ares_channel channel, const unsigned char *qbuf, int qlen,
                ares_callback callback, void *arg)
 {
   struct query *query;
+  struct query_waiter *waiter;
+  unsigned int hash;
   int i;
   struct timeval now;
 
@@ -52,6 +86,30 @@ void ares_send(ares_channel channel, const unsigned char *qbuf, int qlen,
       return;
     }
 
+  /* If the same question is already on the wire, wait for its answer
+   * instead of asking again. Only on request: the waiters get an answer
+   * that carries the other query's ID.
+   */
+  hash = question_hash(qbuf, qlen);
+  if (channel->flags & ARES_FLAG_COALESCE)
+    {
+      query = find_query(channel, hash, qbuf, qlen);
+      if (query)
+        {
+          waiter = malloc(sizeof(struct query_waiter));
+          if (!waiter)
+            {
+              callback(arg, ARES_ENOMEM, 0, NULL, 0);
+              return;
+            }
+          waiter->callback = callback;
+          waiter->arg = arg;
+          waiter->next = query->waiters;
+          query->waiters = waiter;
+          return;
+        }
+    }
+
   /* Allocate space for query and allocated fields. */
   query = malloc(sizeof(struct query));
   if (!query)
@@ -94,20 +152,29 @@ void ares_send(ares_channel channel, const unsigned char *qbuf, int qlen,
   query->qlen = qlen;
   query->callback = callback;
   query->arg = arg;
+  query->question_hash = hash;
+  query->waiters = NULL;
 
   /* Initialize query status. */
   query->try_count = 0;
 
   /* Choose the server to send the query to. If rotation is enabled, keep track
-   * of the next server we want to use. */
-  query->server = channel->last_server;
+   * of the next server we want to use; otherwise go with the fastest one
+   * that is answering. */
+  now = ares__tvnow();
   if (channel->rotate == 1)
-    channel->last_server = (channel->last_server + 1) % channel->nservers;
+    {
+      query->server = channel->last_server;
+      channel->last_server = (channel->last_server + 1) % channel->nservers;
+    }
+  else
+    query->server = ares__pick_server(channel, NULL, &now);
 
   for (i = 0; i < channel->nservers; i++)
     {
       query->server_info[i].skip_server = 0;
       query->server_info[i].tcp_connection_generation = 0;
+      query->server_info[i].sends = 0;
     }
   query->using_tcp = (channel->flags & ARES_FLAG_USEVC) || qlen > PACKETSZ;
   query->error_status = ARES_ECONNREFUSED;
@@ -118,6 +185,7 @@ void ares_send(ares_channel channel, const unsigned char *qbuf, int qlen,
   ares__init_list_node(&(query->queries_by_timeout), query);
   ares__init_list_node(&(query->queries_to_server),  query);
   ares__init_list_node(&(query->all_queries),        query);
+  ares__init_list_node(&(query->queries_by_question), query);
 
   /* Chain the query into the list of all queries. */
   ares__insert_in_list(&(query->all_queries), &(channel->all_queries));
@@ -127,8 +195,12 @@ void ares_send(ares_channel channel, const unsigned char *qbuf, int qlen,
   ares__insert_in_list(
     &(query->queries_by_qid),
     &(channel->queries_by_qid[query->qid % ARES_QID_TABLE_SIZE]));
+  /* And by question, so identical queries can share this one. */
+  if (channel->flags & ARES_FLAG_COALESCE)
+    ares__insert_in_list(
+      &(query->queries_by_question),
+      &(channel->queries_by_question[hash % ARES_QUESTION_TABLE_SIZE]));
 
   /* Perform the first query action. */
-  now = ares__tvnow();
   ares__send_query(channel, query, &now);
 }
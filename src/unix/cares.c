@@ -28,9 +28,43 @@
 
 
 /*
- * This is called once per second by loop->timer. It is used to
- * constantly callback into c-ares for possibly processing timeouts.
+ * Arms loop->timer for the earliest pending c-ares timeout.
+ *
+ * A query sent on a socket that is already open doesn't go through any of
+ * our callbacks, and c-ares jitters each query's timeout, so a new query
+ * can be due before the ones already pending. The timer is therefore
+ * recomputed on every loop iteration while the channel has sockets open.
+ * With nothing pending the timer stays off.
  */
+static void uv__ares_update_timer(uv_loop_t* loop) {
+  struct timeval tv;
+  struct timeval* tvp;
+
+  ev_timer_stop(loop->ev, &loop->timer);
+
+  tvp = ares_timeout(loop->channel, NULL, &tv);
+  if (tvp == NULL)
+    return;
+
+  ev_timer_set(&loop->timer, tvp->tv_sec + tvp->tv_usec / 1e6, 0.);
+  ev_timer_start(loop->ev, &loop->timer);
+}
+
+
+/* Runs before the loop blocks, for as long as c-ares has sockets open. */
+static void uv__ares_prepare(struct ev_loop* ev, struct ev_prepare* watcher,
+    int revents) {
+  uv_loop_t* loop = ev_userdata(ev);
+
+  assert(ev == loop->ev);
+  assert(watcher == &loop->ares_prepare);
+  assert(revents == EV_PREPARE);
+
+  uv__ares_update_timer(loop);
+}
+
+
+/* Called by loop->timer when the earliest c-ares query is due. */
 static void uv__ares_timeout(struct ev_loop* ev, struct ev_timer* watcher,
     int revents) {
   uv_loop_t* loop = ev_userdata(ev);
@@ -51,9 +85,6 @@ static void uv__ares_io(struct ev_loop* ev, struct ev_io* watcher,
 
   assert(ev == loop->ev);
 
-  /* Reset the idle timer */
-  ev_timer_again(ev, &loop->timer);
-
   /* Process DNS responses */
   ares_process_fd(loop->channel,
       revents & EV_READ ? watcher->fd : ARES_SOCKET_BAD,
@@ -96,14 +127,15 @@ static void uv__ares_sockstate_cb(void* data, ares_socket_t sock,
     if (!h) {
       /* New socket */
 
-      /* If this is the first socket then start the timer. */
-      if (!ev_is_active(&loop->timer)) {
-        assert(uv_ares_handles_empty(loop));
-        ev_timer_again(loop->ev, &loop->timer);
+      /* If this is the first socket then start the prepare watcher. */
+      if (uv_ares_handles_empty(loop)) {
+        ev_prepare_start(loop->ev, &loop->ares_prepare);
       }
 
       h = uv__ares_task_create(sock);
-      uv_add_ares_handle(loop, h);
+      if (uv_add_ares_handle(loop, h)) {
+        uv_fatal_error(ENOMEM, "malloc");
+      }
     }
 
     if (read) {
@@ -133,6 +165,7 @@ static void uv__ares_sockstate_cb(void* data, ares_socket_t sock,
     free(h);
 
     if (uv_ares_handles_empty(loop)) {
+      ev_prepare_stop(loop->ev, &loop->ares_prepare);
       ev_timer_stop(loop->ev, &loop->timer);
     }
   }
@@ -143,6 +176,7 @@ static void uv__ares_sockstate_cb(void* data, ares_socket_t sock,
 /* TODO: share this with windows? */
 int uv_ares_init_options(uv_loop_t* loop, ares_channel *channelptr,
     struct ares_options *options, int optmask) {
+  struct ares_options opts;
   int rc;
 
   /* only allow single init at a time */
@@ -151,13 +185,24 @@ int uv_ares_init_options(uv_loop_t* loop, ares_channel *channelptr,
     return -1;
   }
 
+  /* Leave the caller's options alone. */
+  opts = *options;
+
   /* set our callback as an option */
-  options->sock_state_cb = uv__ares_sockstate_cb;
-  options->sock_state_cb_data = loop;
+  opts.sock_state_cb = uv__ares_sockstate_cb;
+  opts.sock_state_cb_data = loop;
   optmask |= ARES_OPT_SOCK_STATE_CB;
 
+  /* Identical queries in flight share one unless the caller passed flags
+   * of its own, see uv.h.
+   */
+  if (!(optmask & ARES_OPT_FLAGS)) {
+    opts.flags = ARES_FLAG_COALESCE;
+    optmask |= ARES_OPT_FLAGS;
+  }
+
   /* We do the call to ares_init_option for caller. */
-  rc = ares_init_options(channelptr, options, optmask);
+  rc = ares_init_options(channelptr, &opts, optmask);
 
   /* if success, save channel */
   if (rc == ARES_SUCCESS) {
@@ -165,11 +210,12 @@ int uv_ares_init_options(uv_loop_t* loop, ares_channel *channelptr,
   } 
 
   /*
-   * Initialize the timeout timer. The timer won't be started until the
-   * first socket is opened.
+   * Initialize the timeout timer and the prepare watcher that arms it.
+   * Neither is started until the first socket is opened.
    */
-  ev_timer_init(&loop->timer, uv__ares_timeout, 1., 1.);
+  ev_timer_init(&loop->timer, uv__ares_timeout, 0., 0.);
   loop->timer.data = loop;
+  ev_prepare_init(&loop->ares_prepare, uv__ares_prepare);
 
   return rc;
 }
@@ -179,6 +225,7 @@ int uv_ares_init_options(uv_loop_t* loop, ares_channel *channelptr,
 void uv_ares_destroy(uv_loop_t* loop, ares_channel channel) {
   /* only allow destroy if did init */
   if (loop->channel) {
+    ev_prepare_stop(loop->ev, &loop->ares_prepare);
     ev_timer_stop(loop->ev, &loop->timer);
     ares_destroy(channel);
     loop->channel = NULL;
@@ -163,12 +163,17 @@ uv_loop_t* uv_loop_new() {
   uv_loop_t* loop = calloc(1, sizeof(uv_loop_t));
   loop->ev = ev_loop_new(0);
   ev_set_userdata(loop->ev, loop);
+  uv__post_init(loop);
+  uv__work_init(loop);
+  uv__fs_init(loop);
   return loop;
 }
 
 
 void uv_loop_delete(uv_loop_t* loop) {
+  uv__getaddrinfo_cleanup(loop);
   uv_ares_destroy(loop, loop->channel);
+  uv__ares_handles_cleanup(loop);
   ev_loop_destroy(loop->ev);
   free(loop);
 }
@@ -183,6 +188,9 @@ uv_loop_t* uv_default_loop() {
     default_loop_struct.ev = ev_default_loop(EVFLAG_AUTO);
 #endif
     ev_set_userdata(default_loop_struct.ev, default_loop_ptr);
+    uv__post_init(default_loop_ptr);
+    uv__work_init(default_loop_ptr);
+    uv__fs_init(default_loop_ptr);
   }
   assert(default_loop_ptr->ev == EV_DEFAULT_UC);
   return default_loop_ptr;
@@ -587,100 +595,53 @@ int64_t uv_timer_get_repeat(uv_timer_t* timer) {
 }
 
 
-static int uv_getaddrinfo_done(eio_req* req) {
-  uv_getaddrinfo_t* handle = req->data;
-  struct addrinfo *res = handle->res;
-  handle->res = NULL;
+int uv_cancel(uv_loop_t* loop, uv_req_t* req) {
+  struct uv__work* w;
+  uv_err_code err;
+  eio_req* eio;
 
-  uv_unref(handle->loop);
-
-  free(handle->hints);
-  free(handle->service);
-  free(handle->hostname);
-
-  if (handle->retcode == 0) {
-    /* OK */
-  } else if (handle->retcode == EAI_NONAME || handle->retcode == EAI_NODATA) {
-    uv__set_sys_error(handle->loop, ENOENT); /* FIXME compatibility hack */
-  } else {
-    handle->loop->last_err.code = UV_EADDRINFO;
-    handle->loop->last_err.sys_errno_ = handle->retcode;
-  }
-
-  handle->cb(handle, handle->retcode, res);
-
-  return 0;
-}
+  w = NULL;
+  eio = NULL;
 
+  switch (req->type) {
+    case UV_WORK:
+      w = &((uv_work_t*) req)->work_req;
+      break;
 
-static void getaddrinfo_thread_proc(eio_req *req) {
-  uv_getaddrinfo_t* handle = req->data;
+    case UV_GETADDRINFO:
+      w = &((uv_getaddrinfo_t*) req)->work_req;
+      break;
 
-  handle->retcode = getaddrinfo(handle->hostname,
-                                handle->service,
-                                handle->hints,
-                                &handle->res);
-}
+    case UV_FS:
+      eio = ((uv_fs_t*) req)->eio;
+      break;
 
+    default:
+      break;
+  }
 
-/* stub implementation of uv_getaddrinfo */
-int uv_getaddrinfo(uv_loop_t* loop,
-                   uv_getaddrinfo_t* handle,
-                   uv_getaddrinfo_cb cb,
-                   const char* hostname,
-                   const char* service,
-                   const struct addrinfo* hints) {
-  eio_req* req;
-  uv_eio_init(loop);
+  if (w != NULL) {
+    if ((err = uv__work_cancel(w)) != UV_OK) {
+      uv__set_artificial_error(loop, err);
+      return -1;
+    }
+    return 0;
+  }
 
-  if (handle == NULL || cb == NULL ||
-      (hostname == NULL && service == NULL)) {
+  if (eio == NULL) {
     uv__set_artificial_error(loop, UV_EINVAL);
     return -1;
   }
 
-  uv__req_init((uv_req_t*)handle);
-  handle->type = UV_GETADDRINFO;
-  handle->loop = loop;
-  handle->cb = cb;
-
-  /* TODO don't alloc so much. */
-
-  if (hints) {
-    handle->hints = malloc(sizeof(struct addrinfo));
-    memcpy(handle->hints, hints, sizeof(struct addrinfo));
-  }
-  else {
-    handle->hints = NULL;
-  }
-
-  /* TODO security! check lengths, check return values. */
-
-  handle->hostname = hostname ? strdup(hostname) : NULL;
-  handle->service = service ? strdup(service) : NULL;
-  handle->res = NULL;
-  handle->retcode = 0;
-
-  /* TODO check handle->hostname == NULL */
-  /* TODO check handle->service == NULL */
-
-  uv_ref(loop);
-
-  req = eio_custom(getaddrinfo_thread_proc, EIO_PRI_DEFAULT,
-      uv_getaddrinfo_done, handle);
-  assert(req);
-  assert(req->data == handle);
+  /* libeio skips requests that are cancelled before a thread picks them up
+   * and fails them with ECANCELED. The finish callback runs either way.
+   */
+  eio_cancel(eio);
 
   return 0;
 }
 
 
-void uv_freeaddrinfo(struct addrinfo* ai) {
-  if (ai)
-    freeaddrinfo(ai);
-}
-
-
 /* Open a socket in non-blocking close-on-exec mode, atomically if possible. */
 int uv__socket(int domain, int type, int protocol) {
 #if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
@@ -76,6 +76,9 @@ static int uv__translate_lib_error(int code) {
     case UV_ENOTCONN: return ENOTCONN;
     case UV_EEXIST: return EEXIST;
     case UV_EHOSTUNREACH: return EHOSTUNREACH;
+    case UV_ECANCELED: return ECANCELED;
+    case UV_EBUSY: return EBUSY;
+    case UV_EINTR: return EINTR;
     default: return -1;
   }
 
@@ -105,6 +108,9 @@ uv_err_code uv_translate_sys_error(int sys_errno) {
     case ENOTCONN: return UV_ENOTCONN;
     case EEXIST: return UV_EEXIST;
     case EHOSTUNREACH: return UV_EHOSTUNREACH;
+    case ECANCELED: return UV_ECANCELED;
+    case EBUSY: return UV_EBUSY;
+    case EINTR: return UV_EINTR;
     case EAI_NONAME: return UV_ENOENT;
     default: return UV_UNKNOWN;
   }
@@ -32,7 +32,31 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <utime.h>
+#include <limits.h>
+#include <sys/mman.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) || defined(__FreeBSD__)
+# define HAVE_PREADV 1
+#endif
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__)
+# define HAVE_POSIX_FADVISE 1
+#endif
+
+#if defined(__linux__) && defined(RWF_NOWAIT)
+# define HAVE_PREADV2_NOWAIT 1
+#endif
+
+#ifndef IOV_MAX
+# define IOV_MAX 16
+#endif
+
+#if defined(_DIRENT_HAVE_D_TYPE) || defined(__APPLE__) || \
+    defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+# define HAVE_DIRENT_TYPES 1
+#endif
 
 
 #define ARGS1(a)       (a)
@@ -76,6 +100,12 @@ static void uv_fs_req_init(uv_loop_t* loop, uv_fs_t* req, uv_fs_type fs_type,
   req->path = path ? strdup(path) : NULL;
   req->errorno = 0;
   req->eio = NULL;
+  req->bufs = NULL;
+  req->nbufs = 0;
+  req->ops = NULL;
+  req->nops = 0;
+  req->length = 0;
+  req->flags = 0;
 }
 
 
@@ -95,18 +125,107 @@ void uv_fs_req_cleanup(uv_fs_t* req) {
       req->ptr = NULL;
       break;
 
+    case UV_FS_READ_FILE:
+      free(req->ptr);
+      req->ptr = NULL;
+      break;
+
     default:
       break;
   }
 }
 
 
+static void uv__fs_bufs_free(uv_fs_t* req) {
+  if (req->bufs != req->bufsml) {
+    free(req->bufs);
+  }
+  req->bufs = NULL;
+  req->nbufs = 0;
+}
+
+
+static unsigned char uv__fs_eio_type(const struct dirent* entry) {
+#if HAVE_DIRENT_TYPES
+  switch (entry->d_type) {
+    case DT_REG:  return EIO_DT_REG;
+    case DT_DIR:  return EIO_DT_DIR;
+    case DT_LNK:  return EIO_DT_LNK;
+    case DT_FIFO: return EIO_DT_FIFO;
+    case DT_SOCK: return EIO_DT_SOCK;
+    case DT_CHR:  return EIO_DT_CHR;
+    case DT_BLK:  return EIO_DT_BLK;
+  }
+#endif
+  return EIO_DT_UNKNOWN;
+}
+
+
+static int uv__fs_is_dot(const char* name) {
+  return name[0] == '.' &&
+    (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+
+static uv_dirent_type_t uv__fs_dirent_type(unsigned char type) {
+  switch (type) {
+    case EIO_DT_REG:  return UV_DIRENT_FILE;
+    case EIO_DT_DIR:  return UV_DIRENT_DIR;
+    case EIO_DT_LNK:  return UV_DIRENT_LINK;
+    case EIO_DT_FIFO: return UV_DIRENT_FIFO;
+    case EIO_DT_SOCK: return UV_DIRENT_SOCKET;
+    case EIO_DT_CHR:  return UV_DIRENT_CHAR;
+    case EIO_DT_BLK:  return UV_DIRENT_BLOCK;
+    default:          return UV_DIRENT_UNKNOWN;
+  }
+}
+
+
+static int uv__fs_dirent_cmp(const void* a, const void* b) {
+  const eio_dirent* x = a;
+  const eio_dirent* y = b;
+  return x->inode < y->inode ? -1 : x->inode > y->inode;
+}
+
+
+/*
+ * Copies n entries in libeio's format into one block that holds the
+ * uv_dirent_t array followed by the names, so that uv_fs_req_cleanup()
+ * frees both with req->ptr.
+ */
+static uv_dirent_t* uv__fs_dirents(const eio_dirent* dents, const char* names,
+    int n) {
+  uv_dirent_t* ents;
+  size_t size;
+  char* name;
+  int i;
+
+  size = 0;
+  for (i = 0; i < n; i++) {
+    size += dents[i].namelen + 1;
+  }
+
+  ents = malloc(n * sizeof(*ents) + size);
+  if (ents == NULL) {
+    return NULL;
+  }
+
+  name = (char*) (ents + n);
+  for (i = 0; i < n; i++) {
+    memcpy(name, names + dents[i].nameofs, dents[i].namelen + 1);
+    ents[i].name = name;
+    ents[i].type = uv__fs_dirent_type(dents[i].type);
+    ents[i].ino = dents[i].inode;
+    name += dents[i].namelen + 1;
+  }
+
+  return ents;
+}
+
+
 static int uv__fs_after(eio_req* eio) {
   char* name;
-  int namelen;
-  int buflen = 0;
   uv_fs_t* req = eio->data;
-  int i;
 
   assert(req->cb);
 
@@ -115,29 +234,25 @@ static int uv__fs_after(eio_req* eio) {
 
   switch (req->fs_type) {
     case UV_FS_READDIR:
-      /*
-       * XXX This is pretty bad.
-       * We alloc and copy the large null terminated string list from libeio.
-       * This is done because libeio is going to free eio->ptr2 after this
-       * callback. We must keep it until uv_fs_req_cleanup. If we get rid of
-       * libeio this can be avoided.
-       */
-      buflen = 0;
-      name = req->eio->ptr2;
-
-      for (i = 0; i < req->result; i++) {
-        namelen = strlen(name);
-        buflen += namelen + 1;
-        name += namelen;
-        assert(*name == '\0');
-        name++;
+      if (req->eio->ptr1 && req->result > 0) {
+        /* UV_FS_READDIR_TYPES, libeio listed dirents in ptr1. */
+        req->ptr = uv__fs_dirents(req->eio->ptr1, req->eio->ptr2,
+            req->result);
+        if (req->ptr == NULL) {
+          req->result = -1;
+          req->errorno = UV_ENOMEM;
+          uv__set_sys_error(req->loop, ENOMEM);
+        }
+        break;
       }
 
-      if (buflen) {
-        if ((req->ptr = malloc(buflen)))
-          memcpy(req->ptr, req->eio->ptr2, buflen);
-        else
-          uv__set_sys_error(req->loop, ENOMEM);
+      /*
+       * Take the NUL separated name list over from libeio, which would
+       * otherwise free it after this callback. uv_fs_req_cleanup() frees it.
+       */
+      if (req->result > 0) {
+        req->ptr = req->eio->ptr2;
+        req->eio->flags &= ~EIO_FLAG_PTR2_FREE;
       }
       break;
 
@@ -166,6 +281,11 @@ static int uv__fs_after(eio_req* eio) {
       }
       break;
 
+    case UV_FS_READV:
+    case UV_FS_WRITEV:
+      uv__fs_bufs_free(req);
+      break;
+
     default:
       break;
   }
@@ -178,35 +298,735 @@ static int uv__fs_after(eio_req* eio) {
 }
 
 
-int uv_fs_close(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
-  char* path = NULL;
-  WRAP_EIO(UV_FS_CLOSE, eio_close, close, ARGS1(file));
+int uv_fs_close(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
+  char* path = NULL;
+  WRAP_EIO(UV_FS_CLOSE, eio_close, close, ARGS1(file));
+}
+
+
+int uv_fs_open(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
+    int mode, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_OPEN, path, cb);
+
+  if (cb) {
+    /* async */
+    uv_ref(loop);
+    req->eio = eio_open(path, flags, mode, EIO_PRI_DEFAULT, uv__fs_after, req);
+    if (!req->eio) {
+      uv__set_sys_error(loop, ENOMEM);
+      return -1;
+    }
+
+  } else {
+    /* sync */
+    req->result = open(path, flags, mode);
+    if (req->result < 0) {
+      uv__set_sys_error(loop, errno);
+      return -1;
+    }
+
+    uv__cloexec(req->result, 1);
+
+    return req->result;
+  }
+
+  return 0;
+}
+
+
+/* Runs the callbacks of the reads that uv__fs_read_inline() completed. */
+static void uv__fs_inline_done(uv_loop_t* loop) {
+  ngx_queue_t queue;
+  ngx_queue_t* q;
+  uv_fs_t* req;
+
+  if (ngx_queue_empty(&loop->fs_inline_queue)) {
+    return;
+  }
+
+  /*
+   * Reads issued from these callbacks wait for the next loop iteration, a
+   * chain of cached reads must not keep the loop from polling.
+   */
+  q = ngx_queue_head(&loop->fs_inline_queue);
+  ngx_queue_split(&loop->fs_inline_queue, q, &queue);
+
+  while (!ngx_queue_empty(&queue)) {
+    q = ngx_queue_head(&queue);
+    ngx_queue_remove(q);
+    req = ngx_queue_data(q, uv_fs_t, inline_queue);
+    req->cb(req);
+  }
+
+  if (ngx_queue_empty(&loop->fs_inline_queue)) {
+    ev_prepare_stop(loop->ev, &loop->fs_inline_prepare);
+    ev_idle_stop(loop->ev, &loop->fs_inline_idle);
+  }
+}
+
+
+static void uv__fs_inline_prepare(struct ev_loop* ev, ev_prepare* watcher,
+    int revents) {
+  uv_loop_t* loop = ev_userdata(ev);
+
+  assert(watcher == &loop->fs_inline_prepare);
+  assert(revents == EV_PREPARE);
+
+  uv__fs_inline_done(loop);
+}
+
+
+/*
+ * Only started so that the loop doesn't block while callbacks are queued,
+ * uv__fs_inline_prepare() runs them.
+ */
+static void uv__fs_inline_idle(struct ev_loop* ev, ev_idle* watcher,
+    int revents) {
+  uv_loop_t* loop = ev_userdata(ev);
+
+  assert(watcher == &loop->fs_inline_idle);
+  assert(revents == EV_IDLE);
+
+  uv__fs_inline_done(loop);
+}
+
+
+void uv__fs_init(uv_loop_t* loop) {
+  ngx_queue_init(&loop->fs_inline_queue);
+  ev_prepare_init(&loop->fs_inline_prepare, uv__fs_inline_prepare);
+  ev_idle_init(&loop->fs_inline_idle, uv__fs_inline_idle);
+}
+
+
+/*
+ * Tries an async read on the loop thread. RWF_NOWAIT makes preadv2() fail
+ * with EAGAIN rather than wait for the disk, so this only succeeds when the
+ * data is in the page cache. Returns 0 when the read is done and its
+ * callback queued, -1 when it has to go to the thread pool; that includes
+ * errors, so that they are reported the same way as before.
+ *
+ * A short read means part of the range wasn't cached (or EOF, which we can't
+ * tell apart cheaply), the thread pool redoes the whole read. Reads at the
+ * file position are never done here: they would overtake the ones that are
+ * still in the thread pool.
+ */
+static int uv__fs_read_inline(uv_loop_t* loop, uv_fs_t* req, uv_file fd,
+    void* buf, size_t length, off_t offset) {
+#if HAVE_PREADV2_NOWAIT
+  static int no_preadv2;
+  struct iovec iov;
+  ssize_t n;
+
+  if (no_preadv2 || offset < 0) {
+    return -1;
+  }
+
+  iov.iov_base = buf;
+  iov.iov_len = length;
+
+  do {
+    n = preadv2(fd, &iov, 1, offset, RWF_NOWAIT);
+  } while (n == -1 && errno == EINTR);
+
+  if (n == -1) {
+    /* glibc has it but the kernel doesn't. EOPNOTSUPP is per file. */
+    if (errno == ENOSYS) {
+      no_preadv2 = 1;
+    }
+    return -1;
+  }
+
+  if ((size_t) n != length) {
+    return -1;
+  }
+
+  req->result = n;
+
+  if (ngx_queue_empty(&loop->fs_inline_queue)) {
+    ev_prepare_start(loop->ev, &loop->fs_inline_prepare);
+    ev_idle_start(loop->ev, &loop->fs_inline_idle);
+  }
+  ngx_queue_insert_tail(&loop->fs_inline_queue, &req->inline_queue);
+
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+
+int uv_fs_read(uv_loop_t* loop, uv_fs_t* req, uv_file fd, void* buf,
+    size_t length, off_t offset, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_READ, NULL, cb);
+
+  if (cb) {
+    /* async */
+    if (uv__fs_read_inline(loop, req, fd, buf, length, offset) == 0) {
+      loop->counters.fs_read_inline++;
+      return 0;
+    }
+
+    loop->counters.fs_read_offloaded++;
+    uv_ref(loop);
+    req->eio = eio_read(fd, buf, length, offset, EIO_PRI_DEFAULT,
+        uv__fs_after, req);
+
+    if (!req->eio) {
+      uv__set_sys_error(loop, ENOMEM);
+      return -1;
+    }
+
+  } else {
+    /* sync */
+    req->result = offset < 0 ?
+      read(fd, buf, length) :
+      pread(fd, buf, length, offset);
+
+    if (req->result < 0) {
+      uv__set_sys_error(loop, errno);
+      return -1;
+    }
+
+    return req->result;
+  }
+
+  return 0;
+}
+
+
+int uv_fs_unlink(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
+  WRAP_EIO(UV_FS_UNLINK, eio_unlink, unlink, ARGS1(path))
+}
+
+
+int uv_fs_write(uv_loop_t* loop, uv_fs_t* req, uv_file file, void* buf,
+    size_t length, off_t offset, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_WRITE, NULL, cb);
+
+  if (cb) {
+    /* async */
+    uv_ref(loop);
+    req->eio = eio_write(file, buf, length, offset, EIO_PRI_DEFAULT,
+        uv__fs_after, req);
+    if (!req->eio) {
+      uv__set_sys_error(loop, ENOMEM);
+      return -1;
+    }
+
+  } else {
+    /* sync */
+    req->result = offset < 0 ?
+        write(file, buf, length) :
+        pwrite(file, buf, length, offset);
+
+    if (req->result < 0) {
+      uv__set_sys_error(loop, errno);
+      return -1;
+    }
+
+    return req->result;
+  }
+
+  return 0;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_rw(uv_fs_t* req) {
+  struct iovec* iov;
+  int nbufs;
+  int reading;
+#if !HAVE_PREADV
+  ssize_t total;
+  ssize_t n;
+  int i;
+#endif
+
+  assert(sizeof(uv_buf_t) == sizeof(struct iovec));
+  iov = (struct iovec*) req->bufs;
+  nbufs = req->nbufs > IOV_MAX ? IOV_MAX : req->nbufs;
+  reading = (req->fs_type == UV_FS_READV);
+
+  if (req->offset < 0) {
+    return reading ?
+      readv(req->file, iov, nbufs) :
+      writev(req->file, iov, nbufs);
+  }
+
+#if HAVE_PREADV
+  return reading ?
+    preadv(req->file, iov, nbufs, req->offset) :
+    pwritev(req->file, iov, nbufs, req->offset);
+#else
+  /* No preadv(2) here, do one pread(2) per buffer until one comes up short. */
+  total = 0;
+
+  for (i = 0; i < nbufs; i++) {
+    n = reading ?
+      pread(req->file, iov[i].iov_base, iov[i].iov_len, req->offset + total) :
+      pwrite(req->file, iov[i].iov_base, iov[i].iov_len, req->offset + total);
+
+    if (n < 0) {
+      return total > 0 ? total : -1;
+    }
+
+    total += n;
+
+    if ((size_t) n < iov[i].iov_len) {
+      break;
+    }
+  }
+
+  return total;
+#endif
+}
+
+
+/*
+ * Fills up to dir->nentries of dir->dirents, the names go in dir->names.
+ * Shared by uv_fs_readdir_chunk() and uv_fs_walk().
+ */
+static ssize_t uv__dir_read(uv_dir_t* dir) {
+  struct dirent* entry;
+  unsigned int n;
+  unsigned int i;
+  size_t used;
+  size_t len;
+  size_t size;
+  char* names;
+
+  used = 0;
+  n = 0;
+
+  while (n < dir->nentries) {
+    errno = 0;
+    entry = readdir(dir->dir);
+    if (entry == NULL) {
+      if (errno != 0 && n == 0) {
+        return -1;
+      }
+      break;
+    }
+
+    if (uv__fs_is_dot(entry->d_name)) {
+      continue;
+    }
+
+    len = strlen(entry->d_name) + 1;
+
+    if (used + len > dir->names_size) {
+      size = dir->names_size ? dir->names_size : 4096;
+      while (used + len > size) {
+        size *= 2;
+      }
+      if ((names = realloc(dir->names, size)) == NULL) {
+        errno = ENOMEM;
+        return -1;
+      }
+      dir->names = names;
+      dir->names_size = size;
+    }
+
+    memcpy(dir->names + used, entry->d_name, len);
+    dir->dirents[n].type = uv__fs_dirent_type(uv__fs_eio_type(entry));
+    dir->dirents[n].ino = entry->d_ino;
+    used += len;
+    n++;
+  }
+
+  /* Point at the names last, the buffer may have moved while filling it. */
+  names = dir->names;
+  for (i = 0; i < n; i++) {
+    dir->dirents[i].name = names;
+    names += strlen(names) + 1;
+  }
+
+  return n;
+}
+
+
+static int uv__dir_close(uv_dir_t* dir) {
+  int saved_errno;
+  int r;
+
+  r = closedir(dir->dir);
+  saved_errno = errno;
+  free(dir->names);
+  dir->dir = NULL;
+  dir->names = NULL;
+  dir->names_size = 0;
+  errno = saved_errno;
+
+  return r;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_opendir(uv_fs_t* req) {
+  uv_dir_t* dir = req->ptr;
+
+  dir->dir = opendir(req->path);
+  if (dir->dir == NULL) {
+    free(dir);
+    req->ptr = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_readdir_chunk(uv_fs_t* req) {
+  return uv__dir_read(req->ptr);
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_closedir(uv_fs_t* req) {
+  int r;
+
+  r = uv__dir_close(req->ptr);
+  free(req->ptr);
+  req->ptr = NULL;
+
+  return r;
+}
+
+
+static ssize_t uv__fs_op(uv_fs_op_t* op, uv_file file) {
+  switch (op->type) {
+    case UV_FS_OPEN:
+      return open(op->path, op->flags, op->mode);
+    case UV_FS_CLOSE:
+      return close(file);
+    case UV_FS_READ:
+      return op->offset < 0 ?
+        read(file, op->buf.base, op->buf.len) :
+        pread(file, op->buf.base, op->buf.len, op->offset);
+    case UV_FS_WRITE:
+      return op->offset < 0 ?
+        write(file, op->buf.base, op->buf.len) :
+        pwrite(file, op->buf.base, op->buf.len, op->offset);
+    case UV_FS_FSTAT:
+      return fstat(file, &op->statbuf);
+    case UV_FS_STAT:
+      return stat(op->path, &op->statbuf);
+    case UV_FS_FSYNC:
+      return fsync(file);
+    case UV_FS_UNLINK:
+      return unlink(op->path);
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_batch(uv_fs_t* req) {
+  uv_fs_op_t* op;
+  uv_file opened;
+  uv_file file;
+  int error;
+  int i;
+
+  opened = -1;
+  error = 0;
+
+  for (i = 0; i < req->nops; i++) {
+    op = &req->ops[i];
+    file = op->file < 0 ? opened : op->file;
+
+    /* After a failure only close what is still open. */
+    if (error && (op->type != UV_FS_CLOSE || file < 0)) {
+      op->result = -1;
+      op->errorno = UV_ECANCELED;
+      continue;
+    }
+
+    op->result = uv__fs_op(op, file);
+
+    if (op->result < 0) {
+      op->errorno = uv_translate_sys_error(errno);
+      if (!error) {
+        error = errno;
+      }
+      continue;
+    }
+
+    op->errorno = 0;
+    if (op->type == UV_FS_OPEN) {
+      opened = op->result;
+    } else if (op->type == UV_FS_CLOSE && file == opened) {
+      opened = -1;
+    }
+  }
+
+  if (error) {
+    errno = error;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_read_file(uv_fs_t* req) {
+  struct stat st;
+  size_t size;
+  size_t len;
+  ssize_t n;
+  char* buf;
+  char* tmp;
+  int saved_errno;
+  int fd;
+
+  buf = NULL;
+  len = 0;
+
+  if ((fd = open(req->path, O_RDONLY)) == -1) {
+    return -1;
+  }
+
+  if (fstat(fd, &st)) {
+    goto error;
+  }
+
+  /*
+   * One byte more than the file size. The read that finds EOF goes into it,
+   * and the buffer only grows if the file did too. Afterwards it holds the
+   * NUL. Files like those in /proc report a size of 0.
+   */
+  size = st.st_size > 0 ? (size_t) st.st_size + 1 : 4096;
+  if ((buf = malloc(size)) == NULL) {
+    errno = ENOMEM;
+    goto error;
+  }
+
+  for (;;) {
+    if (len == size) {
+      if ((tmp = realloc(buf, size * 2)) == NULL) {
+        errno = ENOMEM;
+        goto error;
+      }
+      buf = tmp;
+      size *= 2;
+    }
+
+    do {
+      n = read(fd, buf + len, size - len);
+    } while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+      goto error;
+    }
+
+    if (n == 0) {
+      break;
+    }
+
+    len += n;
+  }
+
+  /* EOF came right when the buffer was full. */
+  if (len == size) {
+    if ((tmp = realloc(buf, size + 1)) == NULL) {
+      errno = ENOMEM;
+      goto error;
+    }
+    buf = tmp;
+  }
+
+  close(fd);
+  buf[len] = '\0';
+  req->ptr = buf;
+
+  return len;
+
+error:
+  saved_errno = errno;
+  close(fd);
+  free(buf);
+  errno = saved_errno;
+  return -1;
+}
+
+
+/* Like eio_mtouch() without the extra thread pool hop. */
+static void uv__fs_mtouch(const char* addr, size_t length) {
+  static long pagesize;
+  volatile char c;
+  size_t i;
+
+  if (pagesize == 0) {
+    pagesize = sysconf(_SC_PAGESIZE);
+  }
+
+  for (i = 0; i < length; i += pagesize) {
+    c = addr[i];
+  }
+
+  (void) c;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_mmap(uv_fs_t* req) {
+  struct stat st;
+  size_t length;
+  void* addr;
+  int saved_errno;
+
+  length = req->length;
+
+  if (length == 0) {
+    if (fstat(req->file, &st)) {
+      return -1;
+    }
+
+    if (st.st_size <= req->offset) {
+      return 0;
+    }
+
+    if (st.st_size - req->offset > (off_t) SSIZE_MAX) {
+      errno = EFBIG;
+      return -1;
+    }
+
+    length = st.st_size - req->offset;
+  }
+
+  addr = mmap(NULL, length, PROT_READ, MAP_SHARED, req->file, req->offset);
+  if (addr == MAP_FAILED) {
+    return -1;
+  }
+
+  /* Only a hint, not worth failing the request over. */
+  if (req->flags & UV_FS_MMAP_WILLNEED) {
+    madvise(addr, length, MADV_WILLNEED);
+  }
+
+  if (req->flags & UV_FS_MMAP_LOCK) {
+    if (mlock(addr, length)) {
+      saved_errno = errno;
+      munmap(addr, length);
+      errno = saved_errno;
+      return -1;
+    }
+  } else if (req->flags & UV_FS_MMAP_POPULATE) {
+    uv__fs_mtouch(addr, length);
+  }
+
+  req->ptr = addr;
+
+  return length;
+}
+
+
+/* Runs on the thread pool for async requests. */
+static ssize_t uv__fs_fadvise(uv_fs_t* req) {
+#if HAVE_POSIX_FADVISE
+  int advice;
+  int r;
+
+  switch (req->flags) {
+    case UV_FS_ADVISE_NORMAL:
+      advice = POSIX_FADV_NORMAL;
+      break;
+    case UV_FS_ADVISE_SEQUENTIAL:
+      advice = POSIX_FADV_SEQUENTIAL;
+      break;
+    case UV_FS_ADVISE_RANDOM:
+      advice = POSIX_FADV_RANDOM;
+      break;
+    case UV_FS_ADVISE_WILLNEED:
+      advice = POSIX_FADV_WILLNEED;
+      break;
+    case UV_FS_ADVISE_DONTNEED:
+      advice = POSIX_FADV_DONTNEED;
+      break;
+    case UV_FS_ADVISE_NOREUSE:
+      advice = POSIX_FADV_NOREUSE;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+
+  /* Returns the error rather than setting errno. */
+  if ((r = posix_fadvise(req->file, req->offset, req->length, advice))) {
+    errno = r;
+    return -1;
+  }
+
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+
+/* Requests that libeio has no call for. */
+static ssize_t uv__fs_run(uv_fs_t* req) {
+  switch (req->fs_type) {
+    case UV_FS_READV:
+    case UV_FS_WRITEV:
+      return uv__fs_rw(req);
+    case UV_FS_OPENDIR:
+      return uv__fs_opendir(req);
+    case UV_FS_READDIR_CHUNK:
+      return uv__fs_readdir_chunk(req);
+    case UV_FS_CLOSEDIR:
+      return uv__fs_closedir(req);
+    case UV_FS_BATCH:
+      return uv__fs_batch(req);
+    case UV_FS_READ_FILE:
+      return uv__fs_read_file(req);
+    case UV_FS_MMAP:
+      return uv__fs_mmap(req);
+    case UV_FS_MUNMAP:
+      /* uv_fs_mmap() hands out empty mappings for empty files. */
+      return req->length ? munmap(req->ptr, req->length) : 0;
+    case UV_FS_FADVISE:
+      return uv__fs_fadvise(req);
+    default:
+      assert(0 && "unexpected fs_type");
+      errno = ENOSYS;
+      return -1;
+  }
+}
+
+
+static void uv__fs_work(eio_req* eio) {
+  eio->result = uv__fs_run((uv_fs_t*) eio->data);
 }
 
 
-int uv_fs_open(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
-    int mode, uv_fs_cb cb) {
-  uv_fs_req_init(loop, req, UV_FS_OPEN, path, cb);
-
+/* Like WRAP_EIO but for requests run by uv__fs_run(). */
+static int uv__fs_submit(uv_loop_t* loop, uv_fs_t* req, uv_fs_cb cb) {
   if (cb) {
     /* async */
-    uv_ref(loop);
-    req->eio = eio_open(path, flags, mode, EIO_PRI_DEFAULT, uv__fs_after, req);
+    req->eio = eio_custom(uv__fs_work, EIO_PRI_DEFAULT, uv__fs_after, req);
     if (!req->eio) {
+      uv__fs_bufs_free(req);
       uv__set_sys_error(loop, ENOMEM);
       return -1;
     }
+    uv_ref(loop);
 
   } else {
     /* sync */
-    req->result = open(path, flags, mode);
+    req->result = uv__fs_run(req);
+    uv__fs_bufs_free(req);
+
     if (req->result < 0) {
       uv__set_sys_error(loop, errno);
       return -1;
     }
 
-    uv__cloexec(req->result, 1);
-
     return req->result;
   }
 
@@ -214,73 +1034,131 @@ int uv_fs_open(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
 }
 
 
-int uv_fs_read(uv_loop_t* loop, uv_fs_t* req, uv_file fd, void* buf,
-    size_t length, off_t offset, uv_fs_cb cb) {
-  uv_fs_req_init(loop, req, UV_FS_READ, NULL, cb);
+static int uv__fs_vectored(uv_loop_t* loop, uv_fs_t* req, uv_fs_type fs_type,
+    uv_file file, uv_buf_t bufs[], int nbufs, off_t offset, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, fs_type, NULL, cb);
 
-  if (cb) {
-    /* async */
-    uv_ref(loop);
-    req->eio = eio_read(fd, buf, length, offset, EIO_PRI_DEFAULT,
-        uv__fs_after, req);
+  if (nbufs < 0) {
+    uv__set_sys_error(loop, EINVAL);
+    return -1;
+  }
 
-    if (!req->eio) {
-      uv__set_sys_error(loop, ENOMEM);
-      return -1;
-    }
+  if (nbufs <= UV_REQ_BUFSML_SIZE) {
+    req->bufs = req->bufsml;
+  } else if ((req->bufs = malloc(nbufs * sizeof(bufs[0]))) == NULL) {
+    uv__set_sys_error(loop, ENOMEM);
+    return -1;
+  }
 
-  } else {
-    /* sync */
-    req->result = offset < 0 ?
-      read(fd, buf, length) :
-      pread(fd, buf, length, offset);
+  memcpy(req->bufs, bufs, nbufs * sizeof(bufs[0]));
+  req->nbufs = nbufs;
+  req->file = file;
+  req->offset = offset;
 
-    if (req->result < 0) {
-      uv__set_sys_error(loop, errno);
-      return -1;
-    }
+  return uv__fs_submit(loop, req, cb);
+}
 
-    return req->result;
+
+int uv_fs_readv(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_buf_t bufs[],
+    int nbufs, off_t offset, uv_fs_cb cb) {
+  return uv__fs_vectored(loop, req, UV_FS_READV, file, bufs, nbufs, offset,
+      cb);
+}
+
+
+int uv_fs_writev(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_buf_t bufs[],
+    int nbufs, off_t offset, uv_fs_cb cb) {
+  return uv__fs_vectored(loop, req, UV_FS_WRITEV, file, bufs, nbufs, offset,
+      cb);
+}
+
+
+int uv_fs_batch(uv_loop_t* loop, uv_fs_t* req, uv_fs_op_t ops[], int nops,
+    uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_BATCH, NULL, cb);
+
+  if (nops < 0) {
+    uv__set_sys_error(loop, EINVAL);
+    return -1;
   }
 
-  return 0;
+  req->ops = ops;
+  req->nops = nops;
+
+  return uv__fs_submit(loop, req, cb);
 }
 
 
-int uv_fs_unlink(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
-  WRAP_EIO(UV_FS_UNLINK, eio_unlink, unlink, ARGS1(path))
+int uv_fs_read_file(uv_loop_t* loop, uv_fs_t* req, const char* path,
+    uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_READ_FILE, path, cb);
+  return uv__fs_submit(loop, req, cb);
 }
 
 
-int uv_fs_write(uv_loop_t* loop, uv_fs_t* req, uv_file file, void* buf,
-    size_t length, off_t offset, uv_fs_cb cb) {
-  uv_fs_req_init(loop, req, UV_FS_WRITE, NULL, cb);
+int uv_fs_mmap(uv_loop_t* loop, uv_fs_t* req, uv_file file, size_t length,
+    off_t offset, int flags, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_MMAP, NULL, cb);
 
-  if (cb) {
-    /* async */
-    uv_ref(loop);
-    req->eio = eio_write(file, buf, length, offset, EIO_PRI_DEFAULT,
-        uv__fs_after, req);
-    if (!req->eio) {
-      uv__set_sys_error(loop, ENOMEM);
-      return -1;
-    }
+  if (length > (size_t) SSIZE_MAX || offset < 0) {
+    uv__set_sys_error(loop, EINVAL);
+    return -1;
+  }
 
-  } else {
-    /* sync */
-    req->result = offset < 0 ?
-        write(file, buf, length) :
-        pwrite(file, buf, length, offset);
+  req->file = file;
+  req->length = length;
+  req->offset = offset;
+  req->flags = flags;
 
-    if (req->result < 0) {
-      uv__set_sys_error(loop, errno);
-      return -1;
-    }
+  return uv__fs_submit(loop, req, cb);
+}
 
-    return req->result;
+
+int uv_fs_munmap(uv_loop_t* loop, uv_fs_t* req, void* addr, size_t length,
+    uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_MUNMAP, NULL, cb);
+  req->ptr = addr;
+  req->length = length;
+  return uv__fs_submit(loop, req, cb);
+}
+
+
+int uv_fs_fadvise(uv_loop_t* loop, uv_fs_t* req, uv_file file, off_t offset,
+    size_t length, uv_fs_advice advice, uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_FADVISE, NULL, cb);
+  req->file = file;
+  req->offset = offset;
+  req->length = length;
+  req->flags = advice;
+  return uv__fs_submit(loop, req, cb);
+}
+
+
+/* The sync counterpart of eio_readahead(). */
+static int _readahead(uv_file file, off_t offset, size_t length) {
+#if defined(__linux__)
+  return readahead(file, offset, length);
+#elif HAVE_POSIX_FADVISE
+  int r;
+
+  if ((r = posix_fadvise(file, offset, length, POSIX_FADV_WILLNEED))) {
+    errno = r;
+    return -1;
   }
 
   return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+
+int uv_fs_readahead(uv_loop_t* loop, uv_fs_t* req, uv_file file, off_t offset,
+    size_t length, uv_fs_cb cb) {
+  char* path = NULL;
+  WRAP_EIO(UV_FS_READAHEAD, eio_readahead, _readahead,
+      ARGS3(file, offset, length))
 }
 
 
@@ -298,16 +1176,33 @@ int uv_fs_rmdir(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
 int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
     uv_fs_cb cb) {
   int r;
+  DIR* dir;
   struct dirent* entry;
   size_t size = 0;
+  size_t alloc = 0;
   size_t d_namlen = 0;
+  eio_dirent* dents = NULL;
+  eio_dirent* dent;
+  void* tmp;
+  int dents_size = 0;
+  int eio_flags = 0;
+  void* names;
+
+  if (flags & UV_FS_READDIR_STAT_ORDER) {
+    flags |= UV_FS_READDIR_TYPES;
+    eio_flags |= EIO_READDIR_STAT_ORDER;
+  }
+
+  if (flags & UV_FS_READDIR_TYPES) {
+    eio_flags |= EIO_READDIR_DENTS;
+  }
 
   uv_fs_req_init(loop, req, UV_FS_READDIR, path, cb);
 
   if (cb) {
     /* async */
     uv_ref(loop);
-    req->eio = eio_readdir(path, flags, EIO_PRI_DEFAULT, uv__fs_after, req);
+    req->eio = eio_readdir(path, eio_flags, EIO_PRI_DEFAULT, uv__fs_after, req);
     if (!req->eio) {
       uv__set_sys_error(loop, ENOMEM);
       return -1;
@@ -315,7 +1210,7 @@ int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
 
   } else {
     /* sync */
-    DIR* dir = opendir(path);
+    dir = opendir(path);
     if (!dir) {
       uv__set_sys_error(loop, errno);
       req->result = -1;
@@ -326,17 +1221,40 @@ int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
     req->result = 0;
 
     while ((entry = readdir(dir))) {
+      if (uv__fs_is_dot(entry->d_name)) {
+        continue;
+      }
+
       d_namlen = strlen(entry->d_name);
 
-      /* Skip . and .. */
-      if ((d_namlen == 1 && entry->d_name[0] == '.') ||
-          (d_namlen == 2 && entry->d_name[0] == '.' &&
-           entry->d_name[1] == '.')) {
-        continue;
+      if (flags & UV_FS_READDIR_TYPES) {
+        if (req->result == dents_size) {
+          dents_size = dents_size ? dents_size * 2 : 64;
+          tmp = realloc(dents, dents_size * sizeof(*dents));
+          if (tmp == NULL) {
+            goto nomem;
+          }
+          dents = tmp;
+        }
+
+        dent = &dents[req->result];
+        dent->nameofs = size;
+        dent->namelen = d_namlen;
+        dent->inode = entry->d_ino;
+        dent->type = uv__fs_eio_type(entry);
       }
 
-      req->ptr = realloc(req->ptr, size + d_namlen + 1);
-      /* TODO check ENOMEM */
+      if (size + d_namlen + 1 > alloc) {
+        alloc = alloc ? alloc : 4096;
+        while (size + d_namlen + 1 > alloc) {
+          alloc *= 2;
+        }
+        tmp = realloc(req->ptr, alloc);
+        if (tmp == NULL) {
+          goto nomem;
+        }
+        req->ptr = tmp;
+      }
       memcpy((char*)req->ptr + size, entry->d_name, d_namlen);
       size += d_namlen;
       ((char*)req->ptr)[size] = '\0';
@@ -347,14 +1265,94 @@ int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
     r = closedir(dir);
     if (r) {
       uv__set_sys_error(loop, errno);
+      free(dents);
+      free(req->ptr);
+      req->ptr = NULL;
       req->result = -1;
       return -1;
     }
 
+    if ((flags & UV_FS_READDIR_TYPES) && req->result > 0) {
+      if (flags & UV_FS_READDIR_STAT_ORDER) {
+        qsort(dents, req->result, sizeof(*dents), uv__fs_dirent_cmp);
+      }
+
+      names = req->ptr;
+      req->ptr = uv__fs_dirents(dents, names, req->result);
+      free(names);
+      free(dents);
+
+      if (req->ptr == NULL) {
+        uv__set_sys_error(loop, ENOMEM);
+        req->result = -1;
+        return -1;
+      }
+    }
+
     return req->result;
   }
 
   return 0;
+
+nomem:
+  closedir(dir);
+  free(dents);
+  free(req->ptr);
+  req->ptr = NULL;
+  req->result = -1;
+  uv__set_sys_error(loop, ENOMEM);
+  return -1;
+}
+
+
+int uv_fs_opendir(uv_loop_t* loop, uv_fs_t* req, const char* path,
+    uv_fs_cb cb) {
+  uv_dir_t* dir;
+
+  uv_fs_req_init(loop, req, UV_FS_OPENDIR, path, cb);
+
+  if ((dir = malloc(sizeof(*dir))) == NULL) {
+    uv__set_sys_error(loop, ENOMEM);
+    return -1;
+  }
+
+  dir->dirents = NULL;
+  dir->nentries = 0;
+  dir->dir = NULL;
+  dir->names = NULL;
+  dir->names_size = 0;
+  req->ptr = dir;
+
+  if (uv__fs_submit(loop, req, cb) == -1) {
+    /* A failed opendir(3) already freed it, eio_custom() did not. */
+    free(req->ptr);
+    req->ptr = NULL;
+    return -1;
+  }
+
+  return 0;
+}
+
+
+int uv_fs_readdir_chunk(uv_loop_t* loop, uv_fs_t* req, uv_dir_t* dir,
+    uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_READDIR_CHUNK, NULL, cb);
+
+  if (dir->dirents == NULL || dir->nentries == 0) {
+    uv__set_sys_error(loop, EINVAL);
+    return -1;
+  }
+
+  req->ptr = dir;
+  return uv__fs_submit(loop, req, cb);
+}
+
+
+int uv_fs_closedir(uv_loop_t* loop, uv_fs_t* req, uv_dir_t* dir,
+    uv_fs_cb cb) {
+  uv_fs_req_init(loop, req, UV_FS_CLOSEDIR, NULL, cb);
+  req->ptr = dir;
+  return uv__fs_submit(loop, req, cb);
 }
 
 
@@ -661,43 +1659,354 @@ int uv_fs_fchown(uv_loop_t* loop, uv_fs_t* req, uv_file file, int uid, int gid,
 }
 
 
-static void uv__work(eio_req* eio) {
-  uv_work_t* req = eio->data;
-  if (req->work_cb) {
-    req->work_cb(req);
+/*
+ * uv_fs_walk() keeps up to walk->concurrency directories open. Each one is
+ * read a batch at a time by a job on libeio's pool that also does the
+ * lstat() calls, the batch is then handed to entries_cb on the loop and
+ * the job resubmitted until the directory is exhausted. Subdirectories
+ * wait in walk->pending, a stack of NUL terminated paths, newest on top so
+ * that the walk goes depth first. A waiting directory costs only its path,
+ * it gets a uv__walk_dir when it is started.
+ */
+struct uv__walk_dir {
+  uv_fs_walk_t* walk;
+  char* path;
+  uv_dir_t dir;
+  uv_statbuf_t* stats;
+  int eof;
+};
+
+
+static int uv__walk_after(eio_req* eio);
+static void uv__walk_next(uv_fs_walk_t* walk);
+
+
+/* Pushes dir/name on the pending stack. */
+static int uv__walk_push(uv_fs_walk_t* walk, const char* dir,
+    const char* name) {
+  size_t dirlen;
+  size_t namelen;
+  size_t size;
+  char* path;
+
+  dirlen = strlen(dir);
+  namelen = strlen(name);
+
+  if (walk->pending_len + dirlen + namelen + 2 > walk->pending_size) {
+    size = walk->pending_size ? walk->pending_size : 4096;
+    while (walk->pending_len + dirlen + namelen + 2 > size) {
+      size *= 2;
+    }
+    if ((path = realloc(walk->pending, size)) == NULL) {
+      return -1;
+    }
+    walk->pending = path;
+    walk->pending_size = size;
+  }
+
+  path = walk->pending + walk->pending_len;
+  memcpy(path, dir, dirlen);
+  if (dirlen == 0 || dir[dirlen - 1] != '/') {
+    path[dirlen++] = '/';
   }
+  memcpy(path + dirlen, name, namelen + 1);
+  walk->pending_len += dirlen + namelen + 1;
+
+  return 0;
 }
 
 
-static int uv__after_work(eio_req *eio) {
-  uv_work_t* req = eio->data;
-  uv_unref(req->loop);
-  if (req->after_work_cb) {
-    req->after_work_cb(req);
+/* Pops the newest pending path, returns a copy the caller owns. */
+static char* uv__walk_pop(uv_fs_walk_t* walk) {
+  size_t start;
+  char* path;
+
+  assert(walk->pending_len > 0);
+
+  start = walk->pending_len - 1;
+  while (start > 0 && walk->pending[start - 1] != '\0') {
+    start--;
+  }
+
+  path = strdup(walk->pending + start);
+  walk->pending_len = start;
+
+  return path;
+}
+
+
+static uv_dirent_type_t uv__walk_mode_type(mode_t mode) {
+  if (S_ISREG(mode))  return UV_DIRENT_FILE;
+  if (S_ISDIR(mode))  return UV_DIRENT_DIR;
+  if (S_ISLNK(mode))  return UV_DIRENT_LINK;
+  if (S_ISFIFO(mode)) return UV_DIRENT_FIFO;
+  if (S_ISSOCK(mode)) return UV_DIRENT_SOCKET;
+  if (S_ISCHR(mode))  return UV_DIRENT_CHAR;
+  if (S_ISBLK(mode))  return UV_DIRENT_BLOCK;
+  return UV_DIRENT_UNKNOWN;
+}
+
+
+static struct uv__walk_dir* uv__walk_dir_new(uv_fs_walk_t* walk,
+    char* path) {
+  struct uv__walk_dir* wd;
+
+  if ((wd = malloc(sizeof(*wd))) == NULL) {
+    return NULL;
+  }
+
+  wd->walk = walk;
+  wd->path = path;
+  wd->dir.dirents = NULL;
+  wd->dir.nentries = 0;
+  wd->dir.dir = NULL;
+  wd->dir.names = NULL;
+  wd->dir.names_size = 0;
+  wd->stats = NULL;
+  wd->eof = 0;
+
+  return wd;
+}
+
+
+static void uv__walk_dir_free(struct uv__walk_dir* wd) {
+  if (wd->dir.dir) {
+    uv__dir_close(&wd->dir);
+  }
+  free(wd->dir.dirents);
+  free(wd->stats);
+  if (wd->path != wd->walk->path) {
+    free(wd->path);
+  }
+  free(wd);
+}
+
+
+/* Runs on the thread pool. */
+static void uv__walk_work(eio_req* eio) {
+  struct uv__walk_dir* wd = eio->data;
+  char path[PATH_MAX];
+  uv_statbuf_t st;
+  uv_dirent_t* ent;
+  size_t dirlen;
+  size_t namelen;
+  ssize_t n;
+  ssize_t i;
+
+  if (wd->dir.dir == NULL) {
+    if ((wd->dir.dir = opendir(wd->path)) == NULL) {
+      eio->result = -1;
+      return;
+    }
+  }
+
+  n = uv__dir_read(&wd->dir);
+  if (n < (ssize_t) wd->dir.nentries) {
+    wd->eof = 1;
+  }
+
+  dirlen = strlen(wd->path);
+
+  for (i = 0; i < n; i++) {
+    ent = &wd->dir.dirents[i];
+
+    if (wd->stats == NULL && ent->type != UV_DIRENT_UNKNOWN) {
+      continue;
+    }
+
+    namelen = strlen(ent->name);
+    if (dirlen + namelen + 2 > sizeof(path)) {
+      /* Too long to lstat(), reported like one that failed. */
+      if (wd->stats) {
+        memset(&wd->stats[i], 0, sizeof(st));
+      }
+      continue;
+    }
+
+    memcpy(path, wd->path, dirlen);
+    path[dirlen] = '/';
+    memcpy(path + dirlen + 1, ent->name, namelen + 1);
+
+    if (lstat(path, &st)) {
+      if (wd->stats) {
+        memset(&wd->stats[i], 0, sizeof(st));
+      }
+      continue;
+    }
+
+    if (ent->type == UV_DIRENT_UNKNOWN) {
+      ent->type = uv__walk_mode_type(st.st_mode);
+    }
+    if (wd->stats) {
+      wd->stats[i] = st;
+    }
+  }
+
+  eio->result = n;
+}
+
+
+/* Allocates the batch buffers, pending directories don't hold any. */
+static int uv__walk_start(struct uv__walk_dir* wd) {
+  uv_fs_walk_t* walk = wd->walk;
+
+  wd->dir.nentries = walk->batch;
+  wd->dir.dirents = malloc(walk->batch * sizeof(*wd->dir.dirents));
+  if (wd->dir.dirents == NULL) {
+    return -1;
+  }
+
+  if (walk->flags & UV_FS_WALK_STAT) {
+    if ((wd->stats = malloc(walk->batch * sizeof(*wd->stats))) == NULL) {
+      return -1;
+    }
+  }
+
+  if (!eio_custom(uv__walk_work, EIO_PRI_DEFAULT, uv__walk_after, wd)) {
+    return -1;
+  }
+
+  walk->active++;
+  return 0;
+}
+
+
+static int uv__walk_after(eio_req* eio) {
+  struct uv__walk_dir* wd = eio->data;
+  uv_fs_walk_t* walk = wd->walk;
+  uv_dirent_t* ent;
+  ssize_t n;
+  ssize_t i;
+
+  n = eio->result;
+
+  if (n < 0) {
+    walk->nerrors++;
+    if (wd->path == walk->path) {
+      walk->error = uv__new_sys_error(eio->errorno);
+    }
+  } else if (n > 0) {
+    walk->nentries += n;
+    walk->entries_cb(walk, wd->path, wd->dir.dirents, wd->stats, n);
+
+    for (i = 0; i < n; i++) {
+      ent = &wd->dir.dirents[i];
+      if (ent->type != UV_DIRENT_DIR) {
+        continue;
+      }
+
+      if (uv__walk_push(walk, wd->path, ent->name)) {
+        walk->nerrors++;
+      }
+    }
+  }
+
+  if (n > 0 && !wd->eof) {
+    /* More to read, keep the directory open and go again. */
+    if (eio_custom(uv__walk_work, EIO_PRI_DEFAULT, uv__walk_after, wd)) {
+      return 0;
+    }
+    walk->nerrors++;
+  } else if (n >= 0) {
+    walk->ndirs++;
   }
+
+  walk->active--;
+  uv__walk_dir_free(wd);
+  uv__walk_next(walk);
+
   return 0;
 }
 
 
-int uv_queue_work(uv_loop_t* loop, uv_work_t* req, uv_work_cb work_cb,
-    uv_after_work_cb after_work_cb) {
-  void* data = req->data;
+static void uv__walk_next(uv_fs_walk_t* walk) {
+  struct uv__walk_dir* wd;
+  char* path;
+
+  while (walk->active < walk->concurrency && walk->pending_len > 0) {
+    path = uv__walk_pop(walk);
+    wd = path ? uv__walk_dir_new(walk, path) : NULL;
+    if (wd == NULL) {
+      free(path);
+      walk->nerrors++;
+      continue;
+    }
+
+    if (uv__walk_start(wd)) {
+      walk->nerrors++;
+      uv__walk_dir_free(wd);
+    }
+  }
+
+  if (walk->active > 0) {
+    return;
+  }
+
+  uv_unref(walk->loop);
+  free(walk->path);
+  walk->path = NULL;
+  free(walk->pending);
+  walk->pending = NULL;
+  walk->pending_size = 0;
+
+  if (walk->error.code != UV_OK) {
+    walk->loop->last_err = walk->error;
+    walk->cb(walk, -1);
+  } else {
+    walk->cb(walk, 0);
+  }
+}
+
+
+int uv_fs_walk(uv_loop_t* loop, uv_fs_walk_t* req, const char* path,
+    const uv_fs_walk_options_t* options, uv_fs_walk_entries_cb entries_cb,
+    uv_fs_walk_cb cb) {
+  struct uv__walk_dir* wd;
 
+  /* Make sure the thread pool is initialized. */
   uv_eio_init(loop);
 
   uv__req_init((uv_req_t*) req);
-  uv_ref(loop);
+  req->type = UV_FS_WALK;
   req->loop = loop;
-  req->data = data;
-  req->work_cb = work_cb;
-  req->after_work_cb = after_work_cb;
+  req->entries_cb = entries_cb;
+  req->cb = cb;
+  req->ndirs = 0;
+  req->nentries = 0;
+  req->nerrors = 0;
+  req->flags = options ? options->flags : 0;
+  req->concurrency = UV_FS_WALK_CONCURRENCY;
+  req->batch = UV_FS_WALK_BATCH;
+  req->active = 0;
+  req->error.code = UV_OK;
+  req->error.sys_errno_ = 0;
+  req->pending = NULL;
+  req->pending_len = 0;
+  req->pending_size = 0;
+
+  if (options && options->concurrency) {
+    req->concurrency = options->concurrency;
+  }
+  if (options && options->batch) {
+    req->batch = options->batch;
+  }
 
-  req->eio = eio_custom(uv__work, EIO_PRI_DEFAULT, uv__after_work, req);
+  if ((req->path = strdup(path)) == NULL) {
+    uv__set_sys_error(loop, ENOMEM);
+    return -1;
+  }
 
-  if (!req->eio) {
+  if ((wd = uv__walk_dir_new(req, req->path)) == NULL ||
+      uv__walk_start(wd)) {
+    if (wd) {
+      uv__walk_dir_free(wd);
+    }
+    free(req->path);
+    req->path = NULL;
     uv__set_sys_error(loop, ENOMEM);
     return -1;
   }
 
+  uv_ref(loop);
   return 0;
 }
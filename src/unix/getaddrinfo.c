@@ -0,0 +1,783 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * uv_getaddrinfo() and its answer cache.
+ *
+ * Lookups run getaddrinfo(3) on the thread pool's DNS lane. The answer is
+ * copied into a single allocation before it is handed out, so the cache
+ * and coalesced lookups can give every caller its own copy and
+ * uv_freeaddrinfo() is one free().
+ *
+ * A lookup for the same node, service and hints as one that is already in
+ * flight doesn't go to the pool, it waits for the first one's answer.
+ *
+ * The cache is a small hash table on the loop with an LRU list for
+ * eviction. Like the in-flight table it is only ever touched from the
+ * loop's thread.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UV__GAI_BUCKETS 256
+#define UV__GAI_MAX_ENTRIES 1024
+
+/* Room for a struct addrinfo's sockaddr, rounded up to keep the next one
+ * aligned.
+ */
+#define UV__GAI_ALIGN(n) (((n) + sizeof(void*) - 1) & ~(sizeof(void*) - 1))
+
+
+struct uv__gai_entry {
+  ngx_queue_t bucket;
+  ngx_queue_t lru;
+  unsigned int hash;
+  char* hostname;
+  char* service;
+  int has_hints;
+  int flags;
+  int family;
+  int socktype;
+  int protocol;
+  struct addrinfo* res;
+  int retcode;
+  int64_t expires;
+  int refreshing;
+  int dead;
+  ngx_queue_t refresh; /* In gai->refreshing while refreshing. */
+  uv_getaddrinfo_t refresh_req;
+};
+
+
+struct uv__gai {
+  /* Cache settings, ttl == 0 means the cache is off. */
+  unsigned int ttl;
+  unsigned int negative_ttl;
+  unsigned int stale;
+  unsigned int nentries;
+  ngx_queue_t lru;
+  ngx_queue_t buckets[UV__GAI_BUCKETS];
+  /* Handles whose lookup is on the pool, by hash. */
+  ngx_queue_t inflight[UV__GAI_BUCKETS];
+  /* Entries with a background refresh out, dead ones included. */
+  ngx_queue_t refreshing;
+};
+
+
+static void uv__getaddrinfo_work(struct uv__work* w);
+static void uv__getaddrinfo_done(struct uv__work* w, int status);
+static int uv__getaddrinfo_resolve(uv_loop_t* loop,
+                                   uv_getaddrinfo_t* handle,
+                                   unsigned int hash,
+                                   const char* hostname,
+                                   const char* service,
+                                   const struct addrinfo* hints);
+
+
+/* Copies an addrinfo list into one block that free() releases. */
+static struct addrinfo* uv__copyaddrinfo(const struct addrinfo* ai) {
+  const struct addrinfo* p;
+  struct addrinfo* copy;
+  char* data;
+  size_t size;
+  size_t n;
+  size_t i;
+
+  if (ai == NULL) {
+    return NULL;
+  }
+
+  n = 0;
+  size = 0;
+  for (p = ai; p != NULL; p = p->ai_next) {
+    n++;
+    size += UV__GAI_ALIGN(p->ai_addrlen);
+    if (p->ai_canonname) {
+      size += strlen(p->ai_canonname) + 1;
+    }
+  }
+
+  if ((copy = malloc(n * sizeof(*copy) + size)) == NULL) {
+    return NULL;
+  }
+
+  data = (char*) (copy + n);
+
+  for (p = ai, i = 0; p != NULL; p = p->ai_next, i++) {
+    copy[i] = *p;
+    copy[i].ai_next = i + 1 < n ? &copy[i + 1] : NULL;
+
+    if (p->ai_addr) {
+      copy[i].ai_addr = (struct sockaddr*) data;
+      memcpy(data, p->ai_addr, p->ai_addrlen);
+      data += UV__GAI_ALIGN(p->ai_addrlen);
+    }
+  }
+
+  for (p = ai, i = 0; p != NULL; p = p->ai_next, i++) {
+    if (p->ai_canonname) {
+      copy[i].ai_canonname = data;
+      strcpy(data, p->ai_canonname);
+      data += strlen(data) + 1;
+    }
+  }
+
+  return copy;
+}
+
+
+static unsigned int uv__gai_hash(const char* hostname,
+                                 const char* service,
+                                 const struct addrinfo* hints) {
+  unsigned int h = 5381;
+  const char* s;
+
+  if (hostname) {
+    for (s = hostname; *s; s++) h = h * 33 + (unsigned char) *s;
+  }
+
+  h = h * 33 + ':';
+
+  if (service) {
+    for (s = service; *s; s++) h = h * 33 + (unsigned char) *s;
+  }
+
+  if (hints) {
+    h = h * 33 + hints->ai_flags;
+    h = h * 33 + hints->ai_family;
+    h = h * 33 + hints->ai_socktype;
+    h = h * 33 + hints->ai_protocol;
+  }
+
+  return h;
+}
+
+
+static int uv__gai_strequal(const char* a, const char* b) {
+  if (a == NULL || b == NULL) {
+    return a == b;
+  }
+  return strcmp(a, b) == 0;
+}
+
+
+static int uv__gai_hintsequal(const struct addrinfo* a,
+                              const struct addrinfo* b) {
+  if (a == NULL || b == NULL) {
+    return a == b;
+  }
+  return a->ai_flags == b->ai_flags &&
+         a->ai_family == b->ai_family &&
+         a->ai_socktype == b->ai_socktype &&
+         a->ai_protocol == b->ai_protocol;
+}
+
+
+static struct uv__gai* uv__gai_get(uv_loop_t* loop) {
+  struct uv__gai* gai;
+  int i;
+
+  if (loop->gai) {
+    return loop->gai;
+  }
+
+  if ((gai = malloc(sizeof(*gai))) == NULL) {
+    return NULL;
+  }
+
+  gai->ttl = 0;
+  gai->negative_ttl = 0;
+  gai->stale = 0;
+  gai->nentries = 0;
+  ngx_queue_init(&gai->lru);
+  ngx_queue_init(&gai->refreshing);
+  for (i = 0; i < UV__GAI_BUCKETS; i++) {
+    ngx_queue_init(&gai->buckets[i]);
+    ngx_queue_init(&gai->inflight[i]);
+  }
+
+  loop->gai = gai;
+
+  return gai;
+}
+
+
+static struct uv__gai_entry* uv__gai_cache_find(struct uv__gai* gai,
+                                                unsigned int hash,
+                                                const char* hostname,
+                                                const char* service,
+                                                const struct addrinfo* hints) {
+  struct uv__gai_entry* e;
+  ngx_queue_t* bucket;
+  ngx_queue_t* q;
+
+  bucket = &gai->buckets[hash % UV__GAI_BUCKETS];
+
+  for (q = ngx_queue_head(bucket);
+       q != ngx_queue_sentinel(bucket);
+       q = ngx_queue_next(q)) {
+    e = ngx_queue_data(q, struct uv__gai_entry, bucket);
+
+    if (e->hash != hash ||
+        e->has_hints != (hints != NULL) ||
+        !uv__gai_strequal(e->hostname, hostname) ||
+        !uv__gai_strequal(e->service, service)) {
+      continue;
+    }
+
+    if (hints && (e->flags != hints->ai_flags ||
+                  e->family != hints->ai_family ||
+                  e->socktype != hints->ai_socktype ||
+                  e->protocol != hints->ai_protocol)) {
+      continue;
+    }
+
+    return e;
+  }
+
+  return NULL;
+}
+
+
+static void uv__gai_entry_free(struct uv__gai_entry* e) {
+  free(e->hostname);
+  free(e->service);
+  free(e->res);
+  free(e);
+}
+
+
+static void uv__gai_cache_remove(struct uv__gai* gai,
+                                 struct uv__gai_entry* e) {
+  ngx_queue_remove(&e->bucket);
+  ngx_queue_remove(&e->lru);
+  gai->nentries--;
+
+  /* A background refresh still owns the entry, it frees it when done. */
+  if (e->refreshing) {
+    e->dead = 1;
+  } else {
+    uv__gai_entry_free(e);
+  }
+}
+
+
+static void uv__gai_cache_flush(struct uv__gai* gai) {
+  while (!ngx_queue_empty(&gai->lru)) {
+    uv__gai_cache_remove(gai, ngx_queue_data(ngx_queue_head(&gai->lru),
+        struct uv__gai_entry, lru));
+  }
+}
+
+
+static void uv__gai_cache_store(uv_loop_t* loop, uv_getaddrinfo_t* handle) {
+  struct uv__gai* gai = loop->gai;
+  struct uv__gai_entry* e;
+  struct addrinfo* res;
+  unsigned int ttl;
+
+  if (handle->retcode == 0) {
+    ttl = gai->ttl;
+  } else if (handle->retcode == EAI_NONAME ||
+             handle->retcode == EAI_NODATA) {
+    ttl = gai->negative_ttl;
+  } else {
+    return; /* Transient, try again next time. */
+  }
+
+  if (ttl == 0) {
+    return;
+  }
+
+  res = NULL;
+  if (handle->res && (res = uv__copyaddrinfo(handle->res)) == NULL) {
+    return;
+  }
+
+  e = uv__gai_cache_find(gai, handle->hash, handle->hostname, handle->service,
+      handle->hints);
+
+  if (e == NULL) {
+    if (gai->nentries >= UV__GAI_MAX_ENTRIES) {
+      uv__gai_cache_remove(gai, ngx_queue_data(ngx_queue_last(&gai->lru),
+          struct uv__gai_entry, lru));
+    }
+
+    if ((e = calloc(1, sizeof(*e))) == NULL) {
+      free(res);
+      return;
+    }
+
+    e->hash = handle->hash;
+    e->hostname = handle->hostname ? strdup(handle->hostname) : NULL;
+    e->service = handle->service ? strdup(handle->service) : NULL;
+    if (handle->hints) {
+      e->has_hints = 1;
+      e->flags = handle->hints->ai_flags;
+      e->family = handle->hints->ai_family;
+      e->socktype = handle->hints->ai_socktype;
+      e->protocol = handle->hints->ai_protocol;
+    }
+
+    ngx_queue_insert_head(&gai->buckets[e->hash % UV__GAI_BUCKETS],
+        &e->bucket);
+    ngx_queue_insert_head(&gai->lru, &e->lru);
+    gai->nentries++;
+  }
+
+  free(e->res);
+  e->res = res;
+  e->retcode = handle->retcode;
+  e->expires = uv_now(loop) + ttl;
+}
+
+
+static void uv__gai_refresh_cb(uv_getaddrinfo_t* handle,
+                               int status,
+                               struct addrinfo* res) {
+  struct uv__gai_entry* e;
+
+  /* uv__getaddrinfo_done() already stored the new answer. */
+  e = container_of(handle, struct uv__gai_entry, refresh_req);
+  e->refreshing = 0;
+  ngx_queue_remove(&e->refresh);
+
+  if (e->dead) {
+    uv__gai_entry_free(e);
+  }
+
+  uv_freeaddrinfo(res);
+}
+
+
+/* Frees a refresh whose loop is gone, and the entry it belongs to. Called
+ * on a worker for a refresh that uv__work_detach() cut loose.
+ */
+static void uv__gai_refresh_free(struct uv__work* w) {
+  uv_getaddrinfo_t* handle = container_of(w, uv_getaddrinfo_t, work_req);
+
+  free(handle->hints);
+  free(handle->service);
+  free(handle->hostname);
+  free(handle->res);
+  uv__gai_entry_free(container_of(handle, struct uv__gai_entry,
+      refresh_req));
+}
+
+
+static void uv__gai_refresh(uv_loop_t* loop, struct uv__gai_entry* e) {
+  struct addrinfo hints;
+  uv_getaddrinfo_t* handle = &e->refresh_req;
+
+  if (e->refreshing) {
+    return;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_flags = e->flags;
+  hints.ai_family = e->family;
+  hints.ai_socktype = e->socktype;
+  hints.ai_protocol = e->protocol;
+
+  uv__req_init((uv_req_t*)handle);
+  uv__work_req_init(&handle->work_req);
+  handle->type = UV_GETADDRINFO;
+  handle->loop = loop;
+  handle->cb = uv__gai_refresh_cb;
+  handle->work_req.orphan = uv__gai_refresh_free;
+
+  if (uv__getaddrinfo_resolve(loop, handle, e->hash, e->hostname, e->service,
+      e->has_hints ? &hints : NULL) == 0) {
+    e->refreshing = 1;
+    ngx_queue_insert_tail(&loop->gai->refreshing, &e->refresh);
+  }
+}
+
+
+/* Returns 1 and fills in handle when the cache can answer the lookup. */
+static int uv__gai_cache_lookup(uv_loop_t* loop,
+                                uv_getaddrinfo_t* handle,
+                                unsigned int hash,
+                                const char* hostname,
+                                const char* service,
+                                const struct addrinfo* hints) {
+  struct uv__gai* gai = loop->gai;
+  struct uv__gai_entry* e;
+  int64_t now;
+
+  e = uv__gai_cache_find(gai, hash, hostname, service, hints);
+
+  now = uv_now(loop);
+
+  if (e == NULL || now >= e->expires + gai->stale) {
+    loop->counters.getaddrinfo_cache_miss++;
+    return 0;
+  }
+
+  handle->res = NULL;
+  if (e->res && (handle->res = uv__copyaddrinfo(e->res)) == NULL) {
+    return 0;
+  }
+
+  handle->retcode = e->retcode;
+  loop->counters.getaddrinfo_cache_hit++;
+
+  ngx_queue_remove(&e->lru);
+  ngx_queue_insert_head(&gai->lru, &e->lru);
+
+  if (now >= e->expires) {
+    uv__gai_refresh(loop, e);
+  }
+
+  return 1;
+}
+
+
+int uv_getaddrinfo_cache(uv_loop_t* loop,
+                         unsigned int ttl,
+                         unsigned int negative_ttl,
+                         unsigned int stale) {
+  struct uv__gai* gai;
+
+  if ((gai = uv__gai_get(loop)) == NULL) {
+    uv__set_artificial_error(loop, UV_ENOMEM);
+    return -1;
+  }
+
+  if (ttl == 0) {
+    uv__gai_cache_flush(gai);
+  }
+
+  gai->ttl = ttl;
+  gai->negative_ttl = negative_ttl;
+  gai->stale = stale;
+
+  return 0;
+}
+
+
+/*
+ * A refresh that is still out when the loop goes is dropped together with
+ * the key and the answer it owns. One that a worker is running is cut loose
+ * and frees itself when it finishes, its done callback never runs. So are
+ * the callbacks of anything else that hasn't completed by then.
+ */
+void uv__getaddrinfo_cleanup(uv_loop_t* loop) {
+  struct uv__gai* gai = loop->gai;
+  struct uv__gai_entry* e;
+  ngx_queue_t* q;
+
+  if (gai == NULL) {
+    return;
+  }
+
+  /* Marks the entries that are refreshing dead instead of freeing them. */
+  uv__gai_cache_flush(gai);
+
+  while (!ngx_queue_empty(&gai->refreshing)) {
+    q = ngx_queue_head(&gai->refreshing);
+    ngx_queue_remove(q);
+    e = ngx_queue_data(q, struct uv__gai_entry, refresh);
+
+    if (uv__work_cancel(&e->refresh_req.work_req) != UV_OK &&
+        uv__work_detach(&e->refresh_req.work_req) == UV_OK) {
+      continue;
+    }
+
+    /* Cancelled or already finished, either way done won't run. */
+    uv__gai_refresh_free(&e->refresh_req.work_req);
+  }
+
+  free(gai);
+  loop->gai = NULL;
+}
+
+
+static uv_getaddrinfo_t* uv__gai_inflight_find(struct uv__gai* gai,
+                                               unsigned int hash,
+                                               const char* hostname,
+                                               const char* service,
+                                               const struct addrinfo* hints) {
+  uv_getaddrinfo_t* handle;
+  ngx_queue_t* bucket;
+  ngx_queue_t* q;
+
+  bucket = &gai->inflight[hash % UV__GAI_BUCKETS];
+
+  for (q = ngx_queue_head(bucket);
+       q != ngx_queue_sentinel(bucket);
+       q = ngx_queue_next(q)) {
+    handle = ngx_queue_data(q, uv_getaddrinfo_t, inflight);
+
+    if (handle->hash == hash &&
+        uv__gai_strequal(handle->hostname, hostname) &&
+        uv__gai_strequal(handle->service, service) &&
+        uv__gai_hintsequal(handle->hints, hints)) {
+      return handle;
+    }
+  }
+
+  return NULL;
+}
+
+
+/* The lookup of a handle that others were waiting on was cancelled. The
+ * first waiter takes over the lookup, and the key it is made with.
+ */
+static void uv__gai_promote(uv_getaddrinfo_t* handle) {
+  uv_getaddrinfo_t* next;
+  ngx_queue_t* q;
+
+  q = ngx_queue_head(&handle->waiters);
+  ngx_queue_remove(q);
+  next = container_of(ngx_queue_data(q, struct uv__work, wq),
+      uv_getaddrinfo_t, work_req);
+
+  next->cached = 0;
+  next->hash = handle->hash;
+  next->hints = handle->hints;
+  next->hostname = handle->hostname;
+  next->service = handle->service;
+  handle->hints = NULL;
+  handle->hostname = NULL;
+  handle->service = NULL;
+
+  ngx_queue_init(&next->waiters);
+  while (!ngx_queue_empty(&handle->waiters)) {
+    q = ngx_queue_head(&handle->waiters);
+    ngx_queue_remove(q);
+    ngx_queue_insert_tail(&next->waiters, q);
+  }
+
+  ngx_queue_remove(&handle->inflight);
+  ngx_queue_insert_tail(&next->loop->gai->inflight[next->hash %
+      UV__GAI_BUCKETS], &next->inflight);
+
+  /* Its reference on the loop was taken when it started waiting. */
+  uv__work_submit(next->loop, UV_LANE_DNS, &next->work_req,
+      uv__getaddrinfo_work, uv__getaddrinfo_done);
+}
+
+
+static void uv__getaddrinfo_done(struct uv__work* w, int status) {
+  uv_getaddrinfo_t* handle = container_of(w, uv_getaddrinfo_t, work_req);
+  uv_getaddrinfo_t* waiter;
+  struct addrinfo *res = handle->res;
+  ngx_queue_t waiters;
+  ngx_queue_t* q;
+
+  ngx_queue_init(&waiters);
+
+  /* Only a handle that did its own lookup has others waiting on it. */
+  if (!handle->cached) {
+    if (status && !ngx_queue_empty(&handle->waiters)) {
+      uv__gai_promote(handle);
+    } else {
+      ngx_queue_remove(&handle->inflight);
+    }
+
+    if (status == 0) {
+      if (handle->loop->gai->ttl) {
+        uv__gai_cache_store(handle->loop, handle);
+      }
+
+      /* Everyone gets their own copy, the callbacks may free the handles. */
+      while (!ngx_queue_empty(&handle->waiters)) {
+        q = ngx_queue_head(&handle->waiters);
+        ngx_queue_remove(q);
+        ngx_queue_insert_tail(&waiters, q);
+
+        waiter = container_of(ngx_queue_data(q, struct uv__work, wq),
+            uv_getaddrinfo_t, work_req);
+        /* Answered, so uv_cancel() from an earlier callback fails. */
+        waiter->work_req.in_flight = 0;
+        waiter->retcode = handle->retcode;
+        if (res && (waiter->res = uv__copyaddrinfo(res)) == NULL) {
+          waiter->retcode = EAI_MEMORY;
+        }
+      }
+    }
+  }
+
+  handle->res = NULL;
+
+  uv_unref(handle->loop);
+
+  free(handle->hints);
+  free(handle->service);
+  free(handle->hostname);
+
+  if (status) {
+    /* Cancelled before getaddrinfo() ran. */
+    uv__set_artificial_error(handle->loop, UV_ECANCELED);
+    handle->cb(handle, -1, NULL);
+    return;
+  }
+
+  if (handle->retcode == 0) {
+    /* OK */
+  } else if (handle->retcode == EAI_NONAME || handle->retcode == EAI_NODATA) {
+    uv__set_sys_error(handle->loop, ENOENT); /* FIXME compatibility hack */
+  } else {
+    handle->loop->last_err.code = UV_EADDRINFO;
+    handle->loop->last_err.sys_errno_ = handle->retcode;
+  }
+
+  handle->cb(handle, handle->retcode, res);
+
+  while (!ngx_queue_empty(&waiters)) {
+    q = ngx_queue_head(&waiters);
+    ngx_queue_remove(q);
+    ngx_queue_init(q);
+    waiter = container_of(ngx_queue_data(q, struct uv__work, wq),
+        uv_getaddrinfo_t, work_req);
+    uv__getaddrinfo_done(&waiter->work_req, 0);
+  }
+}
+
+
+static void uv__getaddrinfo_work(struct uv__work* w) {
+  uv_getaddrinfo_t* handle = container_of(w, uv_getaddrinfo_t, work_req);
+  struct addrinfo* res;
+
+  handle->retcode = getaddrinfo(handle->hostname,
+                                handle->service,
+                                handle->hints,
+                                &res);
+
+  if (handle->retcode == 0) {
+    if ((handle->res = uv__copyaddrinfo(res)) == NULL) {
+      handle->retcode = EAI_MEMORY;
+    }
+    freeaddrinfo(res);
+  }
+}
+
+
+/* Starts a lookup on the pool, or waits for an identical one. */
+static int uv__getaddrinfo_resolve(uv_loop_t* loop,
+                                   uv_getaddrinfo_t* handle,
+                                   unsigned int hash,
+                                   const char* hostname,
+                                   const char* service,
+                                   const struct addrinfo* hints) {
+  uv_getaddrinfo_t* leader;
+  struct uv__gai* gai = loop->gai;
+
+  handle->hints = NULL;
+  handle->hostname = NULL;
+  handle->service = NULL;
+  handle->res = NULL;
+  handle->retcode = 0;
+  handle->hash = hash;
+  ngx_queue_init(&handle->waiters);
+
+  if ((leader = uv__gai_inflight_find(gai, hash, hostname, service, hints))) {
+    handle->cached = 1;
+    uv_ref(loop);
+    uv__work_park(loop, UV_LANE_DNS, &handle->work_req, &leader->waiters,
+        uv__getaddrinfo_done);
+    return 0;
+  }
+
+  handle->cached = 0;
+
+  /* TODO don't alloc so much. */
+
+  if (hints) {
+    handle->hints = malloc(sizeof(struct addrinfo));
+    memcpy(handle->hints, hints, sizeof(struct addrinfo));
+  }
+
+  /* TODO security! check lengths, check return values. */
+
+  handle->hostname = hostname ? strdup(hostname) : NULL;
+  handle->service = service ? strdup(service) : NULL;
+
+  /* TODO check handle->hostname == NULL */
+  /* TODO check handle->service == NULL */
+
+  ngx_queue_insert_tail(&gai->inflight[hash % UV__GAI_BUCKETS],
+      &handle->inflight);
+
+  uv_ref(loop);
+  uv__work_submit(loop, UV_LANE_DNS, &handle->work_req, uv__getaddrinfo_work,
+      uv__getaddrinfo_done);
+
+  return 0;
+}
+
+
+int uv_getaddrinfo(uv_loop_t* loop,
+                   uv_getaddrinfo_t* handle,
+                   uv_getaddrinfo_cb cb,
+                   const char* hostname,
+                   const char* service,
+                   const struct addrinfo* hints) {
+  unsigned int hash;
+
+  if (handle == NULL || cb == NULL ||
+      (hostname == NULL && service == NULL)) {
+    uv__set_artificial_error(loop, UV_EINVAL);
+    return -1;
+  }
+
+  if (uv__gai_get(loop) == NULL) {
+    uv__set_artificial_error(loop, UV_ENOMEM);
+    return -1;
+  }
+
+  uv__req_init((uv_req_t*)handle);
+  uv__work_req_init(&handle->work_req);
+  handle->type = UV_GETADDRINFO;
+  handle->loop = loop;
+  handle->cb = cb;
+
+  hash = uv__gai_hash(hostname, service, hints);
+
+  if (loop->gai->ttl &&
+      uv__gai_cache_lookup(loop, handle, hash, hostname, service, hints)) {
+    /* Answered from the cache, the callback still runs from the loop. */
+    handle->hints = NULL;
+    handle->hostname = NULL;
+    handle->service = NULL;
+    handle->cached = 1;
+    uv_ref(loop);
+    uv__work_complete(loop, UV_LANE_DNS, &handle->work_req,
+        uv__getaddrinfo_done);
+    return 0;
+  }
+
+  return uv__getaddrinfo_resolve(loop, handle, hash, hostname, service,
+      hints);
+}
+
+
+void uv_freeaddrinfo(struct addrinfo* ai) {
+  /* Always a uv__copyaddrinfo() block. */
+  free(ai);
+}
@@ -82,7 +82,8 @@ enum {
   UV_READABLE      = 0x20,   /* The stream is readable */
   UV_WRITABLE      = 0x40,   /* The stream is writable */
   UV_TCP_NODELAY   = 0x080,  /* Disable Nagle. */
-  UV_TCP_KEEPALIVE = 0x100   /* Turn on keep-alive. */
+  UV_TCP_KEEPALIVE = 0x100,  /* Turn on keep-alive. */
+  UV_WRITE_PAUSED  = 0x200   /* Write queue is above the high watermark. */
 };
 
 size_t uv__strlcpy(char* dst, const char* src, size_t size);
@@ -125,7 +126,34 @@ int uv_pipe_cleanup(uv_pipe_t* handle);
 void uv__udp_destroy(uv_udp_t* handle);
 void uv__udp_watcher_stop(uv_udp_t* handle, ev_io* w);
 
+/* post */
+void uv__post_init(uv_loop_t* loop);
+
+/* threadpool */
+void uv__work_init(uv_loop_t* loop);
+void uv__work_req_init(struct uv__work* w);
+void uv__work_submit(uv_loop_t* loop,
+                     uv_lane_t lane,
+                     struct uv__work* w,
+                     void (*work)(struct uv__work* w),
+                     void (*done)(struct uv__work* w, int status));
+void uv__work_complete(uv_loop_t* loop,
+                       uv_lane_t lane,
+                       struct uv__work* w,
+                       void (*done)(struct uv__work* w, int status));
+void uv__work_park(uv_loop_t* loop,
+                   uv_lane_t lane,
+                   struct uv__work* w,
+                   ngx_queue_t* queue,
+                   void (*done)(struct uv__work* w, int status));
+uv_err_code uv__work_cancel(struct uv__work* w);
+uv_err_code uv__work_detach(struct uv__work* w);
+
+/* getaddrinfo */
+void uv__getaddrinfo_cleanup(uv_loop_t* loop);
+
 /* fs */
+void uv__fs_init(uv_loop_t* loop);
 void uv__fs_event_destroy(uv_fs_event_t* handle);
 
 #endif /* UV_UNIX_INTERNAL_H_ */
@@ -15,6 +15,8 @@ void uv__io_watcher_start(
 
 void uv__io_watcher_stop(uv_handle_t* handle, uv_io_t* io, ev_io* w);
 
+void uv__io_destroy(uv_handle_t* handle, uv_io_t* io);
+
 #if 0
 void uv__io_init_read(
     uv_io_t* io,
@@ -0,0 +1,104 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * uv_post() lets other threads hand work to a loop. Producers push requests
+ * onto a lock-free singly linked LIFO with compare-and-swap; the loop thread
+ * detaches the whole list with one atomic exchange, reverses it to restore
+ * submission order and runs the callbacks. Wakeups go through a single
+ * ev_async watcher, so a burst of posts costs one eventfd write and one
+ * loop iteration.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <errno.h>
+
+
+static void uv__post_io(struct ev_loop* ev, ev_async* w, int revents) {
+  uv_loop_t* loop = ev_userdata(ev);
+  uv_post_t* head;
+  uv_post_t* next;
+  uv_post_t* prev;
+  uv_post_t* req;
+
+  assert(w == &loop->post_watcher);
+
+  /* Take one batch per wakeup. Anything posted while the callbacks run
+   * lands on an empty list and schedules another wakeup.
+   */
+  head = __sync_lock_test_and_set(&loop->post_head, NULL);
+
+  /* Producers push onto the front, reverse to get FIFO order back. */
+  prev = NULL;
+  for (req = head; req != NULL; req = next) {
+    next = req->next_post;
+    req->next_post = prev;
+    prev = req;
+  }
+
+  for (req = prev; req != NULL; req = next) {
+    /* The callback may free or reuse the request. */
+    next = req->next_post;
+    req->cb(req);
+  }
+}
+
+
+void uv__post_init(uv_loop_t* loop) {
+  loop->post_head = NULL;
+  ev_async_init(&loop->post_watcher, uv__post_io);
+  ev_async_start(loop->ev, &loop->post_watcher);
+  /* Like uv_async_t, pending posts don't keep the loop alive. */
+  ev_unref(loop->ev);
+}
+
+
+int uv_post(uv_loop_t* loop, uv_post_t* req, uv_post_cb cb) {
+  uv_post_t* head;
+
+  if (cb == NULL) {
+    uv__set_artificial_error(loop, UV_EINVAL);
+    return -1;
+  }
+
+  uv__req_init((uv_req_t*)req);
+  req->type = UV_POST;
+  req->loop = loop;
+  req->cb = cb;
+
+  do {
+    head = loop->post_head;
+    req->next_post = head;
+  }
+  while (!__sync_bool_compare_and_swap(&loop->post_head, head, req));
+
+  /* Only the producer that made the list non-empty needs to wake the loop,
+   * everybody else piggybacks on that wakeup.
+   */
+  if (head == NULL) {
+    ev_async_send(loop->ev, &loop->post_watcher);
+  }
+
+  return 0;
+}
@@ -21,6 +21,7 @@
 
 #include "uv.h"
 #include "internal.h"
+#include "io.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -29,12 +30,22 @@
 #include <string.h>
 #include <sys/uio.h>
 
+#if defined(__linux__)
+# include <fcntl.h> /* splice */
+# include <sys/sendfile.h>
+#endif
+
 #include <stdio.h>
 
 
 static void uv__stream_connect(uv_stream_t*);
 static void uv__write(uv_stream_t* stream);
 static void uv__read(uv_stream_t* stream);
+static void uv__stream_pipe_run(uv_stream_pipe_t* req);
+static void uv__stream_pipe_finish(uv_stream_pipe_t* req, int error);
+
+/* Most a uv_stream_pipe() moves per read. */
+#define UV__STREAM_PIPE_CHUNK (64 * 1024)
 
 static void uv__stream_io_write_destroy_cb(uv_handle_t* handle, ngx_queue_t* q) {
   uv_write_t* req;
@@ -87,6 +98,12 @@ void uv__stream_init(uv_loop_t* loop,
   stream->accepted_fd = -1;
   stream->fd = -1;
   stream->delayed_error = 0;
+  stream->write_low_watermark = 0;
+  stream->write_high_watermark = 0;
+  stream->write_pause_cb = NULL;
+  stream->write_drain_cb = NULL;
+  stream->pipe_from = NULL;
+  stream->pipe_to = NULL;
   ngx_queue_init(&stream->io.write_queue);
   ngx_queue_init(&stream->io.write_completed_queue);
   stream->io.write_queue_size = 0;
@@ -149,13 +166,17 @@ int uv__stream_open(uv_stream_t* stream, int fd, int flags) {
 
 
 void uv__stream_destroy(uv_stream_t* stream) {
-  uv_write_t* req;
-  ngx_queue_t* q;
-
   /* Only destroy the IO if we've been closed. */
   assert(stream->flags & UV_CLOSED);
 
-  uv__io_destroy(&stream->io);
+  if (stream->pipe_from) {
+    uv__stream_pipe_finish(stream->pipe_from, EINTR);
+  }
+  if (stream->pipe_to) {
+    uv__stream_pipe_finish(stream->pipe_to, EINTR);
+  }
+
+  uv__io_destroy((uv_handle_t*)stream, &stream->io);
 }
 
 
@@ -313,6 +334,11 @@ static void uv__drain(uv_stream_t* stream) {
 static size_t uv__write_req_size(uv_write_t* req) {
   size_t size;
 
+  if (req->sendfile_fd >= 0) {
+    assert(req->handle->io.write_queue_size >= req->sendfile_len);
+    return req->sendfile_len;
+  }
+
   size = uv__buf_count(req->bufs + req->write_index,
                        req->bufcnt - req->write_index);
   assert(req->handle->io.write_queue_size >= size);
@@ -339,6 +365,88 @@ static void uv__write_req_finish(uv_write_t* req) {
 }
 
 
+/* Copies up to len bytes of in_fd at *offset to out_fd, advancing *offset. */
+static ssize_t uv__sendfile(int out_fd, int in_fd, off_t* offset, size_t len) {
+  char buf[65536];
+  ssize_t nread;
+  ssize_t n;
+
+#if defined(__linux__)
+  do {
+    n = sendfile(out_fd, in_fd, offset, len);
+  }
+  while (n == -1 && errno == EINTR);
+
+  /* EINVAL and ENOSYS mean this pair of fds can't be spliced. */
+  if (n != -1 || (errno != EINVAL && errno != ENOSYS)) {
+    return n;
+  }
+#endif
+
+  /* Fall back to a bounce buffer. Data read but not written is read again
+   * next time, *offset only counts what was written.
+   */
+  if (len > sizeof(buf)) {
+    len = sizeof(buf);
+  }
+
+  do {
+    nread = pread(in_fd, buf, len, *offset);
+  }
+  while (nread == -1 && errno == EINTR);
+
+  if (nread <= 0) {
+    return nread;
+  }
+
+  do {
+    n = write(out_fd, buf, nread);
+  }
+  while (n == -1 && errno == EINTR);
+
+  if (n > 0) {
+    *offset += n;
+  }
+
+  return n;
+}
+
+
+static void uv__write_sendfile(uv_stream_t* stream, uv_write_t* req) {
+  ssize_t n;
+
+  while (req->sendfile_len > 0) {
+    n = uv__sendfile(stream->fd, req->sendfile_fd, &req->sendfile_offset,
+        req->sendfile_len);
+
+    if (n < 0) {
+      if (errno == EAGAIN) {
+        /* Socket is full, wait for the write watcher. */
+        ev_io_start(stream->loop->ev, &stream->io.write_watcher);
+        return;
+      }
+
+      req->error = errno;
+      break;
+    }
+
+    if (n == 0) {
+      /* The file ended early, the bytes before EOF did go out. */
+      req->error = UV_EOF;
+      break;
+    }
+
+    assert((size_t) n <= req->sendfile_len);
+    req->sendfile_len -= n;
+    stream->io.write_queue_size -= n;
+  }
+
+  stream->io.write_queue_size -= req->sendfile_len;
+  req->sendfile_len = 0;
+  uv__write_req_finish(req);
+}
+
+
 /* On success returns NULL. On error returns a pointer to the write request
  * which had the error.
  */
@@ -361,6 +469,11 @@ static void uv__write(uv_stream_t* stream) {
 
   assert(req->handle == stream);
 
+  if (req->sendfile_fd >= 0) {
+    uv__write_sendfile(stream, req);
+    return;
+  }
+
   /* Cast to iovec. We had to have our own uv_buf_t instead of iovec
    * because Windows's WSABUF is not an iovec.
    */
@@ -466,6 +579,55 @@ static void uv__write(uv_stream_t* stream) {
 }
 
 
+/* Fires the pause and drain callbacks when the write queue crosses the
+ * watermarks set with uv_write_watermarks().
+ */
+static void uv__write_watermarks(uv_stream_t* stream) {
+  size_t size;
+
+  if (stream->write_high_watermark == 0 || (stream->flags & UV_CLOSING)) {
+    return;
+  }
+
+  size = stream->io.write_queue_size;
+
+  if (stream->flags & UV_WRITE_PAUSED) {
+    if (size <= stream->write_low_watermark) {
+      stream->flags &= ~UV_WRITE_PAUSED;
+      if (stream->write_drain_cb) {
+        stream->write_drain_cb(stream);
+      }
+    }
+  } else {
+    if (size >= stream->write_high_watermark) {
+      stream->flags |= UV_WRITE_PAUSED;
+      if (stream->write_pause_cb) {
+        stream->write_pause_cb(stream);
+      }
+    }
+  }
+}
+
+
+int uv_write_watermarks(uv_stream_t* stream, size_t low, size_t high,
+    uv_watermark_cb pause_cb, uv_watermark_cb drain_cb) {
+  if (low > high) {
+    uv__set_artificial_error(stream->loop, UV_EINVAL);
+    return -1;
+  }
+
+  stream->write_low_watermark = low;
+  stream->write_high_watermark = high;
+  stream->write_pause_cb = pause_cb;
+  stream->write_drain_cb = drain_cb;
+  stream->flags &= ~UV_WRITE_PAUSED;
+
+  uv__write_watermarks(stream);
+
+  return 0;
+}
+
+
 static void uv__write_callbacks(uv_stream_t* stream) {
   int callbacks_made = 0;
   ngx_queue_t* q;
@@ -489,6 +651,8 @@ static void uv__write_callbacks(uv_stream_t* stream) {
 
   assert(ngx_queue_empty(&stream->io.write_completed_queue));
 
+  uv__write_watermarks(stream);
+
   /* Write queue drained. */
   if (!uv_write_queue_head(stream)) {
     uv__drain(stream);
@@ -677,12 +841,21 @@ void uv__stream_io(EV_P_ ev_io* watcher, int revents) {
     assert(stream->fd >= 0);
 
     if (revents & EV_READ) {
-      uv__read((uv_stream_t*)stream);
+      if (stream->pipe_from) {
+        uv__stream_pipe_run(stream->pipe_from);
+      } else {
+        uv__read((uv_stream_t*)stream);
+      }
     }
 
     if (revents & EV_WRITE) {
       uv__write(stream);
       uv__write_callbacks(stream);
+
+      /* Queued writes are done, carry on forwarding. */
+      if (stream->pipe_to && ngx_queue_empty(&stream->io.write_queue)) {
+        uv__stream_pipe_run(stream->pipe_to);
+      }
     }
   }
 }
@@ -836,6 +1009,7 @@ int uv_write2(uv_write_t* req, uv_stream_t* stream, uv_buf_t bufs[], int bufcnt,
   req->error = 0;
   req->send_handle = send_handle;
   req->type = UV_WRITE;
+  req->sendfile_fd = -1;
   ngx_queue_init(&req->queue);
 
   if (bufcnt <= UV_REQ_BUFSML_SIZE) {
@@ -873,6 +1047,57 @@ int uv_write2(uv_write_t* req, uv_stream_t* stream, uv_buf_t bufs[], int bufcnt,
     ev_io_start(stream->loop->ev, &stream->io.write_watcher);
   }
 
+  uv__write_watermarks(stream);
+
+  return 0;
+}
+
+
+int uv_write_sendfile(uv_write_t* req, uv_stream_t* stream, uv_file in_fd,
+    off_t offset, size_t length, uv_write_cb cb) {
+  int empty_queue;
+
+  assert((stream->type == UV_TCP || stream->type == UV_NAMED_PIPE) &&
+      "uv_write_sendfile (unix) only supports TCP and pipe streams");
+
+  if (stream->fd < 0) {
+    uv__set_sys_error(stream->loop, EBADF);
+    return -1;
+  }
+
+  if (in_fd < 0 || offset < 0) {
+    uv__set_sys_error(stream->loop, EINVAL);
+    return -1;
+  }
+
+  empty_queue = ngx_queue_empty(&stream->io.write_queue);
+
+  uv__req_init((uv_req_t*) req);
+  req->cb = cb;
+  req->handle = stream;
+  req->error = 0;
+  req->send_handle = NULL;
+  req->type = UV_WRITE;
+  req->bufs = req->bufsml;
+  req->bufcnt = 0;
+  req->write_index = 0;
+  req->sendfile_fd = in_fd;
+  req->sendfile_offset = offset;
+  req->sendfile_len = length;
+  ngx_queue_init(&req->queue);
+
+  stream->io.write_queue_size += length;
+  ngx_queue_insert_tail(&stream->io.write_queue, &req->queue);
+
+  /* Like uv_write2(), try right away when nothing is queued before us. */
+  if (empty_queue) {
+    uv__write(stream);
+  } else {
+    ev_io_start(stream->loop->ev, &stream->io.write_watcher);
+  }
+
+  uv__write_watermarks(stream);
+
   return 0;
 }
 
@@ -886,6 +1111,253 @@ int uv_write(uv_write_t* req, uv_stream_t* stream, uv_buf_t bufs[], int bufcnt,
 }
 
 
+/* Switches a uv_stream_pipe() over to the buffer, keeping what the pipe
+ * holds. That is never more than one chunk.
+ */
+static int uv__stream_pipe_copy(uv_stream_pipe_t* req) {
+  size_t len;
+  ssize_t n;
+
+  if ((req->buf = malloc(UV__STREAM_PIPE_CHUNK)) == NULL) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  for (len = 0; len < req->pending; len += n) {
+    do {
+      n = read(req->fds[0], req->buf + len, req->pending - len);
+    }
+    while (n == -1 && errno == EINTR);
+
+    if (n <= 0) {
+      errno = n ? errno : EIO;
+      return -1;
+    }
+  }
+
+  uv__close(req->fds[0]);
+  uv__close(req->fds[1]);
+  req->fds[0] = -1;
+  req->fds[1] = -1;
+  req->offset = 0;
+
+  return 0;
+}
+
+
+/* Reads from src into the pipe or the buffer. */
+static ssize_t uv__stream_pipe_in(uv_stream_pipe_t* req) {
+  ssize_t n;
+
+#if defined(__linux__)
+  if (req->fds[1] >= 0) {
+    do {
+      n = splice(req->src->fd, NULL, req->fds[1], NULL,
+          UV__STREAM_PIPE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    }
+    while (n == -1 && errno == EINTR);
+
+    /* EINVAL means src can't be spliced, copy from now on. */
+    if (n != -1 || errno != EINVAL || uv__stream_pipe_copy(req)) {
+      return n;
+    }
+  }
+#endif
+
+  do {
+    n = read(req->src->fd, req->buf, UV__STREAM_PIPE_CHUNK);
+  }
+  while (n == -1 && errno == EINTR);
+
+  req->offset = 0;
+  return n;
+}
+
+
+/* Writes pending data from the pipe or the buffer to dst. */
+static ssize_t uv__stream_pipe_out(uv_stream_pipe_t* req) {
+  ssize_t n;
+
+#if defined(__linux__)
+  if (req->fds[0] >= 0) {
+    do {
+      n = splice(req->fds[0], NULL, req->dst->fd, NULL, req->pending,
+          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    }
+    while (n == -1 && errno == EINTR);
+
+    if (n != -1 || errno != EINVAL || uv__stream_pipe_copy(req)) {
+      return n;
+    }
+  }
+#endif
+
+  do {
+    n = write(req->dst->fd, req->buf + req->offset, req->pending);
+  }
+  while (n == -1 && errno == EINTR);
+
+  if (n > 0) {
+    req->offset += n;
+  }
+
+  return n;
+}
+
+
+static void uv__stream_pipe_finish(uv_stream_pipe_t* req, int error) {
+  uv_stream_t* src = req->src;
+
+  src->pipe_from = NULL;
+  req->dst->pipe_to = NULL;
+
+  if (!(src->flags & UV_READING)) {
+    ev_io_stop(src->loop->ev, &src->io.read_watcher);
+  }
+
+  if (req->fds[0] >= 0) {
+    uv__close(req->fds[0]);
+    uv__close(req->fds[1]);
+    req->fds[0] = -1;
+    req->fds[1] = -1;
+  }
+
+  free(req->buf);
+  req->buf = NULL;
+
+  if (req->cb) {
+    uv__set_sys_error(src->loop, error);
+    req->cb(req, error ? -1 : 0);
+  }
+}
+
+
+/*
+ * Moves data until src has none or dst takes no more, then waits for the
+ * watcher of the stream that held things up. src isn't read while data is
+ * pending, that is the backpressure.
+ */
+static void uv__stream_pipe_run(uv_stream_pipe_t* req) {
+  uv_stream_t* src = req->src;
+  uv_stream_t* dst = req->dst;
+  struct ev_loop* ev = src->loop->ev;
+  ssize_t n;
+  int rounds;
+
+  /* One of them is being closed, uv__stream_destroy() will finish us. */
+  if (src->fd < 0 || dst->fd < 0) {
+    return;
+  }
+
+  /* Bounded so that a busy pair doesn't starve the other watchers. */
+  for (rounds = 0; rounds < 16; rounds++) {
+    if (req->pending > 0) {
+      if (!ngx_queue_empty(&dst->io.write_queue)) {
+        /* uv_write()s queued before us go first. */
+        break;
+      }
+
+      n = uv__stream_pipe_out(req);
+      if (n == -1) {
+        if (errno != EAGAIN) {
+          uv__stream_pipe_finish(req, errno);
+          return;
+        }
+        break;
+      }
+
+      req->pending -= n;
+      req->nbytes += n;
+      continue;
+    }
+
+    n = uv__stream_pipe_in(req);
+    if (n == -1) {
+      if (errno != EAGAIN) {
+        uv__stream_pipe_finish(req, errno);
+        return;
+      }
+      break;
+    }
+
+    if (n == 0) {
+      uv__stream_pipe_finish(req, 0);
+      return;
+    }
+
+    req->pending = n;
+  }
+
+  if (req->pending > 0) {
+    ev_io_stop(ev, &src->io.read_watcher);
+    ev_io_start(ev, &dst->io.write_watcher);
+  } else {
+    ev_io_start(ev, &src->io.read_watcher);
+  }
+}
+
+
+int uv_stream_pipe(uv_stream_pipe_t* req, uv_stream_t* src, uv_stream_t* dst,
+    uv_stream_pipe_cb cb) {
+  assert((src->type == UV_TCP || src->type == UV_NAMED_PIPE) &&
+      (dst->type == UV_TCP || dst->type == UV_NAMED_PIPE) &&
+      "uv_stream_pipe (unix) only supports TCP and pipe streams");
+
+  if (src->fd < 0 || dst->fd < 0) {
+    uv__set_sys_error(src->loop, EBADF);
+    return -1;
+  }
+
+  if (src == dst) {
+    uv__set_sys_error(src->loop, EINVAL);
+    return -1;
+  }
+
+  if (src->pipe_from || dst->pipe_to || (src->flags & UV_READING)) {
+    uv__set_sys_error(src->loop, EBUSY);
+    return -1;
+  }
+
+  uv__req_init((uv_req_t*) req);
+  req->type = UV_STREAM_PIPE;
+  req->src = src;
+  req->dst = dst;
+  req->cb = cb;
+  req->nbytes = 0;
+  req->fds[0] = -1;
+  req->fds[1] = -1;
+  req->buf = NULL;
+  req->offset = 0;
+  req->pending = 0;
+
+#if defined(__linux__)
+  if (pipe(req->fds) == 0) {
+    uv__nonblock(req->fds[0], 1);
+    uv__nonblock(req->fds[1], 1);
+    uv__cloexec(req->fds[0], 1);
+    uv__cloexec(req->fds[1], 1);
+  } else {
+    req->fds[0] = -1;
+    req->fds[1] = -1;
+  }
+#endif
+
+  if (req->fds[0] == -1 &&
+      (req->buf = malloc(UV__STREAM_PIPE_CHUNK)) == NULL) {
+    uv__set_sys_error(src->loop, ENOMEM);
+    return -1;
+  }
+
+  src->pipe_from = req;
+  dst->pipe_to = req;
+
+  /* Start on the next loop iteration, cb is never called from here. */
+  ev_io_start(src->loop->ev, &src->io.read_watcher);
+
+  return 0;
+}
+
+
 int uv__read_start_common(uv_stream_t* stream, uv_alloc_cb alloc_cb,
     uv_read_cb read_cb, uv_read2_cb read2_cb) {
   assert(stream->type == UV_TCP || stream->type == UV_NAMED_PIPE ||
@@ -896,6 +1368,12 @@ int uv__read_start_common(uv_stream_t* stream, uv_alloc_cb alloc_cb,
     return -1;
   }
 
+  /* A uv_stream_pipe() is reading it. */
+  if (stream->pipe_from) {
+    uv__set_sys_error(stream->loop, EBUSY);
+    return -1;
+  }
+
   /* The UV_READING flag is irrelevant of the state of the tcp - it just
    * expresses the desired state of the user.
    */
@@ -21,9 +21,12 @@
 
 #include "uv.h"
 #include "internal.h"
+#include "io.h"
 
 #include <assert.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 
 int uv_tcp_init(uv_loop_t* loop, uv_tcp_t* tcp) {
@@ -321,3 +324,247 @@ int uv_tcp_keepalive(uv_tcp_t* handle, int enable, unsigned int delay) {
 
   return 0;
 }
+
+
+/*
+ * uv_tcp_connect_name(). Every address gets its own socket, held by a
+ * uv__connect_attempt, and the winning socket is moved into the user's
+ * handle.
+ */
+struct uv__connect_attempt {
+  uv_tcp_t tcp;
+  uv_connect_t req;
+  uv_connect_name_t* owner;
+  ngx_queue_t queue;
+};
+
+
+static void uv__connect_name_next(uv_connect_name_t* req);
+
+
+static void uv__connect_attempt_close_cb(uv_handle_t* handle) {
+  free(container_of(handle, struct uv__connect_attempt, tcp));
+}
+
+
+static void uv__connect_attempt_close(struct uv__connect_attempt* attempt) {
+  ngx_queue_remove(&attempt->queue);
+  uv_close((uv_handle_t*)&attempt->tcp, uv__connect_attempt_close_cb);
+}
+
+
+static void uv__connect_name_finish(uv_connect_name_t* req, int status) {
+  ngx_queue_t* q;
+
+  ev_timer_stop(req->loop->ev, &req->timer);
+
+  while (!ngx_queue_empty(&req->attempts)) {
+    q = ngx_queue_head(&req->attempts);
+    uv__connect_attempt_close(ngx_queue_data(q, struct uv__connect_attempt,
+                                             queue));
+  }
+
+  free(req->addrs);
+  req->addrs = NULL;
+  uv_freeaddrinfo(req->addrinfo);
+  req->addrinfo = NULL;
+
+  if (status)
+    req->loop->last_err = req->error;
+
+  req->cb(req, status);
+}
+
+
+static void uv__connect_name_connected(uv_connect_t* connect_req, int status) {
+  struct uv__connect_attempt* attempt;
+  uv_connect_name_t* req;
+  uv_tcp_t* handle;
+  int fd;
+
+  attempt = container_of(connect_req, struct uv__connect_attempt, req);
+  req = attempt->owner;
+  handle = req->handle;
+
+  if (status) {
+    req->error = uv_last_error(req->loop);
+    uv__connect_attempt_close(attempt);
+    uv__connect_name_next(req);
+    return;
+  }
+
+  /* Take the connected socket away from the attempt and give it to handle. */
+  ev_io_stop(req->loop->ev, &attempt->tcp.io.read_watcher);
+  ev_io_stop(req->loop->ev, &attempt->tcp.io.write_watcher);
+  fd = attempt->tcp.fd;
+  attempt->tcp.fd = -1;
+  uv__connect_attempt_close(attempt);
+
+  if (uv__stream_open((uv_stream_t*)handle, fd, UV_READABLE | UV_WRITABLE)) {
+    req->error = uv_last_error(req->loop);
+    uv__close(fd);
+    handle->fd = -1;
+    uv__connect_name_finish(req, -1);
+    return;
+  }
+
+  uv__connect_name_finish(req, 0);
+}
+
+
+static int uv__connect_name_attempt(uv_connect_name_t* req,
+                                    struct addrinfo* ai) {
+  struct uv__connect_attempt* attempt;
+
+  attempt = malloc(sizeof *attempt);
+  if (attempt == NULL) {
+    uv__set_sys_error(req->loop, ENOMEM);
+    return -1;
+  }
+
+  uv_tcp_init(req->loop, &attempt->tcp);
+  attempt->owner = req;
+  ngx_queue_insert_tail(&req->attempts, &attempt->queue);
+
+  if (uv__connect(&attempt->req,
+                  (uv_stream_t*)&attempt->tcp,
+                  ai->ai_addr,
+                  ai->ai_addrlen,
+                  uv__connect_name_connected)) {
+    uv__connect_attempt_close(attempt);
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/*
+ * Start the next attempt, skipping addresses that fail straight away, and
+ * arm the timer for the one after. Finishes the request when nothing is left
+ * to try or wait for.
+ */
+static void uv__connect_name_next(uv_connect_name_t* req) {
+  ev_timer_stop(req->loop->ev, &req->timer);
+
+  while (req->next_addr < req->naddrs) {
+    if (uv__connect_name_attempt(req, req->addrs[req->next_addr++]) == 0) {
+      if (req->next_addr < req->naddrs) {
+        ev_timer_set(&req->timer, req->delay / 1000., 0.);
+        ev_timer_start(req->loop->ev, &req->timer);
+      }
+      return;
+    }
+
+    req->error = uv_last_error(req->loop);
+  }
+
+  if (ngx_queue_empty(&req->attempts))
+    uv__connect_name_finish(req, -1);
+}
+
+
+static void uv__connect_name_timer(EV_P_ ev_timer* w, int revents) {
+  uv__connect_name_next(container_of(w, uv_connect_name_t, timer));
+}
+
+
+/* Returns the next address at or after ai that is (or isn't) of family. */
+static struct addrinfo* uv__next_family(struct addrinfo* ai,
+                                        int family,
+                                        int same) {
+  while (ai && (ai->ai_family == family) != same)
+    ai = ai->ai_next;
+  return ai;
+}
+
+
+static void uv__connect_name_resolved(uv_getaddrinfo_t* getaddrinfo_req,
+                                      int status,
+                                      struct addrinfo* res) {
+  uv_connect_name_t* req;
+  struct addrinfo* first;
+  struct addrinfo* other;
+  struct addrinfo* ai;
+  int family;
+  int n;
+
+  req = container_of(getaddrinfo_req, uv_connect_name_t, getaddrinfo_req);
+
+  if (status) {
+    req->cb(req, -1);
+    return;
+  }
+
+  n = 0;
+  for (ai = res; ai; ai = ai->ai_next)
+    n++;
+
+  req->addrinfo = res;
+  req->addrs = malloc(n * sizeof(req->addrs[0]));
+  if (req->addrs == NULL) {
+    req->error.code = UV_ENOMEM;
+    req->error.sys_errno_ = ENOMEM;
+    uv__connect_name_finish(req, -1);
+    return;
+  }
+
+  /* Interleave the families, starting with the one the resolver put first. */
+  family = res->ai_family;
+  first = res;
+  other = uv__next_family(res, family, 0);
+
+  for (req->naddrs = 0; req->naddrs < n; req->naddrs++) {
+    first = uv__next_family(first, family, 1);
+    if (first && (req->naddrs % 2 == 0 || other == NULL)) {
+      req->addrs[req->naddrs] = first;
+      first = first->ai_next;
+    } else {
+      req->addrs[req->naddrs] = other;
+      other = uv__next_family(other->ai_next, family, 0);
+    }
+  }
+
+  uv__connect_name_next(req);
+}
+
+
+int uv_tcp_connect_name(uv_connect_name_t* req,
+                        uv_tcp_t* handle,
+                        const char* node,
+                        const char* service,
+                        unsigned int delay,
+                        uv_connect_name_cb cb) {
+  struct addrinfo hints;
+
+  if (handle->type != UV_TCP || handle->fd >= 0) {
+    uv__set_sys_error(handle->loop, EINVAL);
+    return -1;
+  }
+
+  uv__req_init((uv_req_t*)req);
+  req->type = UV_CONNECT_NAME;
+  req->loop = handle->loop;
+  req->handle = handle;
+  req->cb = cb;
+  req->delay = delay ? delay : UV_CONNECT_NAME_DELAY;
+  req->addrinfo = NULL;
+  req->addrs = NULL;
+  req->naddrs = 0;
+  req->next_addr = 0;
+  req->error.code = UV_OK;
+  req->error.sys_errno_ = 0;
+  ngx_queue_init(&req->attempts);
+  ev_timer_init(&req->timer, uv__connect_name_timer, 0., 0.);
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  return uv_getaddrinfo(req->loop,
+                        &req->getaddrinfo_req,
+                        uv__connect_name_resolved,
+                        node,
+                        service,
+                        &hints);
+}
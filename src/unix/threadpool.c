@@ -0,0 +1,571 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Thread pool for uv_queue_work().
+ *
+ * Every worker owns a deque guarded by its own mutex. Submissions are spread
+ * round-robin over the workers and pushed onto the tail. A worker pops the
+ * newest work off its own tail first and steals the oldest work off the
+ * heads of the other workers' deques when it runs dry. Workers only touch
+ * the shared idle mutex when there is nothing left to steal, so short jobs
+ * don't all serialize on one lock the way they do in libeio's request
+ * queue.
+ *
+ * Finished work is handed back to the loop that submitted it through a
+ * lock-free list and an ev_async watcher, the same way uv_post() works.
+ * Work that is still queued can be cancelled; it is taken off its worker's
+ * queue and handed back the same way, without running.
+ *
+ * In front of the pool every loop keeps its lanes (see uv_lane_t). A lane at
+ * its limit parks new work on the loop until some of its work finishes, so
+ * one kind of request can't take every thread. Lanes are only touched from
+ * the loop's thread and need no locking.
+ *
+ * The pool is started on first use. Its size defaults to the number of
+ * online CPUs (at least 4) and can be set with the UV_THREADPOOL_SIZE
+ * environment variable.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MIN_THREADPOOL_SIZE 4
+#define MAX_THREADPOOL_SIZE 128
+
+
+struct uv__worker {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  ngx_queue_t queue;
+};
+
+
+static pthread_once_t once = PTHREAD_ONCE_INIT;
+static struct uv__worker* workers;
+static unsigned int nworkers;
+static unsigned int next_worker;
+
+/* Workers with nothing to run or steal sleep on idle_cond. pending counts
+ * queued work that no worker has picked up yet. It is only incremented with
+ * idle_mutex held, which is what keeps wakeups from getting lost.
+ */
+static pthread_mutex_t idle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int idle_workers;
+static volatile int pending;
+
+/* Orders the hand-back of work that can be detached against
+ * uv__work_detach().
+ */
+static pthread_mutex_t detach_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void uv__work_cancelled(struct uv__work* w) {
+  /* Never called, marks cancelled work. */
+  abort();
+}
+
+
+/* Takes the work at the tail of the worker's deque if lifo is set, else the
+ * work at its head.
+ */
+static struct uv__work* uv__worker_take(struct uv__worker* worker, int lifo) {
+  struct uv__work* w;
+  ngx_queue_t* q;
+
+  w = NULL;
+
+  pthread_mutex_lock(&worker->mutex);
+
+  if (!ngx_queue_empty(&worker->queue)) {
+    q = lifo ? ngx_queue_last(&worker->queue) : ngx_queue_head(&worker->queue);
+    ngx_queue_remove(q);
+    /* An unlinked wq tells uv__work_cancel() the work has been taken. */
+    ngx_queue_init(q);
+    w = ngx_queue_data(q, struct uv__work, wq);
+    __sync_fetch_and_sub(&pending, 1);
+  }
+
+  pthread_mutex_unlock(&worker->mutex);
+
+  return w;
+}
+
+
+/* The owner runs the newest work first, its data is most likely still in
+ * cache.
+ */
+static struct uv__work* uv__worker_pop(struct uv__worker* worker) {
+  return uv__worker_take(worker, 1);
+}
+
+
+/* Thieves take the oldest work, so nothing waits behind a busy owner for
+ * long.
+ */
+static struct uv__work* uv__worker_steal(struct uv__worker* self) {
+  struct uv__work* w;
+  unsigned int i;
+  unsigned int n;
+
+  n = self - workers;
+
+  for (i = 1; i < nworkers; i++) {
+    if ((w = uv__worker_take(&workers[(n + i) % nworkers], 0))) {
+      return w;
+    }
+  }
+
+  return NULL;
+}
+
+
+static void uv__work_done_push(struct uv__work* w) {
+  uv_loop_t* loop = w->loop;
+  struct uv__work* head;
+
+  do {
+    head = loop->work_done_head;
+    w->next_done = head;
+  }
+  while (!__sync_bool_compare_and_swap(&loop->work_done_head, head, w));
+
+  if (head == NULL) {
+    ev_async_send(loop->ev, &loop->work_watcher);
+  }
+}
+
+
+static void* uv__worker_main(void* arg) {
+  struct uv__worker* self = arg;
+  struct uv__work* w;
+  int orphaned;
+
+  for (;;) {
+    if ((w = uv__worker_pop(self)) == NULL &&
+        (w = uv__worker_steal(self)) == NULL) {
+      pthread_mutex_lock(&idle_mutex);
+      while (pending <= 0) {
+        idle_workers++;
+        pthread_cond_wait(&idle_cond, &idle_mutex);
+        idle_workers--;
+      }
+      pthread_mutex_unlock(&idle_mutex);
+      continue;
+    }
+
+    w->work(w);
+
+    if (w->orphan == NULL) {
+      uv__work_done_push(w);
+      continue;
+    }
+
+    pthread_mutex_lock(&detach_mutex);
+    orphaned = w->orphaned;
+    if (!orphaned) {
+      uv__work_done_push(w);
+      /* Handed back, uv__work_detach() can't take it any more. */
+      w->orphan = NULL;
+    }
+    pthread_mutex_unlock(&detach_mutex);
+
+    if (orphaned) {
+      w->orphan(w);
+    }
+  }
+
+  return NULL;
+}
+
+
+static void uv__threadpool_init(void) {
+  const char* val;
+  long n;
+  unsigned int i;
+  int r;
+
+  n = 0;
+
+  if ((val = getenv("UV_THREADPOOL_SIZE"))) {
+    n = atol(val);
+  }
+
+  if (n <= 0) {
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < MIN_THREADPOOL_SIZE) {
+      n = MIN_THREADPOOL_SIZE;
+    }
+  }
+
+  if (n > MAX_THREADPOOL_SIZE) {
+    n = MAX_THREADPOOL_SIZE;
+  }
+
+  nworkers = n;
+  workers = calloc(nworkers, sizeof(workers[0]));
+  if (workers == NULL) {
+    uv_fatal_error(ENOMEM, "calloc");
+  }
+
+  for (i = 0; i < nworkers; i++) {
+    if ((r = pthread_mutex_init(&workers[i].mutex, NULL))) {
+      uv_fatal_error(r, "pthread_mutex_init");
+    }
+    ngx_queue_init(&workers[i].queue);
+  }
+
+  for (i = 0; i < nworkers; i++) {
+    r = pthread_create(&workers[i].thread, NULL, uv__worker_main,
+        &workers[i]);
+    if (r) {
+      uv_fatal_error(r, "pthread_create");
+    }
+  }
+}
+
+
+static void uv__work_dispatch(struct uv__work* w) {
+  struct uv__worker* worker;
+
+  worker = &workers[__sync_fetch_and_add(&next_worker, 1) % nworkers];
+  w->worker = worker;
+
+  pthread_mutex_lock(&worker->mutex);
+  ngx_queue_insert_tail(&worker->queue, &w->wq);
+  pthread_mutex_unlock(&worker->mutex);
+
+  pthread_mutex_lock(&idle_mutex);
+  __sync_fetch_and_add(&pending, 1);
+  if (idle_workers > 0) {
+    pthread_cond_signal(&idle_cond);
+  }
+  pthread_mutex_unlock(&idle_mutex);
+}
+
+
+/* Whether the lane has as much work on the pool as its limit allows. */
+static int uv__lane_full(struct uv__lane* lane) {
+  unsigned int limit = lane->limit;
+
+  if (limit == UV__LANE_LIMIT_DEFAULT) {
+    /* Leave a thread for the other lanes. */
+    limit = nworkers > 1 ? nworkers - 1 : 0;
+  }
+
+  return limit != 0 && lane->active >= limit;
+}
+
+
+/* Moves parked work onto the pool as far as the lane's limit allows. */
+static void uv__lane_drain(struct uv__lane* lane) {
+  struct uv__work* w;
+  ngx_queue_t* q;
+
+  while (!ngx_queue_empty(&lane->queue) && !uv__lane_full(lane)) {
+    q = ngx_queue_head(&lane->queue);
+    ngx_queue_remove(q);
+    w = ngx_queue_data(q, struct uv__work, wq);
+    lane->active++;
+    uv__work_dispatch(w);
+  }
+}
+
+
+static void uv__work_io(struct ev_loop* ev, ev_async* w, int revents) {
+  uv_loop_t* loop = ev_userdata(ev);
+  struct uv__work* head;
+  struct uv__work* next;
+  struct uv__work* prev;
+  struct uv__work* work;
+
+  assert(w == &loop->work_watcher);
+
+  head = __sync_lock_test_and_set(&loop->work_done_head, NULL);
+
+  /* Restore completion order. Parked work that was cancelled never took a
+   * slot in its lane.
+   */
+  prev = NULL;
+  for (work = head; work != NULL; work = next) {
+    next = work->next_done;
+    work->next_done = prev;
+    prev = work;
+
+    if (work->worker != NULL) {
+      loop->lanes[work->lane].active--;
+    }
+  }
+
+  /* Let parked work go first, callbacks may submit more. */
+  uv__lane_drain(&loop->lanes[UV_LANE_WORK]);
+  uv__lane_drain(&loop->lanes[UV_LANE_DNS]);
+
+  for (work = prev; work != NULL; work = next) {
+    next = work->next_done;
+    work->in_flight = 0;
+    work->done(work, work->work == uv__work_cancelled ? -1 : 0);
+  }
+}
+
+
+void uv__work_init(uv_loop_t* loop) {
+  int i;
+
+  for (i = 0; i < UV__LANES; i++) {
+    loop->lanes[i].limit = 0;
+    loop->lanes[i].active = 0;
+    ngx_queue_init(&loop->lanes[i].queue);
+  }
+
+  /* Don't let work hold up DNS, see uv_lane_set_limit(). */
+  loop->lanes[UV_LANE_WORK].limit = UV__LANE_LIMIT_DEFAULT;
+
+  loop->work_done_head = NULL;
+  ev_async_init(&loop->work_watcher, uv__work_io);
+  ev_async_start(loop->ev, &loop->work_watcher);
+  /* Pending work keeps the loop alive through uv_ref(), not the watcher. */
+  ev_unref(loop->ev);
+}
+
+
+/* Called when a request is set up, so that uv_cancel() can tell that it
+ * hasn't been submitted.
+ */
+void uv__work_req_init(struct uv__work* w) {
+  w->worker = NULL;
+  w->in_flight = 0;
+  w->orphan = NULL;
+  w->orphaned = 0;
+  ngx_queue_init(&w->wq);
+}
+
+
+void uv__work_submit(uv_loop_t* loop,
+                     uv_lane_t lane,
+                     struct uv__work* w,
+                     void (*work)(struct uv__work* w),
+                     void (*done)(struct uv__work* w, int status)) {
+  struct uv__lane* l = &loop->lanes[lane];
+
+  pthread_once(&once, uv__threadpool_init);
+
+  w->loop = loop;
+  w->work = work;
+  w->done = done;
+  w->next_done = NULL;
+  w->lane = lane;
+  w->in_flight = 1;
+
+  if (uv__lane_full(l)) {
+    w->worker = NULL;
+    ngx_queue_insert_tail(&l->queue, &w->wq);
+    return;
+  }
+
+  l->active++;
+  uv__work_dispatch(w);
+}
+
+
+/* Completes w on the loop without running it on the pool, for requests that
+ * can be answered right away but whose callback must not run synchronously.
+ */
+void uv__work_complete(uv_loop_t* loop,
+                       uv_lane_t lane,
+                       struct uv__work* w,
+                       void (*done)(struct uv__work* w, int status)) {
+  w->loop = loop;
+  w->work = NULL;
+  w->done = done;
+  w->next_done = NULL;
+  w->lane = lane;
+  w->in_flight = 1;
+  w->worker = NULL;
+  ngx_queue_init(&w->wq);
+
+  uv__work_done_push(w);
+}
+
+
+/* Parks w on a queue owned by the caller, who later completes it by clearing
+ * w->in_flight and calling done directly. Until then uv__work_cancel() can
+ * take it off like work parked in a lane.
+ */
+void uv__work_park(uv_loop_t* loop,
+                   uv_lane_t lane,
+                   struct uv__work* w,
+                   ngx_queue_t* queue,
+                   void (*done)(struct uv__work* w, int status)) {
+  w->loop = loop;
+  w->work = NULL;
+  w->done = done;
+  w->next_done = NULL;
+  w->lane = lane;
+  w->in_flight = 1;
+  w->worker = NULL;
+  ngx_queue_insert_tail(queue, &w->wq);
+}
+
+
+/* Takes w off its lane or its worker's queue. Returns UV_EBUSY if a worker
+ * already has it and UV_EINVAL if it isn't in flight.
+ */
+uv_err_code uv__work_cancel(struct uv__work* w) {
+  struct uv__worker* worker;
+  int queued;
+
+  if (!w->in_flight) {
+    return UV_EINVAL;
+  }
+
+  worker = w->worker;
+
+  if (worker == NULL) {
+    /* Parked in its lane or by uv__work_park(), only the loop's thread
+     * touches it.
+     */
+    if (ngx_queue_empty(&w->wq)) {
+      return UV_EBUSY;
+    }
+
+    ngx_queue_remove(&w->wq);
+    ngx_queue_init(&w->wq);
+    w->work = uv__work_cancelled;
+    uv__work_done_push(w);
+
+    return UV_OK;
+  }
+
+  pthread_mutex_lock(&worker->mutex);
+
+  queued = !ngx_queue_empty(&w->wq);
+  if (queued) {
+    ngx_queue_remove(&w->wq);
+    ngx_queue_init(&w->wq);
+    __sync_fetch_and_sub(&pending, 1);
+  }
+
+  pthread_mutex_unlock(&worker->mutex);
+
+  if (!queued) {
+    return UV_EBUSY;
+  }
+
+  w->work = uv__work_cancelled;
+  uv__work_done_push(w);
+
+  return UV_OK;
+}
+
+
+/* Cuts work that a worker is running loose from its loop, so the loop can
+ * be deleted under it. The worker calls w->orphan instead of handing the
+ * work back, and done is never called. Only work whose orphan was set
+ * before it was submitted can be detached. Returns UV_EBUSY if the work has
+ * already been handed back to the loop.
+ */
+uv_err_code uv__work_detach(struct uv__work* w) {
+  uv_err_code err;
+
+  pthread_mutex_lock(&detach_mutex);
+
+  if (w->orphan != NULL) {
+    w->orphaned = 1;
+    err = UV_OK;
+  } else {
+    err = UV_EBUSY;
+  }
+
+  pthread_mutex_unlock(&detach_mutex);
+
+  return err;
+}
+
+
+static void uv__queue_work(struct uv__work* w) {
+  uv_work_t* req = container_of(w, uv_work_t, work_req);
+
+  if (req->work_cb) {
+    req->work_cb(req);
+  }
+}
+
+
+static void uv__queue_done(struct uv__work* w, int status) {
+  uv_work_t* req = container_of(w, uv_work_t, work_req);
+
+  uv_unref(req->loop);
+
+  if (status) {
+    uv__set_artificial_error(req->loop, UV_ECANCELED);
+  } else {
+    uv__set_artificial_error(req->loop, UV_OK);
+  }
+
+  if (req->after_work_cb) {
+    req->after_work_cb(req);
+  }
+}
+
+
+int uv_queue_work(uv_loop_t* loop, uv_work_t* req, uv_work_cb work_cb,
+    uv_after_work_cb after_work_cb) {
+  uv__req_init((uv_req_t*) req);
+  uv__work_req_init(&req->work_req);
+  req->type = UV_WORK;
+  req->loop = loop;
+  req->work_cb = work_cb;
+  req->after_work_cb = after_work_cb;
+
+  uv_ref(loop);
+  uv__work_submit(loop, UV_LANE_WORK, &req->work_req, uv__queue_work,
+      uv__queue_done);
+
+  return 0;
+}
+
+
+int uv_lane_set_limit(uv_loop_t* loop, uv_lane_t lane, unsigned int limit) {
+  switch (lane) {
+    case UV_LANE_FS:
+      /* libeio's pool is process-wide, see uv_fs_set_max_parallel(). */
+      uv__set_artificial_error(loop, UV_ENOTSUP);
+      return -1;
+
+    case UV_LANE_WORK:
+    case UV_LANE_DNS:
+      loop->lanes[lane].limit = limit;
+      uv__lane_drain(&loop->lanes[lane]);
+      return 0;
+
+    default:
+      uv__set_artificial_error(loop, UV_EINVAL);
+      return -1;
+  }
+}
@@ -132,3 +132,9 @@ void uv_eio_init(uv_loop_t* loop) {
     assert(main_loop == loop);
   }
 }
+
+
+void uv_fs_set_max_parallel(unsigned int n) {
+  /* libeio's own default is 4 threads. */
+  eio_set_max_parallel(n ? n : 4);
+}
@@ -24,6 +24,7 @@
 
 #include <assert.h>
 #include <stddef.h> /* NULL */
+#include <stdlib.h> /* calloc */
 #include <string.h> /* memset */
 
 /* use inet_pton from c-ares if necessary */
@@ -91,6 +92,7 @@ const char* uv_err_name(uv_err_t err) {
     case UV_EPROTOTYPE: return "EPROTOTYPE";
     case UV_ETIMEDOUT: return "ETIMEDOUT";
     case UV_EEXIST: return "EEXIST";
+    case UV_ECANCELED: return "ECANCELED";
     default:
       assert(0);
       return NULL;
@@ -167,23 +169,92 @@ int uv_ip6_name(struct sockaddr_in6* src, char* dst, size_t size) {
 }
 
 
-/* find matching ares handle in list */
-void uv_add_ares_handle(uv_loop_t* loop, uv_ares_task_t* handle) {
+/*
+ * ares task handles are kept in a per-loop table indexed by socket. Sockets
+ * are small, densely allocated integers so the low bits make a good bucket
+ * index; the table doubles whenever it holds as many handles as buckets.
+ */
+#define UV__ARES_HANDLES_MIN 16
+
+static uv_ares_task_t** uv__ares_bucket(uv_loop_t* loop, ares_socket_t sock) {
+  return &loop->uv_ares_handles_[(unsigned int)sock &
+                                 (loop->uv_ares_handles_size_ - 1)];
+}
+
+
+static int uv__ares_handles_grow(uv_loop_t* loop) {
+  uv_ares_task_t** old_handles;
+  uv_ares_task_t** bucket;
+  uv_ares_task_t* handle;
+  uv_ares_task_t* next;
+  unsigned int old_size;
+  unsigned int i;
+
+  old_handles = loop->uv_ares_handles_;
+  old_size = loop->uv_ares_handles_size_;
+
+  loop->uv_ares_handles_size_ = old_size ? old_size * 2 : UV__ARES_HANDLES_MIN;
+  loop->uv_ares_handles_ = calloc(loop->uv_ares_handles_size_,
+                                  sizeof(uv_ares_task_t*));
+  if (loop->uv_ares_handles_ == NULL) {
+    /* Out of memory. Keep the old table, the chains just get longer. */
+    loop->uv_ares_handles_ = old_handles;
+    loop->uv_ares_handles_size_ = old_size;
+    return old_size ? 0 : -1;
+  }
+
+  for (i = 0; i < old_size; i++) {
+    for (handle = old_handles[i]; handle != NULL; handle = next) {
+      next = handle->ares_next;
+      bucket = uv__ares_bucket(loop, handle->sock);
+      handle->ares_prev = NULL;
+      handle->ares_next = *bucket;
+      if (*bucket) {
+        (*bucket)->ares_prev = handle;
+      }
+      *bucket = handle;
+    }
+  }
+
+  free(old_handles);
+  return 0;
+}
+
+
+/* add ares handle to the table. Returns -1 when out of memory. */
+int uv_add_ares_handle(uv_loop_t* loop, uv_ares_task_t* handle) {
+  uv_ares_task_t** bucket;
+
+  if (loop->uv_ares_handles_count_ >= loop->uv_ares_handles_size_) {
+    if (uv__ares_handles_grow(loop)) {
+      return -1;
+    }
+  }
+
+  bucket = uv__ares_bucket(loop, handle->sock);
+
   handle->loop = loop;
-  handle->ares_next = loop->uv_ares_handles_;
+  handle->ares_next = *bucket;
   handle->ares_prev = NULL;
 
-  if (loop->uv_ares_handles_) {
-    loop->uv_ares_handles_->ares_prev = handle;
+  if (*bucket) {
+    (*bucket)->ares_prev = handle;
   }
 
-  loop->uv_ares_handles_ = handle;
+  *bucket = handle;
+  loop->uv_ares_handles_count_++;
+  return 0;
 }
 
-/* find matching ares handle in list */
-/* TODO: faster lookup */
+/* find matching ares handle in the table */
 uv_ares_task_t* uv_find_ares_handle(uv_loop_t* loop, ares_socket_t sock) {
-  uv_ares_task_t* handle = loop->uv_ares_handles_;
+  uv_ares_task_t* handle;
+
+  if (loop->uv_ares_handles_count_ == 0) {
+    return NULL;
+  }
+
+  handle = *uv__ares_bucket(loop, sock);
 
   while (handle != NULL) {
     if (handle->sock == sock) {
@@ -195,12 +266,13 @@ uv_ares_task_t* uv_find_ares_handle(uv_loop_t* loop, ares_socket_t sock) {
   return handle;
 }
 
-/* remove ares handle in list */
+/* remove ares handle from the table */
 void uv_remove_ares_handle(uv_ares_task_t* handle) {
   uv_loop_t* loop = handle->loop;
+  uv_ares_task_t** bucket = uv__ares_bucket(loop, handle->sock);
 
-  if (handle == loop->uv_ares_handles_) {
-    loop->uv_ares_handles_ = handle->ares_next;
+  if (handle == *bucket) {
+    *bucket = handle->ares_next;
   }
 
   if (handle->ares_next) {
@@ -210,12 +282,23 @@ void uv_remove_ares_handle(uv_ares_task_t* handle) {
   if (handle->ares_prev) {
     handle->ares_prev->ares_next = handle->ares_next;
   }
+
+  loop->uv_ares_handles_count_--;
 }
 
 
-/* Returns 1 if the uv_ares_handles_ list is empty. 0 otherwise. */
+/* Returns 1 if the ares handle table is empty. 0 otherwise. */
 int uv_ares_handles_empty(uv_loop_t* loop) {
-  return loop->uv_ares_handles_ ? 0 : 1;
+  return loop->uv_ares_handles_count_ ? 0 : 1;
+}
+
+
+/* Frees the ares handle table. All handles must have been removed. */
+void uv__ares_handles_cleanup(uv_loop_t* loop) {
+  assert(loop->uv_ares_handles_count_ == 0);
+  free(loop->uv_ares_handles_);
+  loop->uv_ares_handles_ = NULL;
+  loop->uv_ares_handles_size_ = 0;
 }
 
 int uv_tcp_bind(uv_tcp_t* handle, struct sockaddr_in addr) {
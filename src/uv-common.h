@@ -44,9 +44,10 @@ void uv_remove_ares_handle(uv_ares_task_t* handle);
 uv_ares_task_t* uv_find_ares_handle(uv_loop_t*, ares_socket_t sock);
 
 /* TODO Rename to uv_ares_task_init? */
-void uv_add_ares_handle(uv_loop_t* loop, uv_ares_task_t* handle);
+int uv_add_ares_handle(uv_loop_t* loop, uv_ares_task_t* handle);
 
 int uv_ares_handles_empty(uv_loop_t* loop);
+void uv__ares_handles_cleanup(uv_loop_t* loop);
 
 uv_err_code uv_translate_sys_error(int sys_errno);
 void uv__set_error(uv_loop_t* loop, uv_err_code code, int sys_error);
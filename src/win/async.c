@@ -125,3 +125,10 @@ void uv_process_async_wakeup_req(uv_loop_t* loop, uv_async_t* handle,
     uv_want_endgame(loop, (uv_handle_t*)handle);
   }
 }
+
+
+int uv_post(uv_loop_t* loop, uv_post_t* req, uv_post_cb cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
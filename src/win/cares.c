@@ -177,8 +177,10 @@ static void uv_ares_sockstate_cb(void *data, ares_socket_t sock, int read,
         uv_fatal_error(WSAGetLastError(), "WSAEventSelect");
       }
 
-      /* add handle to list */
-      uv_add_ares_handle(loop, uv_handle_ares);
+      /* add handle to the table */
+      if (uv_add_ares_handle(loop, uv_handle_ares)) {
+        uv_fatal_error(ERROR_OUTOFMEMORY, "malloc");
+      }
       uv_ref(loop);
 
       /*
@@ -255,6 +257,7 @@ int uv_ares_init_options(uv_loop_t* loop,
                          ares_channel *channelptr,
                          struct ares_options *options,
                          int optmask) {
+  struct ares_options opts;
   int rc;
 
   /* only allow single init at a time */
@@ -262,13 +265,24 @@ int uv_ares_init_options(uv_loop_t* loop,
     return UV_EALREADY;
   }
 
+  /* Leave the caller's options alone. */
+  opts = *options;
+
   /* set our callback as an option */
-  options->sock_state_cb = uv_ares_sockstate_cb;
-  options->sock_state_cb_data = loop;
+  opts.sock_state_cb = uv_ares_sockstate_cb;
+  opts.sock_state_cb_data = loop;
   optmask |= ARES_OPT_SOCK_STATE_CB;
 
+  /* Identical queries in flight share one unless the caller passed flags
+   * of its own, see uv.h.
+   */
+  if (!(optmask & ARES_OPT_FLAGS)) {
+    opts.flags = ARES_FLAG_COALESCE;
+    optmask |= ARES_OPT_FLAGS;
+  }
+
   /* We do the call to ares_init_option for caller. */
-  rc = ares_init_options(channelptr, options, optmask);
+  rc = ares_init_options(channelptr, &opts, optmask);
 
   /* if success, save channel */
   if (rc == ARES_SUCCESS) {
@@ -157,6 +157,17 @@ static void uv_fs_req_init_sync(uv_loop_t* loop, uv_fs_t* req,
 }
 
 
+/* For the unix-only uv_fs_* calls. */
+static int uv_fs_not_implemented(uv_loop_t* loop, uv_fs_t* req,
+    uv_fs_type fs_type) {
+  uv_fs_req_init_sync(loop, req, fs_type);
+  req->result = -1;
+  req->errorno = UV_ENOSYS;
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
+
+
 void fs__open(uv_fs_t* req, const wchar_t* path, int flags, int mode) {
   DWORD access;
   DWORD share;
@@ -1045,6 +1056,11 @@ int uv_fs_readdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int flags,
   wchar_t* pathw;
   int size;
 
+  /* Only names are listed on Windows so far. */
+  if (flags & (UV_FS_READDIR_TYPES | UV_FS_READDIR_STAT_ORDER)) {
+    return uv_fs_not_implemented(loop, req, UV_FS_READDIR);
+  }
+
   /* Convert to UTF16. */
   UTF8_TO_UTF16(path, pathw);
 
@@ -1512,3 +1528,83 @@ void uv_fs_req_cleanup(uv_fs_t* req) {
 
   req->flags |= UV_FS_CLEANEDUP;
 }
+
+
+int uv_fs_readv(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_buf_t bufs[],
+    int nbufs, off_t offset, uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_READV);
+}
+
+
+int uv_fs_writev(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_buf_t bufs[],
+    int nbufs, off_t offset, uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_WRITEV);
+}
+
+
+int uv_fs_opendir(uv_loop_t* loop, uv_fs_t* req, const char* path,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_OPENDIR);
+}
+
+
+int uv_fs_readdir_chunk(uv_loop_t* loop, uv_fs_t* req, uv_dir_t* dir,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_READDIR_CHUNK);
+}
+
+
+int uv_fs_closedir(uv_loop_t* loop, uv_fs_t* req, uv_dir_t* dir,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_CLOSEDIR);
+}
+
+
+int uv_fs_walk(uv_loop_t* loop, uv_fs_walk_t* req, const char* path,
+    const uv_fs_walk_options_t* options, uv_fs_walk_entries_cb entries_cb,
+    uv_fs_walk_cb cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
+
+
+int uv_fs_batch(uv_loop_t* loop, uv_fs_t* req, uv_fs_op_t ops[], int nops,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_BATCH);
+}
+
+
+int uv_fs_read_file(uv_loop_t* loop, uv_fs_t* req, const char* path,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_READ_FILE);
+}
+
+
+int uv_fs_mmap(uv_loop_t* loop, uv_fs_t* req, uv_file file, size_t length,
+    off_t offset, int flags, uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_MMAP);
+}
+
+
+int uv_fs_munmap(uv_loop_t* loop, uv_fs_t* req, void* addr, size_t length,
+    uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_MUNMAP);
+}
+
+
+int uv_fs_fadvise(uv_loop_t* loop, uv_fs_t* req, uv_file file, off_t offset,
+    size_t length, uv_fs_advice advice, uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_FADVISE);
+}
+
+
+int uv_fs_readahead(uv_loop_t* loop, uv_fs_t* req, uv_file file,
+    off_t offset, size_t length, uv_fs_cb cb) {
+  return uv_fs_not_implemented(loop, req, UV_FS_READAHEAD);
+}
+
+
+void uv_fs_set_max_parallel(unsigned int n) {
+  /* Windows fs requests run on the system thread pool. */
+}
@@ -366,3 +366,11 @@ error:
   }
   return -1;
 }
+
+
+int uv_getaddrinfo_cache(uv_loop_t* loop, unsigned int ttl,
+    unsigned int negative_ttl, unsigned int stale) {
+  /* not implemented yet */
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
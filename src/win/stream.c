@@ -186,3 +186,27 @@ size_t uv_count_bufs(uv_buf_t bufs[], int count) {
 
   return bytes;
 }
+
+
+int uv_write_watermarks(uv_stream_t* handle, size_t low, size_t high,
+    uv_watermark_cb pause_cb, uv_watermark_cb drain_cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(handle->loop, UV_ENOSYS);
+  return -1;
+}
+
+
+int uv_write_sendfile(uv_write_t* req, uv_stream_t* handle, uv_file in_fd,
+    off_t offset, size_t length, uv_write_cb cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(handle->loop, UV_ENOSYS);
+  return -1;
+}
+
+
+int uv_stream_pipe(uv_stream_pipe_t* req, uv_stream_t* src, uv_stream_t* dst,
+    uv_stream_pipe_cb cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(src->loop, UV_ENOSYS);
+  return -1;
+}
@@ -1069,3 +1069,12 @@ int uv_tcp_duplicate_socket(uv_tcp_t* handle, int pid,
 
   return 0;
 }
+
+
+int uv_tcp_connect_name(uv_connect_name_t* req, uv_tcp_t* handle,
+    const char* node, const char* service, unsigned int delay,
+    uv_connect_name_cb cb) {
+  /* not implemented yet */
+  uv__set_artificial_error(handle->loop, UV_ENOSYS);
+  return -1;
+}
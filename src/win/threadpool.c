@@ -71,3 +71,17 @@ void uv_process_work_req(uv_loop_t* loop, uv_work_t* req) {
   req->after_work_cb(req);
   uv_unref(loop);
 }
+
+
+int uv_cancel(uv_loop_t* loop, uv_req_t* req) {
+  /* not implemented yet */
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
+
+
+int uv_lane_set_limit(uv_loop_t* loop, uv_lane_t lane, unsigned int limit) {
+  /* not implemented yet */
+  uv__set_artificial_error(loop, UV_ENOSYS);
+  return -1;
+}
@@ -118,3 +118,83 @@ BENCHMARK_IMPL(gethostbyname) {
 
   return 0;
 }
+
+
+#define NUM_SEQUENTIAL_CALLS  200
+
+static int sequential_left;
+
+
+static void sequential_callback(void *arg,
+                                int status,
+                                int timeouts,
+                                struct hostent *hostent) {
+  aresbynamecallback(arg, status, timeouts, hostent);
+
+  if (--sequential_left > 0) {
+    ares_gethostbyname(channel,
+                       "echos.srv",
+                       AF_INET,
+                       &sequential_callback,
+                       &argument);
+  }
+}
+
+
+/*
+ * Lookups one at a time against two servers, the first of which answers
+ * 10 ms late. Shows how quickly c-ares settles on the fast one.
+ */
+BENCHMARK_IMPL(gethostbyname_slow_server) {
+  struct sockaddr_in slow_server = uv_ip4_addr("127.0.0.2", 0);
+  struct sockaddr_in fast_server = uv_ip4_addr("127.0.0.1", 0);
+  struct in_addr servers[2];
+  int rc;
+
+  rc = ares_library_init(ARES_LIB_INIT_ALL);
+  if (rc != 0) {
+    printf("ares library init fails %d\n", rc);
+    return 1;
+  }
+
+  loop = uv_default_loop();
+
+  ares_callbacks = 0;
+  ares_errors = 0;
+  sequential_left = NUM_SEQUENTIAL_CALLS;
+
+  servers[0] = slow_server.sin_addr;
+  servers[1] = fast_server.sin_addr;
+
+  optmask = ARES_OPT_SERVERS | ARES_OPT_TCP_PORT | ARES_OPT_FLAGS;
+  options.servers = servers;
+  options.nservers = 2;
+  options.tcp_port = htons(TEST_PORT_2);
+  options.flags = ARES_FLAG_USEVC;
+
+  rc = uv_ares_init_options(loop, &channel, &options, optmask);
+  ASSERT(rc == ARES_SUCCESS);
+
+  uv_update_time(loop);
+  start_time = uv_now(loop);
+
+  ares_gethostbyname(channel,
+                     "echos.srv",
+                     AF_INET,
+                     &sequential_callback,
+                     &argument);
+
+  uv_run(loop);
+
+  uv_ares_destroy(loop, channel);
+
+  end_time = uv_now(loop);
+
+  if (ares_errors > 0) {
+    printf("There were %d failures\n", ares_errors);
+  }
+  LOGF("ares_gethostbyname with a slow server: %.2f ms/req\n",
+      (double)(end_time - start_time) / ares_callbacks);
+
+  return 0;
+}
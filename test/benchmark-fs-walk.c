@@ -0,0 +1,252 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TREE_ROOT   "fs_walk_bench"
+#define TREE_DIRS   20    /* per level */
+#define TREE_FILES  250   /* per leaf directory */
+#define TREE_LEVELS 2
+
+static uv_loop_t* loop;
+
+static int64_t start_time;
+static uint64_t entries;
+static uint64_t dirs;
+static int walk_done;
+
+/* Baseline: one uv_fs_readdir() after the other. */
+static uv_fs_t readdir_req;
+static char** readdir_queue;
+static int readdir_queue_len;
+static int readdir_queue_size;
+
+
+static int tree_create(const char* path, int level) {
+  char child[256];
+  int count;
+  int fd;
+  int i;
+
+  ASSERT(0 == mkdir(path, 0755));
+  count = 1;
+
+  if (level == TREE_LEVELS) {
+    for (i = 0; i < TREE_FILES; i++) {
+      snprintf(child, sizeof(child), "%s/file_%d", path, i);
+      fd = open(child, O_WRONLY | O_CREAT, 0644);
+      ASSERT(fd != -1);
+      close(fd);
+    }
+    return count + TREE_FILES;
+  }
+
+  for (i = 0; i < TREE_DIRS; i++) {
+    snprintf(child, sizeof(child), "%s/dir_%d", path, i);
+    count += tree_create(child, level + 1);
+  }
+
+  return count;
+}
+
+
+static void tree_remove(const char* path, int level) {
+  char child[256];
+  int i;
+
+  if (level == TREE_LEVELS) {
+    for (i = 0; i < TREE_FILES; i++) {
+      snprintf(child, sizeof(child), "%s/file_%d", path, i);
+      unlink(child);
+    }
+  } else {
+    for (i = 0; i < TREE_DIRS; i++) {
+      snprintf(child, sizeof(child), "%s/dir_%d", path, i);
+      tree_remove(child, level + 1);
+    }
+  }
+
+  rmdir(path);
+}
+
+
+static void report(const char* name, int total) {
+  double secs;
+
+  uv_update_time(loop);
+  secs = (uv_now(loop) - start_time) / 1000.0;
+
+  ASSERT(entries + 1 == (uint64_t) total);
+
+  LOGF("%s: %llu entries in %llu dirs, %.0f ms, %.0f entries/s\n",
+       name,
+       (unsigned long long) entries,
+       (unsigned long long) dirs,
+       secs * 1000,
+       entries / secs);
+}
+
+
+static void readdir_next(void);
+
+
+static void readdir_cb(uv_fs_t* req) {
+  uv_dirent_t* ents = req->ptr;
+  char* path;
+  size_t len;
+  int i;
+
+  ASSERT(req->result >= 0);
+  entries += req->result;
+  dirs++;
+
+  for (i = 0; i < req->result; i++) {
+    if (ents[i].type != UV_DIRENT_DIR) {
+      continue;
+    }
+
+    len = strlen(req->path) + strlen(ents[i].name) + 2;
+    path = malloc(len);
+    ASSERT(path != NULL);
+    snprintf(path, len, "%s/%s", req->path, ents[i].name);
+
+    if (readdir_queue_len == readdir_queue_size) {
+      readdir_queue_size = readdir_queue_size ? readdir_queue_size * 2 : 64;
+      readdir_queue = realloc(readdir_queue,
+          readdir_queue_size * sizeof(readdir_queue[0]));
+      ASSERT(readdir_queue != NULL);
+    }
+    readdir_queue[readdir_queue_len++] = path;
+  }
+
+  uv_fs_req_cleanup(req);
+  readdir_next();
+}
+
+
+static void readdir_next(void) {
+  char* path;
+  int r;
+
+  if (readdir_queue_len == 0) {
+    walk_done = 1;
+    return;
+  }
+
+  path = readdir_queue[--readdir_queue_len];
+  r = uv_fs_readdir(loop, &readdir_req, path, UV_FS_READDIR_TYPES,
+      readdir_cb);
+  ASSERT(r == 0);
+  free(path);
+}
+
+
+static void walk_entries_cb(uv_fs_walk_t* req, const char* dir,
+    const uv_dirent_t* dirents, const uv_statbuf_t* stats, int n) {
+}
+
+
+static void walk_cb(uv_fs_walk_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT(req->nerrors == 0);
+  entries = req->nentries;
+  dirs = req->ndirs;
+  walk_done = 1;
+}
+
+
+static int fs_walk_bench(const char* name, int concurrency, int flags) {
+  uv_fs_walk_options_t options;
+  uv_fs_walk_t req;
+  int total;
+
+  loop = uv_default_loop();
+
+  tree_remove(TREE_ROOT, 0);
+  total = tree_create(TREE_ROOT, 0);
+
+  entries = 0;
+  dirs = 0;
+  walk_done = 0;
+
+  uv_update_time(loop);
+  start_time = uv_now(loop);
+
+  if (concurrency == 0) {
+    readdir_queue_len = 0;
+    readdir_queue_size = 1;
+    readdir_queue = malloc(sizeof(readdir_queue[0]));
+    ASSERT(readdir_queue != NULL);
+    readdir_queue[readdir_queue_len++] = strdup(TREE_ROOT);
+    readdir_next();
+  } else {
+    options.flags = flags;
+    options.concurrency = concurrency;
+    options.batch = 0;
+    ASSERT(0 == uv_fs_walk(loop, &req, TREE_ROOT, &options, walk_entries_cb,
+        walk_cb));
+  }
+
+  uv_run(loop);
+  ASSERT(walk_done == 1);
+
+  report(name, total);
+
+  free(readdir_queue);
+  readdir_queue = NULL;
+  tree_remove(TREE_ROOT, 0);
+
+  return 0;
+}
+
+
+BENCHMARK_IMPL(fs_walk_readdir) {
+  return fs_walk_bench("fs_walk_readdir", 0, 0);
+}
+
+
+BENCHMARK_IMPL(fs_walk_1) {
+  return fs_walk_bench("fs_walk_1", 1, 0);
+}
+
+
+BENCHMARK_IMPL(fs_walk_4) {
+  return fs_walk_bench("fs_walk_4", 4, 0);
+}
+
+
+BENCHMARK_IMPL(fs_walk_stat_1) {
+  return fs_walk_bench("fs_walk_stat_1", 1, UV_FS_WALK_STAT);
+}
+
+
+BENCHMARK_IMPL(fs_walk_stat_4) {
+  return fs_walk_bench("fs_walk_stat_4", 4, UV_FS_WALK_STAT);
+}
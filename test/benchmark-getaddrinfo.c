@@ -35,9 +35,11 @@ const char* name = "localhost";
 static uv_loop_t* loop;
 
 static uv_getaddrinfo_t handles[CONCURRENT_CALLS];
+static uint64_t started[CONCURRENT_CALLS];
 
 static int calls_initiated = 0;
 static int calls_completed = 0;
+static uint64_t total_latency;
 static int64_t start_time;
 static int64_t end_time;
 
@@ -49,6 +51,7 @@ static void getaddrinfo_cb(uv_getaddrinfo_t* handle, int status,
     struct addrinfo* res) {
   ASSERT(status == 0);
   calls_completed++;
+  total_latency += uv_hrtime() - started[handle - handles];
   if (calls_initiated < TOTAL_CALLS) {
     getaddrinfo_initiate(handle);
   }
@@ -61,17 +64,22 @@ static void getaddrinfo_initiate(uv_getaddrinfo_t* handle) {
   int r;
 
   calls_initiated++;
+  started[handle - handles] = uv_hrtime();
 
   r = uv_getaddrinfo(loop, handle, &getaddrinfo_cb, name, NULL, NULL);
   ASSERT(r == 0);
 }
 
 
-BENCHMARK_IMPL(getaddrinfo) {
+static int getaddrinfo_bench(int cached) {
   int i;
 
   loop = uv_default_loop();
 
+  if (cached) {
+    ASSERT(0 == uv_getaddrinfo_cache(loop, 60 * 1000, 60 * 1000, 0));
+  }
+
   uv_update_time(loop);
   start_time = uv_now(loop);
 
@@ -87,8 +95,26 @@ BENCHMARK_IMPL(getaddrinfo) {
   ASSERT(calls_initiated == TOTAL_CALLS);
   ASSERT(calls_completed == TOTAL_CALLS);
 
-  LOGF("getaddrinfo: %.0f req/s\n",
-       (double) calls_completed / (double) (end_time - start_time) * 1000.0);
+  LOGF("getaddrinfo%s: %.0f req/s, %.1f us avg latency\n",
+       cached ? " (cached)" : "",
+       (double) calls_completed / (double) (end_time - start_time) * 1000.0,
+       (double) total_latency / calls_completed / 1000.0);
+
+  if (cached) {
+    LOGF("getaddrinfo (cached): %llu hits, %llu misses\n",
+         (unsigned long long) loop->counters.getaddrinfo_cache_hit,
+         (unsigned long long) loop->counters.getaddrinfo_cache_miss);
+  }
 
   return 0;
 }
+
+
+BENCHMARK_IMPL(getaddrinfo) {
+  return getaddrinfo_bench(0);
+}
+
+
+BENCHMARK_IMPL(getaddrinfo_cached) {
+  return getaddrinfo_bench(1);
+}
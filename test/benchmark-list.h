@@ -41,8 +41,30 @@ BENCHMARK_DECLARE (udp_packet_storm_100v100)
 BENCHMARK_DECLARE (udp_packet_storm_100v1000)
 BENCHMARK_DECLARE (udp_packet_storm_1000v1000)
 BENCHMARK_DECLARE (gethostbyname)
+BENCHMARK_DECLARE (gethostbyname_slow_server)
+BENCHMARK_DECLARE (resolver_ares_udp)
+BENCHMARK_DECLARE (resolver_ares_tcp)
+BENCHMARK_DECLARE (resolver_threadpool)
 BENCHMARK_DECLARE (getaddrinfo)
+#ifndef _WIN32
+BENCHMARK_DECLARE (getaddrinfo_cached)
+BENCHMARK_DECLARE (fs_walk_readdir)
+BENCHMARK_DECLARE (fs_walk_1)
+BENCHMARK_DECLARE (fs_walk_4)
+BENCHMARK_DECLARE (fs_walk_stat_1)
+BENCHMARK_DECLARE (fs_walk_stat_4)
+#endif
 BENCHMARK_DECLARE (spawn)
+BENCHMARK_DECLARE (threadpool_1us)
+BENCHMARK_DECLARE (threadpool_100us)
+BENCHMARK_DECLARE (threadpool_10ms)
+#ifndef _WIN32
+BENCHMARK_DECLARE (post_1_producer)
+BENCHMARK_DECLARE (post_2_producers)
+BENCHMARK_DECLARE (post_4_producers)
+BENCHMARK_DECLARE (post_8_producers)
+BENCHMARK_DECLARE (post_16_producers)
+#endif
 HELPER_DECLARE    (tcp4_blackhole_server)
 HELPER_DECLARE    (tcp_pump_server)
 HELPER_DECLARE    (pipe_pump_server)
@@ -97,7 +119,41 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (gethostbyname)
   BENCHMARK_HELPER (gethostbyname, dns_server)
 
+  BENCHMARK_ENTRY  (gethostbyname_slow_server)
+  BENCHMARK_HELPER (gethostbyname_slow_server, dns_server)
+
+  BENCHMARK_ENTRY  (resolver_ares_udp)
+  BENCHMARK_HELPER (resolver_ares_udp, dns_server)
+
+  BENCHMARK_ENTRY  (resolver_ares_tcp)
+  BENCHMARK_HELPER (resolver_ares_tcp, dns_server)
+
+  BENCHMARK_ENTRY  (resolver_threadpool)
+
   BENCHMARK_ENTRY  (getaddrinfo)
+#ifndef _WIN32
+  BENCHMARK_ENTRY  (getaddrinfo_cached)
+#endif
+
+#ifndef _WIN32
+  BENCHMARK_ENTRY  (fs_walk_readdir)
+  BENCHMARK_ENTRY  (fs_walk_1)
+  BENCHMARK_ENTRY  (fs_walk_4)
+  BENCHMARK_ENTRY  (fs_walk_stat_1)
+  BENCHMARK_ENTRY  (fs_walk_stat_4)
+#endif
 
   BENCHMARK_ENTRY  (spawn)
+
+  BENCHMARK_ENTRY  (threadpool_1us)
+  BENCHMARK_ENTRY  (threadpool_100us)
+  BENCHMARK_ENTRY  (threadpool_10ms)
+
+#ifndef _WIN32
+  BENCHMARK_ENTRY  (post_1_producer)
+  BENCHMARK_ENTRY  (post_2_producers)
+  BENCHMARK_ENTRY  (post_4_producers)
+  BENCHMARK_ENTRY  (post_8_producers)
+  BENCHMARK_ENTRY  (post_16_producers)
+#endif
 TASK_LIST_END
@@ -0,0 +1,132 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_PRODUCERS 16
+#define TOTAL_POSTS 2000000
+
+
+static uv_loop_t* loop;
+static uv_post_t* reqs;
+static int posts_per_producer;
+static int post_cb_called;
+static int total_posts;
+
+
+typedef struct {
+  uv_post_t* reqs;
+  int count;
+} producer_t;
+
+
+static void post_cb(uv_post_t* req) {
+  if (++post_cb_called == total_posts) {
+    uv_unref(loop);
+  }
+}
+
+
+static void producer(void* arg) {
+  producer_t* p = arg;
+  int i;
+
+  for (i = 0; i < p->count; i++) {
+    uv_post(loop, &p->reqs[i], post_cb);
+  }
+}
+
+
+static int post_bench(int producers) {
+  producer_t ctx[MAX_PRODUCERS];
+  uintptr_t threads[MAX_PRODUCERS];
+  uint64_t start;
+  uint64_t elapsed;
+  int i;
+
+  ASSERT(producers <= MAX_PRODUCERS);
+
+  loop = uv_default_loop();
+  posts_per_producer = TOTAL_POSTS / producers;
+  total_posts = posts_per_producer * producers;
+  post_cb_called = 0;
+
+  reqs = malloc(total_posts * sizeof(*reqs));
+  ASSERT(reqs != NULL);
+
+  uv_ref(loop);
+
+  start = uv_hrtime();
+
+  for (i = 0; i < producers; i++) {
+    ctx[i].reqs = reqs + i * posts_per_producer;
+    ctx[i].count = posts_per_producer;
+    threads[i] = uv_create_thread(producer, &ctx[i]);
+    ASSERT(threads[i] != 0);
+  }
+
+  uv_run(loop);
+
+  elapsed = uv_hrtime() - start;
+
+  for (i = 0; i < producers; i++) {
+    ASSERT(uv_wait_thread(threads[i]) == 0);
+  }
+
+  ASSERT(post_cb_called == total_posts);
+
+  LOGF("post (%d producers): %.0f msg/s\n",
+       producers,
+       (double) total_posts / ((double) elapsed / 1e9));
+
+  free(reqs);
+
+  return 0;
+}
+
+
+BENCHMARK_IMPL(post_1_producer) {
+  return post_bench(1);
+}
+
+
+BENCHMARK_IMPL(post_2_producers) {
+  return post_bench(2);
+}
+
+
+BENCHMARK_IMPL(post_4_producers) {
+  return post_bench(4);
+}
+
+
+BENCHMARK_IMPL(post_8_producers) {
+  return post_bench(8);
+}
+
+
+BENCHMARK_IMPL(post_16_producers) {
+  return post_bench(16);
+}
@@ -0,0 +1,277 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Resolver throughput: keeps CONCURRENT_QUERIES lookups of distinct names in
+ * flight until TOTAL_QUERIES have completed, then reports queries per second,
+ * the median and 99th percentile latency, and heap allocations per query.
+ *
+ * The c-ares runs talk to the dns_server helper over UDP or TCP. The system
+ * resolver behind uv_getaddrinfo() can't be pointed at that server, so the
+ * thread pool run resolves "localhost" with a different service per query,
+ * which keeps lookups from being coalesced but is answered from /etc/hosts.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+
+#define TOTAL_QUERIES       10000
+#define CONCURRENT_QUERIES  1000
+
+/* Room for every answer in flight, so that UDP replies aren't dropped. */
+#define SOCK_RCVBUF_SIZE    (1024 * 1024)
+
+
+/*
+ * Count the malloc, calloc and realloc calls made while one of these
+ * benchmarks runs, in any thread of this process, by wrapping glibc's
+ * allocator. The wrappers are linked into run-benchmarks as a whole but
+ * only count between alloc_count_start() and alloc_count_stop(); the other
+ * benchmarks just pay for a branch. Elsewhere allocations aren't reported.
+ */
+#ifdef __GLIBC__
+# define HAVE_ALLOC_COUNT 1
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nmemb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static volatile int alloc_counting;
+static volatile unsigned long allocations;
+
+void* malloc(size_t size) {
+  if (alloc_counting)
+    __sync_fetch_and_add(&allocations, 1);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t nmemb, size_t size) {
+  if (alloc_counting)
+    __sync_fetch_and_add(&allocations, 1);
+  return __libc_calloc(nmemb, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+  if (alloc_counting)
+    __sync_fetch_and_add(&allocations, 1);
+  return __libc_realloc(ptr, size);
+}
+
+
+static void alloc_count_start(void) {
+  allocations = 0;
+  __sync_synchronize();
+  alloc_counting = 1;
+}
+
+
+static unsigned long alloc_count_stop(void) {
+  alloc_counting = 0;
+  __sync_synchronize();
+  return allocations;
+}
+#endif
+
+
+typedef struct {
+  uv_getaddrinfo_t req; /* thread pool runs only */
+  int query;
+} query_slot_t;
+
+
+static uv_loop_t* loop;
+static ares_channel channel;
+
+static query_slot_t slots[CONCURRENT_QUERIES];
+static uint64_t started[TOTAL_QUERIES];
+static uint64_t latencies[TOTAL_QUERIES];
+
+static int queries_started;
+static int queries_completed;
+static int query_errors;
+
+
+static void next_query(query_slot_t* slot);
+
+
+static int compare_latency(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*) a;
+  uint64_t y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+
+static void query_done(query_slot_t* slot, int status) {
+  latencies[slot->query] = uv_hrtime() - started[slot->query];
+  queries_completed++;
+
+  if (status != 0)
+    query_errors++;
+
+  if (queries_started < TOTAL_QUERIES)
+    next_query(slot);
+}
+
+
+static void ares_cb(void* arg, int status, int timeouts,
+    struct hostent* hostent) {
+  query_done((query_slot_t*) arg, status);
+}
+
+
+static void getaddrinfo_cb(uv_getaddrinfo_t* req, int status,
+    struct addrinfo* res) {
+  query_done((query_slot_t*) req, status);
+  uv_freeaddrinfo(res);
+}
+
+
+static void next_query(query_slot_t* slot) {
+  struct addrinfo hints;
+  char name[64];
+  int r;
+
+  slot->query = queries_started++;
+  started[slot->query] = uv_hrtime();
+
+  if (channel != NULL) {
+    sprintf(name, "host-%d.bench", slot->query);
+    ares_gethostbyname(channel, name, AF_INET, ares_cb, slot);
+    return;
+  }
+
+  memset(&hints, 0, sizeof hints);
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  sprintf(name, "%d", slot->query + 1);
+  r = uv_getaddrinfo(loop, &slot->req, getaddrinfo_cb, "localhost", name,
+      &hints);
+  ASSERT(r == 0);
+}
+
+
+static int resolver_bench(const char* label) {
+  unsigned long allocs = 0;
+  uint64_t start_time;
+  uint64_t elapsed;
+  int i;
+
+  queries_started = 0;
+  queries_completed = 0;
+  query_errors = 0;
+
+#ifdef HAVE_ALLOC_COUNT
+  alloc_count_start();
+#endif
+  start_time = uv_hrtime();
+
+  for (i = 0; i < CONCURRENT_QUERIES; i++)
+    next_query(&slots[i]);
+
+  uv_run(loop);
+
+  elapsed = uv_hrtime() - start_time;
+#ifdef HAVE_ALLOC_COUNT
+  allocs = alloc_count_stop();
+#endif
+
+  ASSERT(queries_started == TOTAL_QUERIES);
+  ASSERT(queries_completed == TOTAL_QUERIES);
+
+  if (query_errors > 0)
+    LOGF("%s: %d of %d queries failed\n", label, query_errors, TOTAL_QUERIES);
+
+  qsort(latencies, TOTAL_QUERIES, sizeof latencies[0], compare_latency);
+
+  LOGF("%s: %.0f queries/s, p50 %.0f us, p99 %.0f us, ",
+       label,
+       TOTAL_QUERIES / (elapsed / 1e9),
+       latencies[TOTAL_QUERIES / 2] / 1e3,
+       latencies[TOTAL_QUERIES * 99 / 100] / 1e3);
+#ifdef HAVE_ALLOC_COUNT
+  LOGF("%.1f allocs/query\n", (double) allocs / TOTAL_QUERIES);
+#else
+  LOGF("allocs/query n/a\n");
+#endif
+
+  return 0;
+}
+
+
+static int ares_resolver_bench(const char* label, int flags) {
+  struct sockaddr_in server = uv_ip4_addr("127.0.0.1", 0);
+  struct ares_options options;
+  char lookups[] = "b";
+  int optmask;
+  int r;
+
+  r = ares_library_init(ARES_LIB_INIT_ALL);
+  ASSERT(r == ARES_SUCCESS);
+
+  loop = uv_default_loop();
+
+  memset(&options, 0, sizeof options);
+  optmask = ARES_OPT_SERVERS | ARES_OPT_UDP_PORT | ARES_OPT_TCP_PORT |
+            ARES_OPT_FLAGS | ARES_OPT_LOOKUPS | ARES_OPT_DOMAINS |
+            ARES_OPT_SOCK_RCVBUF;
+  options.servers = &server.sin_addr;
+  options.nservers = 1;
+  options.udp_port = htons(TEST_PORT_2);
+  options.tcp_port = htons(TEST_PORT_2);
+  options.flags = flags | ARES_FLAG_NOSEARCH;
+  options.lookups = lookups;
+  options.domains = NULL;
+  options.ndomains = 0;
+  options.socket_receive_buffer_size = SOCK_RCVBUF_SIZE;
+
+  r = uv_ares_init_options(loop, &channel, &options, optmask);
+  ASSERT(r == ARES_SUCCESS);
+
+  resolver_bench(label);
+
+  uv_ares_destroy(loop, channel);
+  channel = NULL;
+
+  return 0;
+}
+
+
+BENCHMARK_IMPL(resolver_ares_udp) {
+  return ares_resolver_bench("c-ares over udp", 0);
+}
+
+
+BENCHMARK_IMPL(resolver_ares_tcp) {
+  return ares_resolver_bench("c-ares over tcp", ARES_FLAG_USEVC);
+}
+
+
+BENCHMARK_IMPL(resolver_threadpool) {
+  loop = uv_default_loop();
+  channel = NULL;
+  return resolver_bench("getaddrinfo in the thread pool");
+}
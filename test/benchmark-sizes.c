@@ -27,6 +27,9 @@ BENCHMARK_IMPL(sizes) {
   LOGF("uv_shutdown_t: %u bytes\n", (unsigned int) sizeof(uv_shutdown_t));
   LOGF("uv_write_t: %u bytes\n", (unsigned int) sizeof(uv_write_t));
   LOGF("uv_connect_t: %u bytes\n", (unsigned int) sizeof(uv_connect_t));
+  LOGF("uv_connect_name_t: %u bytes\n", (unsigned int) sizeof(uv_connect_name_t));
+  LOGF("uv_fs_walk_t: %u bytes\n", (unsigned int) sizeof(uv_fs_walk_t));
+  LOGF("uv_stream_pipe_t: %u bytes\n", (unsigned int) sizeof(uv_stream_pipe_t));
   LOGF("uv_tcp_t: %u bytes\n", (unsigned int) sizeof(uv_tcp_t));
   LOGF("uv_pipe_t: %u bytes\n", (unsigned int) sizeof(uv_pipe_t));
   LOGF("uv_tty_t: %u bytes\n", (unsigned int) sizeof(uv_tty_t));
@@ -34,6 +37,7 @@ BENCHMARK_IMPL(sizes) {
   LOGF("uv_check_t: %u bytes\n", (unsigned int) sizeof(uv_check_t));
   LOGF("uv_idle_t: %u bytes\n", (unsigned int) sizeof(uv_idle_t));
   LOGF("uv_async_t: %u bytes\n", (unsigned int) sizeof(uv_async_t));
+  LOGF("uv_post_t: %u bytes\n", (unsigned int) sizeof(uv_post_t));
   LOGF("uv_timer_t: %u bytes\n", (unsigned int) sizeof(uv_timer_t));
   LOGF("uv_process_t: %u bytes\n", (unsigned int) sizeof(uv_process_t));
   return 0;
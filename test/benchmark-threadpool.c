@@ -0,0 +1,130 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Number of requests kept in flight. */
+#define CONCURRENT_WORK 64
+
+
+static uv_loop_t* loop;
+static uv_work_t reqs[CONCURRENT_WORK];
+static uint64_t submit_time[CONCURRENT_WORK];
+static uint64_t* latencies;
+static uint64_t job_ns;
+static int total_jobs;
+static int jobs_submitted;
+static int jobs_completed;
+
+
+static void submit(uv_work_t* req);
+
+
+/* Spin instead of sleeping so the job actually occupies a worker. */
+static void work_cb(uv_work_t* req) {
+  uint64_t deadline = uv_hrtime() + job_ns;
+  while (uv_hrtime() < deadline);
+}
+
+
+static void after_work_cb(uv_work_t* req) {
+  latencies[jobs_completed++] = uv_hrtime() - submit_time[req - reqs];
+
+  if (jobs_submitted < total_jobs) {
+    submit(req);
+  }
+}
+
+
+static void submit(uv_work_t* req) {
+  int r;
+
+  submit_time[req - reqs] = uv_hrtime();
+  r = uv_queue_work(loop, req, work_cb, after_work_cb);
+  ASSERT(r == 0);
+  jobs_submitted++;
+}
+
+
+static int compare_latency(const void* a, const void* b) {
+  uint64_t x = *(const uint64_t*) a;
+  uint64_t y = *(const uint64_t*) b;
+  return x < y ? -1 : x > y;
+}
+
+
+static int threadpool_bench(const char* name, uint64_t ns, int jobs) {
+  uint64_t start;
+  uint64_t elapsed;
+  int i;
+
+  loop = uv_default_loop();
+  job_ns = ns;
+  total_jobs = jobs;
+  jobs_submitted = 0;
+  jobs_completed = 0;
+
+  latencies = malloc(jobs * sizeof(latencies[0]));
+  ASSERT(latencies != NULL);
+
+  start = uv_hrtime();
+
+  for (i = 0; i < CONCURRENT_WORK && i < jobs; i++) {
+    submit(&reqs[i]);
+  }
+
+  uv_run(loop);
+
+  elapsed = uv_hrtime() - start;
+
+  ASSERT(jobs_completed == total_jobs);
+
+  qsort(latencies, jobs, sizeof(latencies[0]), compare_latency);
+
+  LOGF("threadpool_%s: %.0f jobs/s, latency p50 %.1f us, p99 %.1f us\n",
+       name,
+       (double) jobs / ((double) elapsed / 1e9),
+       (double) latencies[jobs / 2] / 1e3,
+       (double) latencies[jobs * 99 / 100] / 1e3);
+
+  free(latencies);
+
+  return 0;
+}
+
+
+BENCHMARK_IMPL(threadpool_1us) {
+  return threadpool_bench("1us", 1000, 200000);
+}
+
+
+BENCHMARK_IMPL(threadpool_100us) {
+  return threadpool_bench("100us", 100000, 20000);
+}
+
+
+BENCHMARK_IMPL(threadpool_10ms) {
+  return threadpool_bench("10ms", 10000000, 400);
+}
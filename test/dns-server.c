@@ -32,26 +32,43 @@ typedef struct {
 } write_req_t;
 
 
-/* used to track multiple DNS requests received */
 typedef struct {
-  char* prevbuf_ptr;
-  int prevbuf_pos;
-  int prevbuf_rem;
-} dnsstate;
+  uv_udp_send_t req;
+  uv_buf_t buf;
+} udp_send_req_t;
 
 
-/* modify handle to append dnsstate */
+/* modify handle to append the bytes of a partially received request */
 typedef struct {
   uv_tcp_t handle;
-  dnsstate state;
+  char* pending;
+  size_t pending_len;
+  size_t pending_size;
+  int delay; /* ms to hold back each reply */
 } dnshandle;
 
 
+/* a reply held back by the slow server */
+typedef struct {
+  uv_timer_t timer;
+  uv_stream_t* handle;
+  write_req_t* wr;
+} delayed_write_t;
+
+
 static uv_loop_t* loop;
 
 
 static int server_closed;
 static uv_tcp_t server;
+static uv_udp_t udp_server;
+
+/*
+ * A second instance on another loopback address answers just as the first
+ * but SLOW_SERVER_DELAY ms late, for benchmarking nameserver selection.
+ */
+#define SLOW_SERVER_DELAY 10
+static uv_tcp_t slow_server;
 
 
 static void after_write(uv_write_t* req, int status);
@@ -61,12 +78,14 @@ static void on_server_close(uv_handle_t* handle);
 static void on_connection(uv_stream_t*, int status);
 
 #define WRITE_BUF_LEN   (64*1024)
-#define DNSREC_LEN      (4)
+#define DNSHDR_LEN      (12)
+#define DNSMSG_MAX      (512)
+#define UDP_RCVBUF_SIZE (1024*1024)
 
-#define LEN_OFFSET 0
-#define QUERYID_OFFSET 2
-unsigned char DNSRsp[] = {0, 43, 0, 0, 0x81, 0x80, 0, 1, 0, 1, 0, 0, 0, 0 };
-unsigned char qrecord[] = {5, 'e', 'c', 'h', 'o', 's', 3, 's', 'r', 'v', 0, 0, 1, 0, 1};
+/*
+ * Every question is answered with a single A record for 10.0.1.1. The answer
+ * points back at the question name, so any name resolves.
+ */
 unsigned char arecord[] = {0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 5, 0xbd, 0, 4, 10, 0, 1, 1 };
 
 
@@ -93,131 +112,174 @@ static void after_shutdown(uv_shutdown_t* req, int status) {
 }
 
 
-static void addrsp(write_req_t* wr, char* hdr) {
-  char * dnsrsp;
-  short int rsplen;
-  short int* reclen;
+/*
+ * Build the answer to the DNS message `req` into `rsp`, which must have room
+ * for DNSMSG_MAX bytes. Returns the length of the answer, or 0 if the request
+ * is not a query we can answer.
+ */
+static int build_answer(const char* req, int reqlen, char* rsp) {
+  int qlen;
+
+  if (reqlen < DNSHDR_LEN || (req[2] & 0x80))
+    return 0;
+
+  /* skip the question name, then its type and class */
+  qlen = DNSHDR_LEN;
+  while (qlen < reqlen && req[qlen] != 0) {
+    if ((req[qlen] & 0xc0) != 0)
+      return 0;
+    qlen += 1 + (unsigned char) req[qlen];
+  }
+  qlen += 1 + 4;
 
-  rsplen = sizeof(DNSRsp) + sizeof(qrecord) + sizeof(arecord);
+  if (qlen > reqlen || qlen + (int) sizeof(arecord) > DNSMSG_MAX)
+    return 0;
 
-  ASSERT (rsplen + wr->buf.len < WRITE_BUF_LEN);
+  /* echo id and question, then append the answer */
+  memcpy(rsp, req, qlen);
+  rsp[2] = (char) 0x81;
+  rsp[3] = (char) 0x80;
+  rsp[4] = 0; rsp[5] = 1;   /* qdcount */
+  rsp[6] = 0; rsp[7] = 1;   /* ancount */
+  memset(rsp + 8, 0, 4);    /* nscount, arcount */
+  memcpy(rsp + qlen, arecord, sizeof(arecord));
 
-  dnsrsp = wr->buf.base + wr->buf.len;
+  return qlen + sizeof(arecord);
+}
 
-  /* copy stock response */
-  memcpy(dnsrsp, DNSRsp, sizeof(DNSRsp));
-  memcpy(dnsrsp + sizeof(DNSRsp), qrecord, sizeof(qrecord));
-  memcpy(dnsrsp + sizeof(DNSRsp) + sizeof(qrecord), arecord, sizeof(arecord));
 
-  /* overwrite with network order length and id from request header */
-  reclen = (short int*)dnsrsp;
-  *reclen = htons(rsplen-2);
-  dnsrsp[QUERYID_OFFSET] = hdr[QUERYID_OFFSET];
-  dnsrsp[QUERYID_OFFSET+1] = hdr[QUERYID_OFFSET+1];
+static void on_delay_close(uv_handle_t* handle) {
+  free(handle);
+}
 
-  wr->buf.len += rsplen;
+
+static void on_delay(uv_timer_t* timer, int status) {
+  delayed_write_t* dw = (delayed_write_t*) timer;
+
+  if (uv_write((uv_write_t*) &dw->wr->req, dw->handle, &dw->wr->buf, 1,
+               after_write)) {
+    FATAL("uv_write failed");
+  }
+
+  uv_close((uv_handle_t*) timer, on_delay_close);
 }
 
-static void process_req(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
+
+static void delay_write(uv_stream_t* handle, write_req_t* wr, int delay) {
+  delayed_write_t* dw;
+
+  dw = (delayed_write_t*) malloc(sizeof *dw);
+  ASSERT(dw != NULL);
+
+  dw->handle = handle;
+  dw->wr = wr;
+
+  uv_timer_init(loop, &dw->timer);
+  uv_timer_start(&dw->timer, on_delay, delay, 0);
+}
+
+
+static void append_pending(dnshandle* dns, const char* data, size_t len) {
+  if (dns->pending_len + len > dns->pending_size) {
+    if (dns->pending_size == 0)
+      dns->pending_size = DNSMSG_MAX;
+    while (dns->pending_len + len > dns->pending_size)
+      dns->pending_size *= 2;
+    dns->pending = (char*) realloc(dns->pending, dns->pending_size);
+    ASSERT(dns->pending != NULL);
+  }
+
+  memcpy(dns->pending + dns->pending_len, data, len);
+  dns->pending_len += len;
+}
+
+
+static write_req_t* new_write_req(void) {
   write_req_t* wr;
-  dnshandle* dns = (dnshandle*)handle;
-  char hdrbuf[DNSREC_LEN];
-  int hdrbuf_remaining = DNSREC_LEN;
-  int rec_remaining = 0;
-  int readbuf_remaining;
-  char* dnsreq;
-  char* hdrstart;
-  int usingprev = 0;
 
   wr = (write_req_t*) malloc(sizeof *wr);
-  wr->buf.base = (char*)malloc(WRITE_BUF_LEN);
+  ASSERT(wr != NULL);
+  wr->buf.base = (char*) malloc(WRITE_BUF_LEN);
+  ASSERT(wr->buf.base != NULL);
   wr->buf.len = 0;
 
-  if (dns->state.prevbuf_ptr != NULL) {
-    dnsreq = dns->state.prevbuf_ptr + dns->state.prevbuf_pos;
-    readbuf_remaining = dns->state.prevbuf_rem;
-    usingprev = 1;
+  return wr;
+}
+
+
+static void send_write_req(dnshandle* dns, write_req_t* wr) {
+  if (dns->delay) {
+    delay_write((uv_stream_t*) dns, wr, dns->delay);
+  } else if (uv_write((uv_write_t*) &wr->req, (uv_stream_t*) dns, &wr->buf, 1,
+                      after_write)) {
+    FATAL("uv_write failed");
+  }
+}
+
+
+/* Answer every complete length-prefixed request received so far. */
+static void process_req(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
+  dnshandle* dns = (dnshandle*)handle;
+  write_req_t* wr;
+  const char* data;
+  char* rsp;
+  size_t len;
+  size_t pos;
+  int msglen;
+  int rsplen;
+
+  if (dns->pending_len > 0) {
+    append_pending(dns, buf.base, nread);
+    data = dns->pending;
+    len = dns->pending_len;
   } else {
-    dnsreq = buf.base;
-    readbuf_remaining = nread;
+    data = buf.base;
+    len = nread;
   }
-  hdrstart = dnsreq;
-
-  while (dnsreq != NULL) {
-    /* something to process */
-    while (readbuf_remaining > 0) {
-      /* something to process in current buffer */
-      if (hdrbuf_remaining > 0) {
-        /* process len and id */
-        if (readbuf_remaining < hdrbuf_remaining) {
-          /* too little to get request header. save for next buffer */
-          memcpy(&hdrbuf[DNSREC_LEN - hdrbuf_remaining], dnsreq, readbuf_remaining);
-          hdrbuf_remaining = DNSREC_LEN - readbuf_remaining;
-          break;
-        } else {
-          short int reclen_n;
-          /* save header */
-          memcpy(&hdrbuf[DNSREC_LEN - hdrbuf_remaining], dnsreq, hdrbuf_remaining);
-          dnsreq += hdrbuf_remaining;
-          readbuf_remaining -= hdrbuf_remaining;
-          hdrbuf_remaining = 0;
-
-          /* get record length */
-          reclen_n = *((short int*)hdrbuf);
-          rec_remaining = ntohs(reclen_n) - (DNSREC_LEN - 2);
-        }
-      }
-
-      if (rec_remaining <= readbuf_remaining) {
-        /* prepare reply */
-        addrsp(wr, hdrbuf);
-
-        /* move to next record */
-        dnsreq += rec_remaining;
-        hdrstart = dnsreq;
-        readbuf_remaining -= rec_remaining;
-        rec_remaining = 0;
-        hdrbuf_remaining = DNSREC_LEN;
-      } else {
-        /* otherwise this buffer is done. */
-        rec_remaining -= readbuf_remaining;
-        break;
-      }
+
+  wr = new_write_req();
+
+  pos = 0;
+  while (len - pos >= 2) {
+    msglen = ((unsigned char) data[pos] << 8) | (unsigned char) data[pos + 1];
+    if (len - pos < (size_t) msglen + 2)
+      break;
+
+    if (wr->buf.len + 2 + DNSMSG_MAX > WRITE_BUF_LEN) {
+      send_write_req(dns, wr);
+      wr = new_write_req();
     }
 
-    /* if we had to use bytes from prev buffer, start processing the current one */
-    if (usingprev == 1) {
-      /* free previous buffer */
-      free(dns->state.prevbuf_ptr);
-      dnsreq = buf.base;
-      readbuf_remaining = nread;
-      usingprev = 0;
-    } else {
-      dnsreq = NULL;
+    rsp = wr->buf.base + wr->buf.len;
+    rsplen = build_answer(data + pos + 2, msglen, rsp + 2);
+    if (rsplen > 0) {
+      rsp[0] = (char) (rsplen >> 8);
+      rsp[1] = (char) (rsplen & 0xff);
+      wr->buf.len += 2 + rsplen;
     }
+
+    pos += 2 + msglen;
   }
 
-  /* send write buffer */
-  if (wr->buf.len > 0) {
-    if (uv_write((uv_write_t*) &wr->req, handle, &wr->buf, 1, after_write)) {
-      FATAL("uv_write failed");
-    }
+  /* keep whatever is left for the next read */
+  if (data == dns->pending) {
+    memmove(dns->pending, dns->pending + pos, len - pos);
+    dns->pending_len = len - pos;
+  } else if (pos < len) {
+    append_pending(dns, data + pos, len - pos);
   }
 
-  if (readbuf_remaining > 0) {
-    /* save start of record position, so we can continue on next read */
-    dns->state.prevbuf_ptr = buf.base;
-    dns->state.prevbuf_pos = hdrstart - buf.base;
-    dns->state.prevbuf_rem = nread - dns->state.prevbuf_pos;
+  free(buf.base);
+
+  if (wr->buf.len > 0) {
+    send_write_req(dns, wr);
   } else {
-    /* nothing left in this buffer */
-    dns->state.prevbuf_ptr = NULL;
-    dns->state.prevbuf_pos = 0;
-    dns->state.prevbuf_rem = 0;
-    free(buf.base);
+    free(wr->buf.base);
+    free(wr);
   }
 }
 
+
 static void after_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
   uv_shutdown_t* req;
 
@@ -246,6 +308,7 @@ static void after_read(uv_stream_t* handle, ssize_t nread, uv_buf_t buf) {
 
 
 static void on_close(uv_handle_t* peer) {
+  free(((dnshandle*) peer)->pending);
   free(peer);
 }
 
@@ -268,9 +331,11 @@ static void on_connection(uv_stream_t* server, int status) {
   ASSERT(handle != NULL);
 
   /* initialize read buffer state */
-  handle->state.prevbuf_ptr = 0;
-  handle->state.prevbuf_pos = 0;
-  handle->state.prevbuf_rem = 0;
+  handle->pending = NULL;
+  handle->pending_len = 0;
+  handle->pending_size = 0;
+
+  handle->delay = (server == (uv_stream_t*)&slow_server) ? SLOW_SERVER_DELAY : 0;
 
   r = uv_tcp_init(loop, (uv_tcp_t*)handle);
   ASSERT(r == 0);
@@ -283,30 +348,72 @@ static void on_connection(uv_stream_t* server, int status) {
 }
 
 
+static void after_udp_send(uv_udp_send_t* req, int status) {
+  udp_send_req_t* sr = (udp_send_req_t*) req;
+
+  ASSERT(status == 0);
+
+  free(sr->buf.base);
+  free(sr);
+}
+
+
+static void on_udp_recv(uv_udp_t* handle, ssize_t nread, uv_buf_t buf,
+    struct sockaddr* addr, unsigned flags) {
+  udp_send_req_t* sr;
+  int rsplen;
+
+  if (nread <= 0 || addr == NULL || addr->sa_family != AF_INET) {
+    free(buf.base);
+    return;
+  }
+
+  sr = (udp_send_req_t*) malloc(sizeof *sr);
+  ASSERT(sr != NULL);
+  sr->buf.base = (char*) malloc(DNSMSG_MAX);
+  ASSERT(sr->buf.base != NULL);
+
+  rsplen = build_answer(buf.base, nread, sr->buf.base);
+  free(buf.base);
+
+  if (rsplen == 0) {
+    free(sr->buf.base);
+    free(sr);
+    return;
+  }
+
+  sr->buf.len = rsplen;
+  if (uv_udp_send(&sr->req, handle, &sr->buf, 1,
+                  *(struct sockaddr_in*) addr, after_udp_send)) {
+    FATAL("uv_udp_send failed");
+  }
+}
+
+
 static void on_server_close(uv_handle_t* handle) {
   ASSERT(handle == (uv_handle_t*)&server);
 }
 
 
-static int dns_start(int port) {
-  struct sockaddr_in addr = uv_ip4_addr("0.0.0.0", port);
+static int dns_start(uv_tcp_t* server, const char* ip, int port) {
+  struct sockaddr_in addr = uv_ip4_addr(ip, port);
   int r;
 
-  r = uv_tcp_init(loop, &server);
+  r = uv_tcp_init(loop, server);
   if (r) {
     /* TODO: Error codes */
     fprintf(stderr, "Socket creation error\n");
     return 1;
   }
 
-  r = uv_tcp_bind(&server, addr);
+  r = uv_tcp_bind(server, addr);
   if (r) {
     /* TODO: Error codes */
     fprintf(stderr, "Bind error\n");
     return 1;
   }
 
-  r = uv_listen((uv_stream_t*)&server, 128, on_connection);
+  r = uv_listen((uv_stream_t*)server, 128, on_connection);
   if (r) {
     /* TODO: Error codes */
     fprintf(stderr, "Listen error\n");
@@ -317,12 +424,48 @@ static int dns_start(int port) {
 }
 
 
+static int dns_start_udp(uv_udp_t* server, const char* ip, int port) {
+  struct sockaddr_in addr = uv_ip4_addr(ip, port);
+#ifndef _WIN32
+  int rcvbuf = UDP_RCVBUF_SIZE;
+#endif
+
+  if (uv_udp_init(loop, server)) {
+    fprintf(stderr, "Socket creation error\n");
+    return 1;
+  }
+
+  if (uv_udp_bind(server, addr, 0)) {
+    fprintf(stderr, "Bind error\n");
+    return 1;
+  }
+
+#ifndef _WIN32
+  /* Don't drop queries when a benchmark sends thousands at once. */
+  setsockopt(server->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof rcvbuf);
+#endif
+
+  if (uv_udp_recv_start(server, buf_alloc, on_udp_recv)) {
+    fprintf(stderr, "Receive error\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+
 HELPER_IMPL(dns_server) {
   loop = uv_default_loop();
 
-  if (dns_start(TEST_PORT_2))
+  if (dns_start(&server, "127.0.0.1", TEST_PORT_2))
     return 1;
 
+  if (dns_start_udp(&udp_server, "127.0.0.1", TEST_PORT_2))
+    return 1;
+
+  if (dns_start(&slow_server, "127.0.0.2", TEST_PORT_2))
+    fprintf(stderr, "Slow server not started, is 127.0.0.2 configured?\n");
+
   uv_run(loop);
   return 0;
 }
@@ -1408,3 +1408,1022 @@ TEST_IMPL(fs_open_dir) {
 
   return 0;
 }
+
+
+static int readv_cb_count;
+static int writev_cb_count;
+
+
+static void writev_cb(uv_fs_t* req) {
+  ASSERT(req == &write_req);
+  ASSERT(req->fs_type == UV_FS_WRITEV);
+  ASSERT(req->result == 12);
+  writev_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void readv_cb(uv_fs_t* req) {
+  ASSERT(req == &read_req);
+  ASSERT(req->fs_type == UV_FS_READV);
+  ASSERT(req->result == 24);
+  readv_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_readv_writev) {
+  char parts[6][5];
+  char out[24];
+  uv_buf_t bufs[6];
+  uv_file file;
+  int i;
+  int r;
+
+  /* Setup. */
+  unlink("test_file");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_open(loop, &open_req1, "test_file", O_RDWR | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  file = open_req1.result;
+  uv_fs_req_cleanup(&open_req1);
+
+  /* "test-buffer\n" in three pieces, one of them empty. */
+  bufs[0] = uv_buf_init(test_buf, 5);
+  bufs[1] = uv_buf_init(test_buf + 5, 0);
+  bufs[2] = uv_buf_init(test_buf + 5, 7);
+
+  r = uv_fs_writev(loop, &write_req, file, bufs, 3, 0, NULL);
+  ASSERT(r == 12);
+  ASSERT(write_req.result == 12);
+  uv_fs_req_cleanup(&write_req);
+
+  /* A second copy right after it, with more buffers than fit inline. */
+  for (i = 0; i < 6; i++) {
+    bufs[i] = uv_buf_init(test_buf + 2 * i, 2);
+  }
+
+  r = uv_fs_writev(loop, &write_req, file, bufs, 6, 12, writev_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(writev_cb_count == 1);
+
+  memset(parts, 0, sizeof(parts));
+  for (i = 0; i < 6; i++) {
+    bufs[i] = uv_buf_init(parts[i], 4);
+  }
+
+  r = uv_fs_readv(loop, &read_req, file, bufs, 6, 0, readv_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(readv_cb_count == 1);
+
+  for (i = 0; i < 6; i++) {
+    memcpy(out + 4 * i, parts[i], 4);
+  }
+  ASSERT(memcmp(out, test_buf, 12) == 0);
+  ASSERT(memcmp(out + 12, test_buf, 12) == 0);
+
+  /* A short read at the end of the file. */
+  memset(parts, 0, sizeof(parts));
+  bufs[0] = uv_buf_init(parts[0], 4);
+  bufs[1] = uv_buf_init(parts[1], 4);
+
+  r = uv_fs_readv(loop, &read_req, file, bufs, 2, 19, NULL);
+  ASSERT(r == 5);
+  ASSERT(memcmp(parts[0], "ffer", 4) == 0);
+  ASSERT(parts[1][0] == '\n');
+  uv_fs_req_cleanup(&read_req);
+
+  /* The positional calls above left the file position at 0. */
+  bufs[0] = uv_buf_init(parts[0], 5);
+
+  r = uv_fs_readv(loop, &read_req, file, bufs, 1, -1, NULL);
+  ASSERT(r == 5);
+  ASSERT(memcmp(parts[0], "test-", 5) == 0);
+  uv_fs_req_cleanup(&read_req);
+
+  r = uv_fs_close(loop, &close_req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&close_req);
+
+  /* Cleanup */
+  unlink("test_file");
+
+  return 0;
+}
+
+
+
+static int readdir_flags;
+
+
+static void check_dirents(uv_fs_t* req) {
+  uv_dirent_t* ents;
+  int seen;
+  int i;
+
+  ASSERT(req->fs_type == UV_FS_READDIR);
+  ASSERT(req->result == 3);
+  ASSERT(req->ptr != NULL);
+
+  ents = req->ptr;
+  seen = 0;
+
+  for (i = 0; i < req->result; i++) {
+    if (strcmp(ents[i].name, "file") == 0) {
+      ASSERT(ents[i].type == UV_DIRENT_FILE);
+      seen |= 1;
+    } else if (strcmp(ents[i].name, "subdir") == 0) {
+      ASSERT(ents[i].type == UV_DIRENT_DIR);
+      seen |= 2;
+    } else if (strcmp(ents[i].name, "link") == 0) {
+      ASSERT(ents[i].type == UV_DIRENT_LINK);
+      seen |= 4;
+    } else {
+      ASSERT(0 && "unexpected entry");
+    }
+
+    if (i > 0 && (readdir_flags & UV_FS_READDIR_STAT_ORDER)) {
+      ASSERT(ents[i - 1].ino <= ents[i].ino);
+    }
+  }
+
+  ASSERT(seen == 7);
+}
+
+
+static void readdir_types_cb(uv_fs_t* req) {
+  ASSERT(req == &readdir_req);
+  check_dirents(req);
+  readdir_cb_count++;
+  uv_fs_req_cleanup(req);
+  ASSERT(!req->ptr);
+}
+
+
+TEST_IMPL(fs_readdir_types) {
+  uv_fs_t req;
+  int r;
+
+  /* Setup */
+  unlink("test_dir/file");
+  unlink("test_dir/link");
+  rmdir("test_dir/subdir");
+  rmdir("test_dir");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_mkdir(loop, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_mkdir(loop, &req, "test_dir/subdir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_open(loop, &req, "test_dir/file", O_WRONLY | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  uv_fs_req_cleanup(&req);
+  close(r);
+
+  r = uv_fs_symlink(loop, &req, "file", "test_dir/link", 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* sync */
+  readdir_flags = UV_FS_READDIR_TYPES;
+  r = uv_fs_readdir(loop, &readdir_req, "test_dir", readdir_flags, NULL);
+  ASSERT(r == 3);
+  check_dirents(&readdir_req);
+  uv_fs_req_cleanup(&readdir_req);
+
+  readdir_flags = UV_FS_READDIR_STAT_ORDER;
+  r = uv_fs_readdir(loop, &readdir_req, "test_dir", readdir_flags, NULL);
+  ASSERT(r == 3);
+  check_dirents(&readdir_req);
+  uv_fs_req_cleanup(&readdir_req);
+
+  /* async */
+  readdir_flags = UV_FS_READDIR_TYPES;
+  r = uv_fs_readdir(loop, &readdir_req, "test_dir", readdir_flags,
+      readdir_types_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(readdir_cb_count == 1);
+
+  readdir_flags = UV_FS_READDIR_STAT_ORDER;
+  r = uv_fs_readdir(loop, &readdir_req, "test_dir", readdir_flags,
+      readdir_types_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(readdir_cb_count == 2);
+
+  /* An empty directory lists nothing either way. */
+  r = uv_fs_readdir(loop, &readdir_req, "test_dir/subdir",
+      UV_FS_READDIR_TYPES, NULL);
+  ASSERT(r == 0);
+  ASSERT(readdir_req.ptr == NULL);
+  uv_fs_req_cleanup(&readdir_req);
+
+  /* Cleanup */
+  unlink("test_dir/file");
+  unlink("test_dir/link");
+  rmdir("test_dir/subdir");
+  rmdir("test_dir");
+
+  return 0;
+}
+
+
+#define CHUNK_FILES 10
+#define CHUNK_SIZE  4
+
+static uv_dirent_t chunk_dirents[CHUNK_SIZE];
+static int chunk_seen[CHUNK_FILES];
+static int chunk_total;
+static int opendir_cb_count;
+static int readdir_chunk_cb_count;
+static int closedir_cb_count;
+
+
+static void chunk_path(char* path, int i) {
+  strcpy(path, "test_dir/file_");
+  path[14] = '0' + i;
+  path[15] = '\0';
+}
+
+
+static void check_chunk(uv_dir_t* dir, int n) {
+  int i;
+
+  ASSERT(n == (chunk_total + CHUNK_SIZE <= CHUNK_FILES ?
+      CHUNK_SIZE : CHUNK_FILES - chunk_total));
+
+  for (i = 0; i < n; i++) {
+    ASSERT(strncmp(dir->dirents[i].name, "file_", 5) == 0);
+    ASSERT(strlen(dir->dirents[i].name) == 6);
+#if UNIX
+    ASSERT(dir->dirents[i].type == UV_DIRENT_FILE ||
+           dir->dirents[i].type == UV_DIRENT_UNKNOWN);
+#endif
+    chunk_seen[dir->dirents[i].name[5] - '0']++;
+  }
+
+  chunk_total += n;
+}
+
+
+static void closedir_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_CLOSEDIR);
+  ASSERT(req->result == 0);
+  closedir_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void readdir_chunk_cb(uv_fs_t* req) {
+  uv_dir_t* dir = req->ptr;
+  int r;
+
+  ASSERT(req->fs_type == UV_FS_READDIR_CHUNK);
+  ASSERT(req->result >= 0);
+  readdir_chunk_cb_count++;
+  uv_fs_req_cleanup(req);
+
+  if (req->result == 0) {
+    r = uv_fs_closedir(loop, req, dir, closedir_cb);
+    ASSERT(r == 0);
+    return;
+  }
+
+  check_chunk(dir, req->result);
+  r = uv_fs_readdir_chunk(loop, req, dir, readdir_chunk_cb);
+  ASSERT(r == 0);
+}
+
+
+static void opendir_cb(uv_fs_t* req) {
+  uv_dir_t* dir = req->ptr;
+  int r;
+
+  ASSERT(req->fs_type == UV_FS_OPENDIR);
+  ASSERT(req->result == 0);
+  ASSERT(dir != NULL);
+  opendir_cb_count++;
+  uv_fs_req_cleanup(req);
+
+  dir->dirents = chunk_dirents;
+  dir->nentries = CHUNK_SIZE;
+  r = uv_fs_readdir_chunk(loop, req, dir, readdir_chunk_cb);
+  ASSERT(r == 0);
+}
+
+
+TEST_IMPL(fs_opendir_chunks) {
+  char path[32];
+  uv_dir_t* dir;
+  uv_fs_t req;
+  int r;
+  int i;
+
+  /* Setup */
+  for (i = 0; i < CHUNK_FILES; i++) {
+    chunk_path(path, i);
+    unlink(path);
+  }
+  rmdir("test_dir");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_mkdir(loop, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  for (i = 0; i < CHUNK_FILES; i++) {
+    chunk_path(path, i);
+    r = uv_fs_open(loop, &req, path, O_WRONLY | O_CREAT,
+        S_IWRITE | S_IREAD, NULL);
+    ASSERT(r != -1);
+    uv_fs_req_cleanup(&req);
+    close(r);
+  }
+
+  /* sync */
+  r = uv_fs_opendir(loop, &req, "test_dir", NULL);
+  ASSERT(r == 0);
+  dir = req.ptr;
+  ASSERT(dir != NULL);
+  uv_fs_req_cleanup(&req);
+
+  dir->dirents = chunk_dirents;
+  dir->nentries = CHUNK_SIZE;
+
+  while ((r = uv_fs_readdir_chunk(loop, &req, dir, NULL)) > 0) {
+    check_chunk(dir, r);
+    uv_fs_req_cleanup(&req);
+  }
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_closedir(loop, &req, dir, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  ASSERT(chunk_total == CHUNK_FILES);
+  for (i = 0; i < CHUNK_FILES; i++) {
+    ASSERT(chunk_seen[i] == 1);
+  }
+
+  /* async */
+  chunk_total = 0;
+  memset(chunk_seen, 0, sizeof(chunk_seen));
+
+  r = uv_fs_opendir(loop, &req, "test_dir", opendir_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+
+  ASSERT(opendir_cb_count == 1);
+  ASSERT(readdir_chunk_cb_count == 4);
+  ASSERT(closedir_cb_count == 1);
+  ASSERT(chunk_total == CHUNK_FILES);
+  for (i = 0; i < CHUNK_FILES; i++) {
+    ASSERT(chunk_seen[i] == 1);
+  }
+
+  /* Errors */
+  r = uv_fs_opendir(loop, &req, "test_dir/nonexistent", NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_ENOENT);
+  ASSERT(req.ptr == NULL);
+  uv_fs_req_cleanup(&req);
+
+  /* Cleanup */
+  for (i = 0; i < CHUNK_FILES; i++) {
+    chunk_path(path, i);
+    unlink(path);
+  }
+  rmdir("test_dir");
+
+  return 0;
+}
+
+
+static int walk_cb_count;
+static int walk_entries_cb_count;
+static int walk_entries;
+static int walk_seen_c;
+static int walk_seen_link;
+static int walk_status;
+
+
+static void walk_entries_cb(uv_fs_walk_t* req, const char* dir,
+    const uv_dirent_t* dirents, const uv_statbuf_t* stats, int n) {
+  int i;
+
+  ASSERT(n > 0 && (stats == NULL || n <= 2));
+  ASSERT(strncmp(dir, "test_dir", 8) == 0);
+  walk_entries_cb_count++;
+  walk_entries += n;
+
+  for (i = 0; i < n; i++) {
+    ASSERT(dirents[i].type != UV_DIRENT_UNKNOWN);
+
+    if (strcmp(dirents[i].name, "c") == 0) {
+      ASSERT(strcmp(dir, "test_dir/sub/deep") == 0);
+      ASSERT(dirents[i].type == UV_DIRENT_FILE);
+      walk_seen_c++;
+    }
+
+    if (strcmp(dirents[i].name, "link") == 0) {
+      ASSERT(dirents[i].type == UV_DIRENT_LINK);
+      walk_seen_link++;
+    }
+
+    if (stats) {
+      ASSERT(stats[i].st_ino == dirents[i].ino);
+      if (dirents[i].type == UV_DIRENT_LINK) {
+        ASSERT(S_ISLNK(stats[i].st_mode));
+      }
+    }
+  }
+}
+
+
+static void walk_cb(uv_fs_walk_t* req, int status) {
+  walk_cb_count++;
+  walk_status = status;
+}
+
+
+static void walk_cleanup(void) {
+  unlink("test_dir/a");
+  unlink("test_dir/link");
+  unlink("test_dir/sub/b");
+  unlink("test_dir/sub/deep/c");
+  rmdir("test_dir/sub/deep");
+  rmdir("test_dir/sub");
+  rmdir("test_dir/empty");
+  rmdir("test_dir");
+}
+
+
+static void walk_touch(const char* path) {
+  uv_fs_t req;
+  int r;
+
+  r = uv_fs_open(loop, &req, path, O_WRONLY | O_CREAT, S_IWRITE | S_IREAD,
+      NULL);
+  ASSERT(r != -1);
+  uv_fs_req_cleanup(&req);
+  close(r);
+}
+
+
+TEST_IMPL(fs_walk) {
+  uv_fs_walk_options_t options;
+  uv_fs_walk_t walk_req;
+  uv_fs_t req;
+  int r;
+
+  /* Setup */
+  walk_cleanup();
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_fs_mkdir(loop, &req, "test_dir", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_mkdir(loop, &req, "test_dir/sub", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_mkdir(loop, &req, "test_dir/sub/deep", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_mkdir(loop, &req, "test_dir/empty", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_symlink(loop, &req, "sub", "test_dir/link", 0, NULL));
+  uv_fs_req_cleanup(&req);
+  walk_touch("test_dir/a");
+  walk_touch("test_dir/sub/b");
+  walk_touch("test_dir/sub/deep/c");
+
+  /* Small batches, the symlink to sub must not be followed. */
+  options.flags = UV_FS_WALK_STAT;
+  options.concurrency = 2;
+  options.batch = 2;
+
+  r = uv_fs_walk(loop, &walk_req, "test_dir", &options, walk_entries_cb,
+      walk_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+
+  ASSERT(walk_cb_count == 1);
+  ASSERT(walk_status == 0);
+  ASSERT(walk_entries == 7);
+  ASSERT(walk_entries_cb_count >= 4);
+  ASSERT(walk_seen_c == 1);
+  ASSERT(walk_seen_link == 1);
+  ASSERT(walk_req.ndirs == 4);
+  ASSERT(walk_req.nentries == 7);
+  ASSERT(walk_req.nerrors == 0);
+
+  /* Defaults, no stat results. */
+  walk_entries = 0;
+  walk_entries_cb_count = 0;
+  r = uv_fs_walk(loop, &walk_req, "test_dir/", NULL, walk_entries_cb,
+      walk_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+
+  ASSERT(walk_cb_count == 2);
+  ASSERT(walk_status == 0);
+  ASSERT(walk_req.ndirs == 4);
+  ASSERT(walk_req.nentries == 7);
+  ASSERT(walk_seen_c == 2);
+
+  /* A missing root fails the walk. */
+  r = uv_fs_walk(loop, &walk_req, "test_dir/nonexistent", NULL,
+      walk_entries_cb, walk_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+
+  ASSERT(walk_cb_count == 3);
+  ASSERT(walk_status == -1);
+  ASSERT(uv_last_error(loop).code == UV_ENOENT);
+  ASSERT(walk_req.nerrors == 1);
+
+  /* Cleanup */
+  walk_cleanup();
+
+  return 0;
+}
+
+
+static int batch_cb_count;
+static int read_file_cb_count;
+
+
+static void batch_cb(uv_fs_t* req) {
+  uv_fs_op_t* ops = req->data;
+
+  ASSERT(req->fs_type == UV_FS_BATCH);
+  ASSERT(req->result == 0);
+  ASSERT(ops[1].statbuf.st_size == sizeof(test_buf));
+  ASSERT(ops[2].result == sizeof(test_buf));
+  ASSERT(strcmp(buf, test_buf) == 0);
+  ASSERT(ops[3].result == 0);
+  batch_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void read_file_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_READ_FILE);
+  ASSERT(req->result == sizeof(test_buf));
+  ASSERT(memcmp(req->ptr, test_buf, sizeof(test_buf)) == 0);
+  read_file_cb_count++;
+  uv_fs_req_cleanup(req);
+  ASSERT(req->ptr == NULL);
+}
+
+
+TEST_IMPL(fs_batch) {
+  uv_fs_op_t ops[4];
+  uv_fs_t req;
+  int r;
+
+  /* Setup */
+  unlink("test_file");
+
+  loop = uv_default_loop();
+
+  /* sync: create and fill a file in one go */
+  memset(ops, 0, sizeof(ops));
+  ops[0].type = UV_FS_OPEN;
+  ops[0].path = "test_file";
+  ops[0].flags = O_WRONLY | O_CREAT | O_TRUNC;
+  ops[0].mode = S_IWRITE | S_IREAD;
+  ops[1].type = UV_FS_WRITE;
+  ops[1].file = -1;
+  ops[1].buf = uv_buf_init(test_buf, sizeof(test_buf));
+  ops[1].offset = -1;
+  ops[2].type = UV_FS_FSTAT;
+  ops[2].file = -1;
+  ops[3].type = UV_FS_CLOSE;
+  ops[3].file = -1;
+
+  r = uv_fs_batch(loop, &req, ops, 4, NULL);
+  ASSERT(r == 0);
+  ASSERT(req.result == 0);
+  ASSERT(ops[0].result >= 0);
+  ASSERT(ops[1].result == sizeof(test_buf));
+  ASSERT(ops[2].result == 0);
+  ASSERT(ops[2].statbuf.st_size == sizeof(test_buf));
+  ASSERT(ops[3].result == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* async: open, fstat, read, close with a single callback */
+  memset(buf, 0, sizeof(buf));
+  memset(ops, 0, sizeof(ops));
+  ops[0].type = UV_FS_OPEN;
+  ops[0].path = "test_file";
+  ops[0].flags = O_RDONLY;
+  ops[1].type = UV_FS_FSTAT;
+  ops[1].file = -1;
+  ops[2].type = UV_FS_READ;
+  ops[2].file = -1;
+  ops[2].buf = uv_buf_init(buf, sizeof(buf));
+  ops[2].offset = 0;
+  ops[3].type = UV_FS_CLOSE;
+  ops[3].file = -1;
+
+  req.data = ops;
+  r = uv_fs_batch(loop, &req, ops, 4, batch_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(batch_cb_count == 1);
+
+  /* A failed open cancels the rest. */
+  ops[0].path = "test_file_nonexistent";
+  r = uv_fs_batch(loop, &req, ops, 4, NULL);
+  ASSERT(r == -1);
+  ASSERT(req.result == -1);
+  ASSERT(uv_last_error(loop).code == UV_ENOENT);
+  ASSERT(ops[0].errorno == UV_ENOENT);
+  ASSERT(ops[1].errorno == UV_ECANCELED);
+  ASSERT(ops[2].errorno == UV_ECANCELED);
+  ASSERT(ops[3].errorno == UV_ECANCELED);
+  uv_fs_req_cleanup(&req);
+
+  /* A failure after the open still closes the file. */
+  ops[0].path = "test_file";
+  ops[1].type = UV_FS_WRITE;
+  ops[1].buf = uv_buf_init(test_buf, sizeof(test_buf));
+  ops[1].offset = -1;
+  r = uv_fs_batch(loop, &req, ops, 4, NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBADF);
+  ASSERT(ops[0].result >= 0);
+  ASSERT(ops[1].errorno == UV_EBADF);
+  ASSERT(ops[2].errorno == UV_ECANCELED);
+  ASSERT(ops[3].result == 0);
+  ASSERT(close(ops[0].result) == -1);
+  uv_fs_req_cleanup(&req);
+
+  /* read_file */
+  r = uv_fs_read_file(loop, &req, "test_file", NULL);
+  ASSERT(r == sizeof(test_buf));
+  ASSERT(memcmp(req.ptr, test_buf, sizeof(test_buf)) == 0);
+  ASSERT(((char*) req.ptr)[r] == '\0');
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_read_file(loop, &req, "test_file", read_file_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(read_file_cb_count == 1);
+
+  r = uv_fs_read_file(loop, &req, "test_file_nonexistent", NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_ENOENT);
+  ASSERT(req.ptr == NULL);
+  uv_fs_req_cleanup(&req);
+
+#ifdef __linux__
+  /* Reports a size of 0 but has contents. */
+  r = uv_fs_read_file(loop, &req, "/proc/self/status", NULL);
+  ASSERT(r > 0);
+  ASSERT(strlen(req.ptr) == (size_t) r);
+  uv_fs_req_cleanup(&req);
+#endif
+
+  /* Cleanup */
+  unlink("test_file");
+
+  return 0;
+}
+
+
+static int mmap_cb_count;
+static int munmap_cb_count;
+
+
+static void munmap_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_MUNMAP);
+  ASSERT(req->result == 0);
+  munmap_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void mmap_cb(uv_fs_t* req) {
+  int r;
+
+  ASSERT(req->fs_type == UV_FS_MMAP);
+  ASSERT(req->result == sizeof(test_buf));
+  ASSERT(req->ptr != NULL);
+  ASSERT(memcmp(req->ptr, test_buf, sizeof(test_buf)) == 0);
+  mmap_cb_count++;
+
+  r = uv_fs_munmap(loop, req, req->ptr, req->result, munmap_cb);
+  ASSERT(r == 0);
+}
+
+
+TEST_IMPL(fs_mmap) {
+  uv_fs_t req;
+  uv_file file;
+  int r;
+
+  /* Setup */
+  unlink("test_file");
+  unlink("test_file_empty");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_open(loop, &req, "test_file", O_RDWR | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  file = req.result;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_write(loop, &req, file, test_buf, sizeof(test_buf), -1, NULL);
+  ASSERT(r == sizeof(test_buf));
+  uv_fs_req_cleanup(&req);
+
+  /* sync, up to the end of the file */
+  r = uv_fs_mmap(loop, &req, file, 0, 0, 0, NULL);
+  ASSERT(r == sizeof(test_buf));
+  ASSERT(memcmp(req.ptr, test_buf, sizeof(test_buf)) == 0);
+  r = uv_fs_munmap(loop, &req, req.ptr, req.result, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* sync, explicit length */
+  r = uv_fs_mmap(loop, &req, file, 4, 0, UV_FS_MMAP_WILLNEED, NULL);
+  ASSERT(r == 4);
+  ASSERT(memcmp(req.ptr, test_buf, 4) == 0);
+  r = uv_fs_munmap(loop, &req, req.ptr, 4, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* async, prefetched and locked; unmapped from the callback */
+  r = uv_fs_mmap(loop, &req, file, 0, 0,
+      UV_FS_MMAP_WILLNEED | UV_FS_MMAP_POPULATE | UV_FS_MMAP_LOCK, mmap_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(mmap_cb_count == 1);
+  ASSERT(munmap_cb_count == 1);
+
+  /* The offset must be page aligned. */
+  r = uv_fs_mmap(loop, &req, file, 4, 1, 0, NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(loop, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_mmap(loop, &req, file, 0, 0, 0, NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBADF);
+  uv_fs_req_cleanup(&req);
+
+  /* Nothing to map in an empty file. */
+  r = uv_fs_open(loop, &req, "test_file_empty", O_RDWR | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  file = req.result;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_mmap(loop, &req, file, 0, 0, UV_FS_MMAP_LOCK, NULL);
+  ASSERT(r == 0);
+  ASSERT(req.ptr == NULL);
+  r = uv_fs_munmap(loop, &req, req.ptr, req.result, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  close(file);
+
+  /* Cleanup */
+  unlink("test_file");
+  unlink("test_file_empty");
+
+  return 0;
+}
+
+
+static int fadvise_cb_count;
+static int readahead_cb_count;
+
+
+static void fadvise_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_FADVISE);
+  ASSERT(req->result == 0);
+  fadvise_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void readahead_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_READAHEAD);
+  ASSERT(req->result == 0);
+  readahead_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_fadvise) {
+  uv_fs_advice advice;
+  uv_fs_t req;
+  uv_file file;
+  int r;
+
+  /* Setup */
+  unlink("test_file");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_open(loop, &req, "test_file", O_RDWR | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  file = req.result;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_write(loop, &req, file, test_buf, sizeof(test_buf), -1, NULL);
+  ASSERT(r == sizeof(test_buf));
+  uv_fs_req_cleanup(&req);
+
+#ifdef __linux__
+  for (advice = UV_FS_ADVISE_NORMAL; advice <= UV_FS_ADVISE_NOREUSE; advice++) {
+    r = uv_fs_fadvise(loop, &req, file, 0, 0, advice, NULL);
+    ASSERT(r == 0);
+    uv_fs_req_cleanup(&req);
+  }
+
+  r = uv_fs_fadvise(loop, &req, file, 0, 0, UV_FS_ADVISE_SEQUENTIAL,
+      fadvise_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(fadvise_cb_count == 1);
+
+  advice = (uv_fs_advice) 42;
+  r = uv_fs_fadvise(loop, &req, file, 0, 0, advice, NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+#else
+  (void) advice;
+#endif
+
+  r = uv_fs_readahead(loop, &req, file, 0, sizeof(test_buf), NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_readahead(loop, &req, file, 0, sizeof(test_buf), readahead_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(readahead_cb_count == 1);
+
+  /* The data is still there after the hints. */
+  memset(buf, 0, sizeof(buf));
+  r = uv_fs_read(loop, &req, file, buf, sizeof(buf), 0, NULL);
+  ASSERT(r == sizeof(test_buf));
+  ASSERT(memcmp(buf, test_buf, sizeof(test_buf)) == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(loop, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+#ifdef __linux__
+  r = uv_fs_fadvise(loop, &req, file, 0, 0, UV_FS_ADVISE_WILLNEED, NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBADF);
+  uv_fs_req_cleanup(&req);
+#endif
+
+  r = uv_fs_readahead(loop, &req, file, 0, sizeof(test_buf), NULL);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBADF);
+  uv_fs_req_cleanup(&req);
+
+  /* Cleanup */
+  unlink("test_file");
+
+  return 0;
+}
+
+
+static uv_fs_t read_inline_req;
+static int read_inline_depth;
+static int read_inline_cb_count;
+static off_t read_inline_offset;
+static char read_inline_buf[sizeof(test_buf)];
+
+
+static void read_inline_cb(uv_fs_t* req) {
+  int r;
+
+  ASSERT(req == &read_inline_req);
+  ASSERT(req->fs_type == UV_FS_READ);
+  ASSERT(read_inline_depth == 0);
+  read_inline_cb_count++;
+
+  if (req->result == 0) {
+    /* EOF */
+    ASSERT(read_inline_offset == sizeof(test_buf));
+    uv_fs_req_cleanup(req);
+    return;
+  }
+
+  ASSERT(req->result > 0);
+  read_inline_offset += req->result;
+  uv_fs_req_cleanup(req);
+
+  /* Never called back from within uv_fs_read(), even when cached. */
+  read_inline_depth++;
+  r = uv_fs_read(loop, &read_inline_req, open_req1.result,
+      read_inline_buf + read_inline_offset, 4, read_inline_offset,
+      read_inline_cb);
+  read_inline_depth--;
+  ASSERT(r == 0);
+}
+
+
+static void read_inline_pos_cb(uv_fs_t* req) {
+  ASSERT(req->result == 4);
+  read_inline_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void read_inline_error_cb(uv_fs_t* req) {
+  ASSERT(req->result == -1);
+  ASSERT(req->errorno == UV_EBADF);
+  read_inline_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_read_inline) {
+  uint64_t offloaded;
+  uint64_t reads;
+  uv_fs_t req;
+  int r;
+
+  /* Setup */
+  unlink("test_file");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_open(loop, &open_req1, "test_file", O_RDWR | O_CREAT,
+      S_IWRITE | S_IREAD, NULL);
+  ASSERT(r != -1);
+  uv_fs_req_cleanup(&open_req1);
+
+  r = uv_fs_write(loop, &req, open_req1.result, test_buf, sizeof(test_buf),
+      0, NULL);
+  ASSERT(r == sizeof(test_buf));
+  uv_fs_req_cleanup(&req);
+
+  reads = loop->counters.fs_read_inline + loop->counters.fs_read_offloaded;
+
+  /* Read the file 4 bytes at a time, chaining from the callback. */
+  r = uv_fs_read(loop, &read_inline_req, open_req1.result, read_inline_buf,
+      4, 0, read_inline_cb);
+  ASSERT(r == 0);
+  ASSERT(read_inline_cb_count == 0);
+  uv_run(loop);
+
+  ASSERT(read_inline_cb_count == 5);
+  ASSERT(memcmp(read_inline_buf, test_buf, sizeof(test_buf)) == 0);
+  ASSERT(loop->counters.fs_read_inline + loop->counters.fs_read_offloaded ==
+      reads + 5);
+
+  /* Reads at the file position always go to the thread pool. */
+  offloaded = loop->counters.fs_read_offloaded;
+  r = uv_fs_read(loop, &read_inline_req, open_req1.result, read_inline_buf,
+      4, -1, read_inline_pos_cb);
+  ASSERT(r == 0);
+  ASSERT(loop->counters.fs_read_offloaded == offloaded + 1);
+  uv_run(loop);
+  ASSERT(read_inline_cb_count == 6);
+
+  r = uv_fs_close(loop, &req, open_req1.result, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* Errors are reported by the thread pool as before. */
+  r = uv_fs_read(loop, &read_inline_req, open_req1.result, read_inline_buf,
+      4, 0, read_inline_error_cb);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(read_inline_cb_count == 7);
+
+  /* Cleanup */
+  unlink("test_file");
+
+  return 0;
+}
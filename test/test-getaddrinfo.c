@@ -120,3 +120,263 @@ TEST_IMPL(getaddrinfo_concurrent) {
 
   return 0;
 }
+
+
+static uv_getaddrinfo_t cache_handle;
+static struct addrinfo* cache_first_res;
+static int cache_step;
+
+
+static void getaddrinfo_cache_cb(uv_getaddrinfo_t* handle,
+                                 int status,
+                                 struct addrinfo* res);
+
+
+static void getaddrinfo_cache_next(const char* node, int numeric) {
+  struct addrinfo hints;
+  int r;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_flags = AI_NUMERICHOST;
+
+  r = uv_getaddrinfo(uv_default_loop(),
+                     &cache_handle,
+                     getaddrinfo_cache_cb,
+                     node,
+                     NULL,
+                     numeric ? &hints : NULL);
+  ASSERT(r == 0);
+}
+
+
+static void getaddrinfo_cache_cb(uv_getaddrinfo_t* handle,
+                                 int status,
+                                 struct addrinfo* res) {
+  uv_counters_t* counters = &uv_default_loop()->counters;
+
+  ASSERT(handle == &cache_handle);
+
+  switch (cache_step++) {
+    case 0:
+      /* Miss, remember the answer. */
+      ASSERT(status == 0);
+      ASSERT(res != NULL);
+      ASSERT(counters->getaddrinfo_cache_miss == 1);
+      ASSERT(counters->getaddrinfo_cache_hit == 0);
+      cache_first_res = res;
+      getaddrinfo_cache_next(name, 0);
+      break;
+
+    case 1:
+      /* Hit, a copy of the same answer. */
+      ASSERT(status == 0);
+      ASSERT(res != NULL && res != cache_first_res);
+      ASSERT(counters->getaddrinfo_cache_miss == 1);
+      ASSERT(counters->getaddrinfo_cache_hit == 1);
+      ASSERT(res->ai_addrlen == cache_first_res->ai_addrlen);
+      ASSERT(memcmp(res->ai_addr,
+                    cache_first_res->ai_addr,
+                    res->ai_addrlen) == 0);
+      uv_freeaddrinfo(res);
+      getaddrinfo_cache_next("not a number", 1);
+      break;
+
+    case 2:
+      /* Negative miss. */
+      ASSERT(status != 0);
+      ASSERT(res == NULL);
+      ASSERT(uv_last_error(uv_default_loop()).code == UV_ENOENT);
+      ASSERT(counters->getaddrinfo_cache_miss == 2);
+      getaddrinfo_cache_next("not a number", 1);
+      break;
+
+    case 3:
+      /* Negative hit. */
+      ASSERT(status != 0);
+      ASSERT(res == NULL);
+      ASSERT(uv_last_error(uv_default_loop()).code == UV_ENOENT);
+      ASSERT(counters->getaddrinfo_cache_miss == 2);
+      ASSERT(counters->getaddrinfo_cache_hit == 2);
+
+      /* Let the answer expire, it's still served while it's refreshed. */
+      uv_getaddrinfo_cache(uv_default_loop(), 1, 1, 60 * 1000);
+      uv_sleep(10);
+      uv_update_time(uv_default_loop());
+      getaddrinfo_cache_next(name, 0);
+      break;
+
+    case 4:
+      ASSERT(status == 0);
+      ASSERT(res != NULL);
+      ASSERT(counters->getaddrinfo_cache_miss == 2);
+      ASSERT(counters->getaddrinfo_cache_hit == 3);
+      uv_freeaddrinfo(res);
+      break;
+
+    default:
+      ASSERT(0 && "unexpected callback");
+  }
+}
+
+
+TEST_IMPL(getaddrinfo_cache) {
+  int r;
+
+  r = uv_getaddrinfo_cache(uv_default_loop(), 60 * 1000, 60 * 1000, 0);
+  ASSERT(r == 0);
+
+  getaddrinfo_cache_next(name, 0);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(cache_step == 5);
+  uv_freeaddrinfo(cache_first_res);
+
+  /* The background refresh went out and didn't count as a lookup. */
+  ASSERT(uv_default_loop()->counters.getaddrinfo_cache_miss == 2);
+
+  r = uv_getaddrinfo_cache(uv_default_loop(), 0, 0, 0);
+  ASSERT(r == 0);
+
+  return 0;
+}
+
+
+static int cache_delete_cb_called;
+
+
+static void getaddrinfo_cache_delete_cb(uv_getaddrinfo_t* handle,
+                                        int status,
+                                        struct addrinfo* res) {
+  ASSERT(status == 0);
+  cache_delete_cb_called++;
+  uv_freeaddrinfo(res);
+}
+
+
+/* Deleting a loop drops the cache's background refreshes, without running
+ * any callbacks.
+ */
+TEST_IMPL(getaddrinfo_cache_delete) {
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_loop_new();
+  ASSERT(loop != NULL);
+
+  r = uv_getaddrinfo_cache(loop, 1, 1, 60 * 1000);
+  ASSERT(r == 0);
+
+  r = uv_getaddrinfo(loop, &cache_handle, getaddrinfo_cache_delete_cb, name,
+      NULL, NULL);
+  ASSERT(r == 0);
+  uv_run(loop);
+  ASSERT(cache_delete_cb_called == 1);
+
+  /* Stale, answered from the cache while a refresh goes out. */
+  uv_sleep(10);
+  uv_update_time(loop);
+  r = uv_getaddrinfo(loop, &cache_handle, getaddrinfo_cache_delete_cb, name,
+      NULL, NULL);
+  ASSERT(r == 0);
+  ASSERT(loop->counters.getaddrinfo_cache_hit == 1);
+
+  uv_loop_delete(loop);
+  ASSERT(cache_delete_cb_called == 1);
+
+  return 0;
+}
+
+
+#define COALESCE_WAITERS 4
+
+static uv_getaddrinfo_t coalesce_blocker;
+static uv_getaddrinfo_t coalesce_handles[COALESCE_WAITERS];
+static struct addrinfo* coalesce_res[COALESCE_WAITERS];
+static int coalesce_blocker_cb_called;
+static int coalesce_cancelled;
+static int coalesce_answered;
+
+
+static void coalesce_blocker_cb(uv_getaddrinfo_t* handle,
+                                int status,
+                                struct addrinfo* res) {
+  coalesce_blocker_cb_called++;
+  uv_freeaddrinfo(res);
+}
+
+
+static void coalesce_cb(uv_getaddrinfo_t* handle,
+                        int status,
+                        struct addrinfo* res) {
+  int i = handle - coalesce_handles;
+
+  ASSERT(i >= 0 && i < COALESCE_WAITERS);
+
+  if (i == 0 || i == 2) {
+    ASSERT(status == -1);
+    ASSERT(res == NULL);
+    ASSERT(uv_last_error(handle->loop).code == UV_ECANCELED);
+    coalesce_cancelled++;
+    return;
+  }
+
+  ASSERT(status == 0);
+  ASSERT(res != NULL);
+  coalesce_res[i] = res;
+  coalesce_answered++;
+
+  /* The last waiter already has its answer, it is too late to cancel. */
+  if (i == 1) {
+    ASSERT(uv_cancel(handle->loop, (uv_req_t*) &coalesce_handles[3]) == -1);
+  }
+}
+
+
+TEST_IMPL(getaddrinfo_coalesce) {
+  uv_loop_t* loop;
+  int i;
+  int r;
+
+  loop = uv_default_loop();
+
+  /* One lookup at a time, so the first localhost lookup stays parked. */
+  r = uv_lane_set_limit(loop, UV_LANE_DNS, 1);
+  ASSERT(r == 0);
+
+  r = uv_getaddrinfo(loop, &coalesce_blocker, coalesce_blocker_cb,
+      "127.0.0.1", NULL, NULL);
+  ASSERT(r == 0);
+
+  for (i = 0; i < COALESCE_WAITERS; i++) {
+    r = uv_getaddrinfo(loop, &coalesce_handles[i], coalesce_cb, name, NULL,
+        NULL);
+    ASSERT(r == 0);
+  }
+
+  /* The first handle does the lookup, the next one takes over. */
+  r = uv_cancel(loop, (uv_req_t*) &coalesce_handles[0]);
+  ASSERT(r == 0);
+
+  /* A waiter can leave on its own. */
+  r = uv_cancel(loop, (uv_req_t*) &coalesce_handles[2]);
+  ASSERT(r == 0);
+
+  uv_run(loop);
+
+  ASSERT(coalesce_blocker_cb_called == 1);
+  ASSERT(coalesce_cancelled == 2);
+  ASSERT(coalesce_answered == COALESCE_WAITERS - 2);
+
+  /* Everyone got their own copy of the same answer. */
+  ASSERT(coalesce_res[1] != coalesce_res[3]);
+  ASSERT(coalesce_res[1]->ai_addrlen == coalesce_res[3]->ai_addrlen);
+  ASSERT(memcmp(coalesce_res[1]->ai_addr,
+                coalesce_res[3]->ai_addr,
+                coalesce_res[1]->ai_addrlen) == 0);
+
+  uv_freeaddrinfo(coalesce_res[1]);
+  uv_freeaddrinfo(coalesce_res[3]);
+
+  return 0;
+}
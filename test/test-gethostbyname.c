@@ -83,6 +83,8 @@ TEST_IMPL(gethostbyname) {
 
   int rc = 0;
   char addr[4];
+  struct hostent* host1;
+  struct hostent* host2;
 
   rc = ares_library_init(ARES_LIB_INIT_ALL);
   if (rc != 0) {
@@ -185,5 +187,445 @@ TEST_IMPL(gethostbyname) {
   uv_ares_destroy(uv_default_loop(), channel);
   printf("Done gethostbyname and gethostbyaddr concurrent test\n");
 
+
+  /* identical concurrent calls share one query */
+
+  printf("Start gethostbyname coalesced test\n");
+  prep_tcploopback();
+
+  ares_bynamecallbacks = 0;
+  bynamecallbacksig = 7;
+
+  ares_gethostbyname(channel,
+                    "microsoft.com",
+                    AF_INET,
+                    &aresbynamecallback,
+                    &bynamecallbacksig);
+  ares_gethostbyname(channel,
+                    "microsoft.com",
+                    AF_INET,
+                    &aresbynamecallback,
+                    &bynamecallbacksig);
+  ares_gethostbyname(channel,
+                    "microsoft.com",
+                    AF_INET,
+                    &aresbynamecallback,
+                    &bynamecallbacksig);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(ares_bynamecallbacks == 3);
+
+  uv_ares_destroy(uv_default_loop(), channel);
+  printf("Done gethostbyname coalesced test\n");
+
+
+  /* repeated hosts file lookups are answered from the parsed copy */
+
+  printf("Start gethostbyname_file test\n");
+  prep_tcploopback();
+
+  rc = ares_gethostbyname_file(channel, "localhost", AF_INET, &host1);
+  ASSERT(rc == ARES_SUCCESS);
+  rc = ares_gethostbyname_file(channel, "LOCALHOST", AF_INET, &host2);
+  ASSERT(rc == ARES_SUCCESS);
+
+  ASSERT(host1 != host2);
+  ASSERT(host1->h_addrtype == AF_INET);
+  ASSERT(host2->h_addrtype == AF_INET);
+  ASSERT(strcmp(host1->h_name, host2->h_name) == 0);
+  ASSERT(memcmp(host1->h_addr_list[0], host2->h_addr_list[0], 4) == 0);
+  ASSERT(host1->h_addr_list[1] == NULL);
+
+  ares_free_hostent(host1);
+  ares_free_hostent(host2);
+
+  rc = ares_gethostbyname_file(channel, "no-such-host.invalid", AF_INET, &host1);
+  ASSERT(rc == ARES_ENOTFOUND);
+  ASSERT(host1 == NULL);
+
+  uv_ares_destroy(uv_default_loop(), channel);
+  printf("Done gethostbyname_file test\n");
+
+  return 0;
+}
+
+
+static uv_udp_t silent_server;
+static int silent_server_packets;
+static int timeout_cb_called;
+static int64_t timeout_start;
+static int64_t timeout_elapsed;
+static char silent_slab[1024];
+
+
+static uv_buf_t silent_alloc(uv_handle_t* handle, size_t suggested_size) {
+  return uv_buf_init(silent_slab, sizeof silent_slab);
+}
+
+
+static void silent_recv(uv_udp_t* handle,
+                        ssize_t nread,
+                        uv_buf_t buf,
+                        struct sockaddr* addr,
+                        unsigned flags) {
+  /* Swallow the query so that c-ares has to retry and then give up. */
+  if (nread > 0)
+    silent_server_packets++;
+}
+
+
+static void timeout_callback(void *arg,
+                             int status,
+                             int timeouts,
+                             struct hostent *hostent) {
+  ASSERT(status == ARES_ETIMEOUT);
+  ASSERT(hostent == NULL);
+
+  uv_update_time(uv_default_loop());
+  timeout_elapsed = uv_now(uv_default_loop()) - timeout_start;
+  timeout_cb_called++;
+
+  uv_close((uv_handle_t*)&silent_server, NULL);
+}
+
+
+TEST_IMPL(gethostbyname_timeout) {
+  struct sockaddr_in addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  int rc;
+
+  rc = ares_library_init(ARES_LIB_INIT_ALL);
+  ASSERT(rc == 0);
+
+  rc = uv_udp_init(uv_default_loop(), &silent_server);
+  ASSERT(rc == 0);
+  rc = uv_udp_bind(&silent_server, addr, 0);
+  ASSERT(rc == 0);
+  rc = uv_udp_recv_start(&silent_server, silent_alloc, silent_recv);
+  ASSERT(rc == 0);
+
+  optmask = ARES_OPT_SERVERS | ARES_OPT_UDP_PORT | ARES_OPT_TIMEOUTMS |
+            ARES_OPT_TRIES;
+  options.servers = &addr.sin_addr;
+  options.nservers = 1;
+  options.udp_port = htons(TEST_PORT);
+  options.timeout = 100;
+  options.tries = 2;
+
+  rc = uv_ares_init_options(uv_default_loop(), &channel, &options, optmask);
+  ASSERT(rc == ARES_SUCCESS);
+
+  uv_update_time(uv_default_loop());
+  timeout_start = uv_now(uv_default_loop());
+
+  ares_gethostbyname(channel,
+                     "example.invalid",
+                     AF_INET,
+                     &timeout_callback,
+                     NULL);
+  uv_run(uv_default_loop());
+
+  ASSERT(timeout_cb_called == 1);
+  ASSERT(silent_server_packets == 2);
+
+  /* Two tries of 100 and 200 ms; retries must not wait for a coarse poll. */
+  ASSERT(timeout_elapsed >= 250);
+  ASSERT(timeout_elapsed < 1000);
+
+  uv_ares_destroy(uv_default_loop(), channel);
+
+  return 0;
+}
+
+
+#define MANY_SOCKETS 20
+
+static int many_sockets_cb_called;
+
+
+static void many_sockets_callback(void *arg,
+                                  int status,
+                                  int timeouts,
+                                  struct hostent *hostent) {
+  ASSERT(status == ARES_ETIMEOUT);
+
+  if (++many_sockets_cb_called == MANY_SOCKETS)
+    uv_close((uv_handle_t*)&silent_server, NULL);
+}
+
+
+/* One socket per server; enough of them to grow the loop's task table. */
+TEST_IMPL(gethostbyname_many_sockets) {
+  struct sockaddr_in addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  struct in_addr servers[MANY_SOCKETS];
+  ares_channel loop_channel;
+  char name[32];
+  uv_loop_t* loop;
+  int rc;
+  int i;
+
+  rc = ares_library_init(ARES_LIB_INIT_ALL);
+  ASSERT(rc == 0);
+
+  /* Use a loop of its own; every loop can have a channel. */
+  loop = uv_loop_new();
+  ASSERT(loop != NULL);
+
+  rc = uv_udp_init(loop, &silent_server);
+  ASSERT(rc == 0);
+  rc = uv_udp_bind(&silent_server, addr, 0);
+  ASSERT(rc == 0);
+  rc = uv_udp_recv_start(&silent_server, silent_alloc, silent_recv);
+  ASSERT(rc == 0);
+
+  for (i = 0; i < MANY_SOCKETS; i++)
+    servers[i] = addr.sin_addr;
+
+  optmask = ARES_OPT_SERVERS | ARES_OPT_UDP_PORT | ARES_OPT_TIMEOUTMS |
+            ARES_OPT_TRIES | ARES_OPT_ROTATE | ARES_OPT_LOOKUPS |
+            ARES_OPT_DOMAINS;
+  options.servers = servers;
+  options.nservers = MANY_SOCKETS;
+  options.udp_port = htons(TEST_PORT);
+  options.timeout = 10;
+  options.tries = 1;
+  options.lookups = "b";
+  options.domains = NULL;
+  options.ndomains = 0;
+
+  rc = uv_ares_init_options(loop, &loop_channel, &options, optmask);
+  ASSERT(rc == ARES_SUCCESS);
+
+  for (i = 0; i < MANY_SOCKETS; i++) {
+    snprintf(name, sizeof name, "host-%d.invalid", i);
+    ares_gethostbyname(loop_channel,
+                       name,
+                       AF_INET,
+                       &many_sockets_callback,
+                       NULL);
+  }
+
+  uv_run(loop);
+
+  ASSERT(many_sockets_cb_called == MANY_SOCKETS);
+  ASSERT(silent_server_packets == MANY_SOCKETS * MANY_SOCKETS);
+
+  uv_ares_destroy(loop, loop_channel);
+  uv_loop_delete(loop);
+
+  return 0;
+}
+
+
+/* example.com CNAME www.example.com, which has two A records. */
+static const unsigned char cname_answer[] = {
+  0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00,
+  /* question, offset 12 */
+  0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0x03, 'c', 'o', 'm', 0x00,
+  0x00, 0x01, 0x00, 0x01,
+  /* example.com CNAME www.example.com, ttl 300; www is at offset 41 */
+  0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x06,
+  0x03, 'w', 'w', 'w', 0xc0, 0x0c,
+  /* www.example.com A 1.2.3.4, ttl 600 */
+  0xc0, 0x29, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x02, 0x58, 0x00, 0x04,
+  1, 2, 3, 4,
+  /* www.example.com A 5.6.7.8, ttl 100 */
+  0xc0, 0x29, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x00, 0x64, 0x00, 0x04,
+  5, 6, 7, 8
+};
+
+
+TEST_IMPL(gethostbyname_parse) {
+  union {
+    struct hostent host;
+    char buf[512];
+  } block;
+  struct hostent* expected;
+  struct hostent* host;
+  int* ttls;
+  int rc;
+
+  rc = ares_parse_a_reply(cname_answer,
+                          sizeof cname_answer,
+                          &expected,
+                          NULL,
+                          NULL);
+  ASSERT(rc == ARES_SUCCESS);
+
+  /* Fits in the caller's buffer. */
+  rc = ares_parse_hostent_reply(cname_answer,
+                                sizeof cname_answer,
+                                AF_INET,
+                                &block,
+                                sizeof block,
+                                &host,
+                                &ttls);
+  ASSERT(rc == ARES_SUCCESS);
+  ASSERT(host == &block.host);
+
+  ASSERT(strcmp(host->h_name, expected->h_name) == 0);
+  ASSERT(strcmp(host->h_name, "www.example.com") == 0);
+  ASSERT(strcmp(host->h_aliases[0], expected->h_aliases[0]) == 0);
+  ASSERT(host->h_aliases[1] == NULL);
+  ASSERT(host->h_addrtype == AF_INET);
+  ASSERT(host->h_length == 4);
+  ASSERT(memcmp(host->h_addr_list[0], expected->h_addr_list[0], 4) == 0);
+  ASSERT(memcmp(host->h_addr_list[1], expected->h_addr_list[1], 4) == 0);
+  ASSERT(host->h_addr_list[2] == NULL);
+
+  /* TTLs are capped by the CNAME's. */
+  ASSERT(ttls[0] == 300);
+  ASSERT(ttls[1] == 100);
+
+  /* Too small a buffer falls back to a single allocation. */
+  rc = ares_parse_hostent_reply(cname_answer,
+                                sizeof cname_answer,
+                                AF_INET,
+                                &block,
+                                sizeof(struct hostent),
+                                &host,
+                                NULL);
+  ASSERT(rc == ARES_SUCCESS);
+  ASSERT(host != &block.host);
+  ASSERT(strcmp(host->h_name, "www.example.com") == 0);
+  ASSERT(memcmp(host->h_addr_list[1], expected->h_addr_list[1], 4) == 0);
+  free(host);
+
+  /* No AAAA records, as ares_parse_aaaa_reply() would say. */
+  rc = ares_parse_hostent_reply(cname_answer,
+                                sizeof cname_answer,
+                                AF_INET6,
+                                NULL,
+                                0,
+                                &host,
+                                NULL);
+  ASSERT(rc == ARES_ENODATA);
+  ASSERT(host == NULL);
+
+  /* Truncated answers are rejected. */
+  rc = ares_parse_hostent_reply(cname_answer,
+                                sizeof cname_answer - 2,
+                                AF_INET,
+                                NULL,
+                                0,
+                                &host,
+                                NULL);
+  ASSERT(rc == ARES_EBADRESP);
+
+  ares_free_hostent(expected);
+
+  return 0;
+}
+
+
+static uv_udp_t echo_server;
+static uv_udp_send_t echo_req;
+static char echo_slab[1024];
+static int selection_cb_called;
+static int selection_timeouts[2];
+
+
+static uv_buf_t echo_alloc(uv_handle_t* handle, size_t suggested_size) {
+  return uv_buf_init(echo_slab, sizeof echo_slab);
+}
+
+
+static void echo_recv(uv_udp_t* handle,
+                      ssize_t nread,
+                      uv_buf_t buf,
+                      struct sockaddr* addr,
+                      unsigned flags) {
+  int r;
+
+  if (nread <= 0)
+    return;
+
+  /* An echoed query is an answer with no records. */
+  buf.len = nread;
+  r = uv_udp_send(&echo_req,
+                  handle,
+                  &buf,
+                  1,
+                  *(struct sockaddr_in*)addr,
+                  NULL);
+  ASSERT(r == 0);
+}
+
+
+static void selection_callback(void *arg,
+                               int status,
+                               int timeouts,
+                               struct hostent *hostent) {
+  ASSERT(status == ARES_ENODATA);
+  selection_timeouts[selection_cb_called++] = timeouts;
+
+  if (selection_cb_called == 1) {
+    ares_gethostbyname(channel,
+                       "second.invalid",
+                       AF_INET,
+                       &selection_callback,
+                       NULL);
+  } else {
+    uv_close((uv_handle_t*)&silent_server, NULL);
+    uv_close((uv_handle_t*)&echo_server, NULL);
+  }
+}
+
+
+/* The first server never answers; once that is known it is left alone. */
+TEST_IMPL(gethostbyname_server_selection) {
+  struct sockaddr_in silent_addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  struct sockaddr_in echo_addr = uv_ip4_addr("127.0.0.2", TEST_PORT);
+  struct in_addr servers[2];
+  int rc;
+
+  rc = ares_library_init(ARES_LIB_INIT_ALL);
+  ASSERT(rc == 0);
+
+  rc = uv_udp_init(uv_default_loop(), &silent_server);
+  ASSERT(rc == 0);
+  rc = uv_udp_bind(&silent_server, silent_addr, 0);
+  ASSERT(rc == 0);
+  rc = uv_udp_recv_start(&silent_server, silent_alloc, silent_recv);
+  ASSERT(rc == 0);
+
+  rc = uv_udp_init(uv_default_loop(), &echo_server);
+  ASSERT(rc == 0);
+  rc = uv_udp_bind(&echo_server, echo_addr, 0);
+  ASSERT(rc == 0);
+  rc = uv_udp_recv_start(&echo_server, echo_alloc, echo_recv);
+  ASSERT(rc == 0);
+
+  servers[0] = silent_addr.sin_addr;
+  servers[1] = echo_addr.sin_addr;
+
+  optmask = ARES_OPT_SERVERS | ARES_OPT_UDP_PORT | ARES_OPT_TIMEOUTMS |
+            ARES_OPT_TRIES | ARES_OPT_LOOKUPS | ARES_OPT_DOMAINS;
+  options.servers = servers;
+  options.nservers = 2;
+  options.udp_port = htons(TEST_PORT);
+  options.timeout = 100;
+  options.tries = 1;
+  options.lookups = "b";
+  options.domains = NULL;
+  options.ndomains = 0;
+
+  rc = uv_ares_init_options(uv_default_loop(), &channel, &options, optmask);
+  ASSERT(rc == ARES_SUCCESS);
+
+  ares_gethostbyname(channel,
+                     "first.invalid",
+                     AF_INET,
+                     &selection_callback,
+                     NULL);
+  uv_run(uv_default_loop());
+
+  ASSERT(selection_cb_called == 2);
+  ASSERT(selection_timeouts[0] == 1);
+  ASSERT(selection_timeouts[1] == 0);
+  ASSERT(silent_server_packets == 1);
+
+  uv_ares_destroy(uv_default_loop(), channel);
+
   return 0;
 }
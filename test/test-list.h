@@ -31,6 +31,14 @@ TEST_DECLARE   (pipe_ping_pong)
 TEST_DECLARE   (delayed_accept)
 TEST_DECLARE   (multiple_listen)
 TEST_DECLARE   (tcp_writealot)
+#ifndef _WIN32
+TEST_DECLARE   (tcp_write_sendfile)
+TEST_DECLARE   (tcp_stream_pipe)
+TEST_DECLARE   (tcp_write_watermarks)
+TEST_DECLARE   (tcp_connect_name)
+TEST_DECLARE   (tcp_connect_name_blackhole)
+TEST_DECLARE   (tcp_connect_name_refused)
+#endif
 TEST_DECLARE   (tcp_bind_error_addrinuse)
 TEST_DECLARE   (tcp_bind_error_addrnotavail_1)
 TEST_DECLARE   (tcp_bind_error_addrnotavail_2)
@@ -74,12 +82,24 @@ TEST_DECLARE   (prepare_ref)
 TEST_DECLARE   (check_ref)
 TEST_DECLARE   (unref_in_prepare_cb)
 TEST_DECLARE   (async)
+#ifndef _WIN32
+TEST_DECLARE   (post)
+#endif
 TEST_DECLARE   (get_currentexe)
 TEST_DECLARE   (get_memory)
 TEST_DECLARE   (hrtime)
 TEST_DECLARE   (getaddrinfo_basic)
 TEST_DECLARE   (getaddrinfo_concurrent)
+#ifndef _WIN32
+TEST_DECLARE   (getaddrinfo_cache)
+TEST_DECLARE   (getaddrinfo_cache_delete)
+TEST_DECLARE   (getaddrinfo_coalesce)
+#endif
 TEST_DECLARE   (gethostbyname)
+TEST_DECLARE   (gethostbyname_timeout)
+TEST_DECLARE   (gethostbyname_many_sockets)
+TEST_DECLARE   (gethostbyname_parse)
+TEST_DECLARE   (gethostbyname_server_selection)
 TEST_DECLARE   (getsockname_tcp)
 TEST_DECLARE   (getsockname_udp)
 TEST_DECLARE   (fail_always)
@@ -108,7 +128,24 @@ TEST_DECLARE   (fs_event_watch_file_current_dir)
 TEST_DECLARE   (fs_readdir_empty_dir)
 TEST_DECLARE   (fs_readdir_file)
 TEST_DECLARE   (fs_open_dir)
+#ifndef _WIN32
+TEST_DECLARE   (fs_readv_writev)
+TEST_DECLARE   (fs_readdir_types)
+TEST_DECLARE   (fs_opendir_chunks)
+TEST_DECLARE   (fs_walk)
+TEST_DECLARE   (fs_batch)
+TEST_DECLARE   (fs_mmap)
+TEST_DECLARE   (fs_fadvise)
+TEST_DECLARE   (fs_read_inline)
+#endif
 TEST_DECLARE   (threadpool_queue_work_simple)
+TEST_DECLARE   (threadpool_queue_work_many)
+#ifndef _WIN32
+TEST_DECLARE   (threadpool_lane_limit)
+TEST_DECLARE   (threadpool_dns_reserve)
+TEST_DECLARE   (threadpool_cancel_work)
+TEST_DECLARE   (threadpool_cancel_fs)
+#endif
 #ifdef _WIN32
 TEST_DECLARE   (spawn_detect_pipe_name_collisions_on_windows)
 TEST_DECLARE   (argument_escaping)
@@ -145,6 +182,25 @@ TASK_LIST_START
   TEST_ENTRY  (tcp_writealot)
   TEST_HELPER (tcp_writealot, tcp4_echo_server)
 
+#ifndef _WIN32
+  TEST_ENTRY  (tcp_write_sendfile)
+#endif
+
+#ifndef _WIN32
+  TEST_ENTRY  (tcp_stream_pipe)
+#endif
+
+#ifndef _WIN32
+  TEST_ENTRY  (tcp_write_watermarks)
+  TEST_HELPER (tcp_write_watermarks, tcp4_echo_server)
+#endif
+
+#ifndef _WIN32
+  TEST_ENTRY  (tcp_connect_name)
+  TEST_ENTRY  (tcp_connect_name_blackhole)
+  TEST_ENTRY  (tcp_connect_name_refused)
+#endif
+
   TEST_ENTRY  (tcp_bind_error_addrinuse)
   TEST_ENTRY  (tcp_bind_error_addrnotavail_1)
   TEST_ENTRY  (tcp_bind_error_addrnotavail_2)
@@ -203,6 +259,10 @@ TASK_LIST_START
 
   TEST_ENTRY  (async)
 
+#ifndef _WIN32
+  TEST_ENTRY  (post)
+#endif
+
   TEST_ENTRY  (get_currentexe)
 
   TEST_ENTRY  (get_memory)
@@ -213,10 +273,20 @@ TASK_LIST_START
 
   TEST_ENTRY  (getaddrinfo_basic)
   TEST_ENTRY  (getaddrinfo_concurrent)
+#ifndef _WIN32
+  TEST_ENTRY  (getaddrinfo_cache)
+  TEST_ENTRY  (getaddrinfo_cache_delete)
+  TEST_ENTRY  (getaddrinfo_coalesce)
+#endif
 
   TEST_ENTRY  (gethostbyname)
   TEST_HELPER (gethostbyname, tcp4_echo_server)
 
+  TEST_ENTRY  (gethostbyname_timeout)
+  TEST_ENTRY  (gethostbyname_many_sockets)
+  TEST_ENTRY  (gethostbyname_parse)
+  TEST_ENTRY  (gethostbyname_server_selection)
+
   TEST_ENTRY  (getsockname_tcp)
   TEST_ENTRY  (getsockname_udp)
 
@@ -249,7 +319,24 @@ TASK_LIST_START
   TEST_ENTRY  (fs_readdir_empty_dir)
   TEST_ENTRY  (fs_readdir_file)
   TEST_ENTRY  (fs_open_dir)
+#ifndef _WIN32
+  TEST_ENTRY  (fs_readv_writev)
+  TEST_ENTRY  (fs_readdir_types)
+  TEST_ENTRY  (fs_opendir_chunks)
+  TEST_ENTRY  (fs_walk)
+  TEST_ENTRY  (fs_batch)
+  TEST_ENTRY  (fs_mmap)
+  TEST_ENTRY  (fs_fadvise)
+  TEST_ENTRY  (fs_read_inline)
+#endif
   TEST_ENTRY  (threadpool_queue_work_simple)
+  TEST_ENTRY  (threadpool_queue_work_many)
+#ifndef _WIN32
+  TEST_ENTRY  (threadpool_lane_limit)
+  TEST_ENTRY  (threadpool_dns_reserve)
+  TEST_ENTRY  (threadpool_cancel_work)
+  TEST_ENTRY  (threadpool_cancel_fs)
+#endif
 
 #if 0
   /* These are for testing the test runner. */
@@ -0,0 +1,98 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define PRODUCERS 4
+#define POSTS_PER_PRODUCER 10000
+
+
+typedef struct {
+  int producer;
+  int seq;
+} message_t;
+
+
+static uv_post_t reqs[PRODUCERS][POSTS_PER_PRODUCER];
+static message_t messages[PRODUCERS][POSTS_PER_PRODUCER];
+static int producer_ids[PRODUCERS];
+static int next_seq[PRODUCERS];
+static int post_cb_called;
+
+
+static void post_cb(uv_post_t* req) {
+  message_t* msg = req->data;
+
+  ASSERT(req->type == UV_POST);
+  ASSERT(req->loop == uv_default_loop());
+
+  /* Posts from the same thread arrive in order. */
+  ASSERT(msg->seq == next_seq[msg->producer]);
+  next_seq[msg->producer]++;
+
+  if (++post_cb_called == PRODUCERS * POSTS_PER_PRODUCER) {
+    uv_unref(uv_default_loop());
+  }
+}
+
+
+static void producer(void* arg) {
+  int id = *(int*)arg;
+  int i;
+  int r;
+
+  for (i = 0; i < POSTS_PER_PRODUCER; i++) {
+    messages[id][i].producer = id;
+    messages[id][i].seq = i;
+    reqs[id][i].data = &messages[id][i];
+    r = uv_post(uv_default_loop(), &reqs[id][i], post_cb);
+    ASSERT(r == 0);
+  }
+}
+
+
+TEST_IMPL(post) {
+  uintptr_t threads[PRODUCERS];
+  int i;
+  int r;
+
+  /* Pending posts don't keep the loop alive. */
+  uv_ref(uv_default_loop());
+
+  for (i = 0; i < PRODUCERS; i++) {
+    producer_ids[i] = i;
+    threads[i] = uv_create_thread(producer, &producer_ids[i]);
+    ASSERT(threads[i] != 0);
+  }
+
+  uv_run(uv_default_loop());
+
+  for (i = 0; i < PRODUCERS; i++) {
+    r = uv_wait_thread(threads[i]);
+    ASSERT(r == 0);
+    ASSERT(next_seq[i] == POSTS_PER_PRODUCER);
+  }
+
+  ASSERT(post_cb_called == PRODUCERS * POSTS_PER_PRODUCER);
+
+  return 0;
+}
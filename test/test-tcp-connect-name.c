@@ -0,0 +1,263 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Without a node getaddrinfo() returns the loopback addresses, ::1 before
+ * 127.0.0.1, so these tests serve only the IPv4 one and make the IPv6 one
+ * refuse or ignore connections.
+ */
+#define SERVICE "9123" /* TEST_PORT */
+
+static uv_tcp_t server;
+static uv_tcp_t server6;
+static uv_tcp_t client;
+static uv_tcp_t fillers[2];
+static uv_connect_t filler_reqs[2];
+static uv_connect_name_t connect_req;
+
+static int connection_cb_called;
+static int connect_cb_called;
+static int close_cb_called;
+static int fillers_connected;
+static int64_t start_time;
+static int64_t connect_time;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void free_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+
+/* Closes the client and the server once both sides saw the connection. */
+static void maybe_close(void) {
+  if (connect_cb_called == 1 && connection_cb_called == 1) {
+    uv_close((uv_handle_t*)&client, close_cb);
+    uv_close((uv_handle_t*)&server, close_cb);
+  }
+}
+
+
+static void connection_cb(uv_stream_t* s, int status) {
+  uv_tcp_t* conn;
+  int r;
+
+  ASSERT(s == (uv_stream_t*)&server);
+  ASSERT(status == 0);
+
+  conn = malloc(sizeof *conn);
+  ASSERT(conn != NULL);
+
+  r = uv_tcp_init(uv_default_loop(), conn);
+  ASSERT(r == 0);
+
+  r = uv_accept(s, (uv_stream_t*)conn);
+  ASSERT(r == 0);
+
+  uv_close((uv_handle_t*)conn, free_close_cb);
+  connection_cb_called++;
+  maybe_close();
+}
+
+
+/* The IPv6 server never accepts, so it never calls back. */
+static void connection6_cb(uv_stream_t* s, int status) {
+}
+
+
+static void start_server(void) {
+  struct sockaddr_in addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  int r;
+
+  r = uv_tcp_init(uv_default_loop(), &server);
+  ASSERT(r == 0);
+
+  r = uv_tcp_bind(&server, addr);
+  ASSERT(r == 0);
+
+  r = uv_listen((uv_stream_t*)&server, 128, connection_cb);
+  ASSERT(r == 0);
+}
+
+
+static void check_peer(void) {
+  struct sockaddr_storage peer;
+  int namelen;
+  int r;
+
+  namelen = sizeof peer;
+  r = uv_tcp_getpeername(&client, (struct sockaddr*)&peer, &namelen);
+  ASSERT(r == 0);
+  ASSERT(peer.ss_family == AF_INET);
+  ASSERT(ntohs(((struct sockaddr_in*)&peer)->sin_port) == TEST_PORT);
+}
+
+
+static void connect_cb(uv_connect_name_t* req, int status) {
+  ASSERT(req == &connect_req);
+  ASSERT(req->handle == &client);
+  ASSERT(status == 0);
+
+  uv_update_time(uv_default_loop());
+  connect_time = uv_now(uv_default_loop());
+
+  check_peer();
+
+  connect_cb_called++;
+  maybe_close();
+}
+
+
+TEST_IMPL(tcp_connect_name) {
+  int r;
+
+  start_server();
+
+  r = uv_tcp_init(uv_default_loop(), &client);
+  ASSERT(r == 0);
+
+  r = uv_tcp_connect_name(&connect_req, &client, NULL, SERVICE, 0,
+      connect_cb);
+  ASSERT(r == 0);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(connect_cb_called == 1);
+  ASSERT(connection_cb_called == 1);
+  ASSERT(close_cb_called == 2);
+
+  return 0;
+}
+
+
+static void blackhole_connect_cb(uv_connect_name_t* req, int status) {
+  int i;
+
+  connect_cb(req, status);
+
+  uv_close((uv_handle_t*)&server6, close_cb);
+  for (i = 0; i < 2; i++) {
+    uv_close((uv_handle_t*)&fillers[i], close_cb);
+  }
+}
+
+
+static void filler_connect_cb(uv_connect_t* req, int status) {
+  int r;
+
+  ASSERT(status == 0);
+
+  if (++fillers_connected < 2) {
+    return;
+  }
+
+  /* ::1 now drops new connections, the attempt there has to be raced. */
+  uv_update_time(uv_default_loop());
+  start_time = uv_now(uv_default_loop());
+
+  r = uv_tcp_connect_name(&connect_req, &client, NULL, SERVICE, 50,
+      blackhole_connect_cb);
+  ASSERT(r == 0);
+}
+
+
+TEST_IMPL(tcp_connect_name_blackhole) {
+  struct sockaddr_in6 addr6 = uv_ip6_addr("::1", TEST_PORT);
+  int i;
+  int r;
+
+  start_server();
+
+  r = uv_tcp_init(uv_default_loop(), &server6);
+  ASSERT(r == 0);
+
+  r = uv_tcp_bind6(&server6, addr6);
+  ASSERT(r == 0);
+
+  /*
+   * With a backlog of 0 the kernel queues one connection. libuv accepts
+   * the first filler and holds on to it, the second one fills the queue.
+   */
+  r = uv_listen((uv_stream_t*)&server6, 0, connection6_cb);
+  ASSERT(r == 0);
+
+  for (i = 0; i < 2; i++) {
+    r = uv_tcp_init(uv_default_loop(), &fillers[i]);
+    ASSERT(r == 0);
+
+    r = uv_tcp_connect6(&filler_reqs[i], &fillers[i], addr6,
+        filler_connect_cb);
+    ASSERT(r == 0);
+  }
+
+  r = uv_tcp_init(uv_default_loop(), &client);
+  ASSERT(r == 0);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(connect_cb_called == 1);
+  ASSERT(connection_cb_called == 1);
+  ASSERT(close_cb_called == 5);
+
+  /* Connected over IPv4 once the delay passed, not after a timeout. */
+  ASSERT(connect_time - start_time >= 40);
+  ASSERT(connect_time - start_time < 1000);
+
+  return 0;
+}
+
+
+static void refused_connect_cb(uv_connect_name_t* req, int status) {
+  ASSERT(req == &connect_req);
+  ASSERT(status == -1);
+  ASSERT(uv_last_error(uv_default_loop()).code == UV_ECONNREFUSED);
+
+  uv_close((uv_handle_t*)&client, close_cb);
+  connect_cb_called++;
+}
+
+
+TEST_IMPL(tcp_connect_name_refused) {
+  int r;
+
+  r = uv_tcp_init(uv_default_loop(), &client);
+  ASSERT(r == 0);
+
+  r = uv_tcp_connect_name(&connect_req, &client, NULL, SERVICE, 0,
+      refused_connect_cb);
+  ASSERT(r == 0);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(connect_cb_called == 1);
+  ASSERT(close_cb_called == 1);
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define FILE_SIZE   (4 * 1024 * 1024)
+#define FILE_OFFSET 10
+#define HEAD        "HEAD"
+#define TAIL        "TAIL"
+#define TOTAL_BYTES (4 + (FILE_SIZE - FILE_OFFSET) + 4)
+
+static uv_tcp_t server;
+static uv_tcp_t server_conn;
+static uv_tcp_t client;
+static uv_connect_t connect_req;
+static uv_write_t write_reqs[4];
+static uv_shutdown_t shutdown_req;
+
+static char* file_data;
+static char* received;
+static size_t received_len;
+static int file_fd;
+
+static int write_cb_order[4];
+static int write_cb_called;
+static int shutdown_cb_called;
+static int close_cb_called;
+static int eof_seen;
+
+
+static uv_buf_t alloc_cb(uv_handle_t* handle, size_t size) {
+  return uv_buf_init(malloc(size), size);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, uv_buf_t buf) {
+  if (nread < 0) {
+    ASSERT(uv_last_error(stream->loop).code == UV_EOF);
+    eof_seen++;
+    free(buf.base);
+    uv_close((uv_handle_t*) stream, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+
+  ASSERT(received_len + nread <= TOTAL_BYTES);
+  memcpy(received + received_len, buf.base, nread);
+  received_len += nread;
+  free(buf.base);
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &server_conn));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &server_conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &server_conn, alloc_cb, read_cb));
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  if (req == &write_reqs[3]) {
+    /* Starts at the end of the file. */
+    ASSERT(status == -1);
+    ASSERT(uv_last_error(req->handle->loop).code == UV_EOF);
+  } else {
+    ASSERT(status == 0);
+  }
+  write_cb_order[write_cb_called++] = req - write_reqs;
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT(write_cb_called == 4);
+  ASSERT(client.io.write_queue_size == 0);
+  shutdown_cb_called++;
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_stream_t* stream = req->handle;
+  uv_buf_t buf;
+
+  ASSERT(status == 0);
+
+  /* A write, the file and another write must arrive in that order. */
+  buf = uv_buf_init(HEAD, 4);
+  ASSERT(0 == uv_write(&write_reqs[0], stream, &buf, 1, write_cb));
+
+  ASSERT(0 == uv_write_sendfile(&write_reqs[1], stream, file_fd, FILE_OFFSET,
+      FILE_SIZE - FILE_OFFSET, write_cb));
+
+  buf = uv_buf_init(TAIL, 4);
+  ASSERT(0 == uv_write(&write_reqs[2], stream, &buf, 1, write_cb));
+
+  /* Past the end of the file, fails without sending anything. */
+  ASSERT(0 == uv_write_sendfile(&write_reqs[3], stream, file_fd, FILE_SIZE,
+      16, write_cb));
+
+  ASSERT(0 == uv_shutdown(&shutdown_req, stream, shutdown_cb));
+}
+
+
+TEST_IMPL(tcp_write_sendfile) {
+  struct sockaddr_in addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  uv_loop_t* loop;
+  size_t i;
+  int r;
+
+  file_data = malloc(FILE_SIZE);
+  received = malloc(TOTAL_BYTES);
+  ASSERT(file_data != NULL);
+  ASSERT(received != NULL);
+
+  for (i = 0; i < FILE_SIZE; i++) {
+    file_data[i] = (char) (i * 7 + (i >> 13));
+  }
+
+  unlink("test_file");
+  file_fd = open("test_file", O_RDWR | O_CREAT | O_TRUNC, S_IWRITE | S_IREAD);
+  ASSERT(file_fd != -1);
+  ASSERT(write(file_fd, file_data, FILE_SIZE) == FILE_SIZE);
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, addr));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req, &client, addr, connect_cb));
+
+  r = uv_run(loop);
+  ASSERT(r == 0);
+
+  ASSERT(write_cb_called == 4);
+  ASSERT(write_cb_order[0] == 0);
+  ASSERT(write_cb_order[1] == 1);
+  ASSERT(write_cb_order[2] == 2);
+  ASSERT(write_cb_order[3] == 3);
+  ASSERT(shutdown_cb_called == 1);
+  ASSERT(eof_seen == 1);
+  ASSERT(close_cb_called == 3);
+
+  ASSERT(received_len == TOTAL_BYTES);
+  ASSERT(memcmp(received, HEAD, 4) == 0);
+  ASSERT(memcmp(received + 4, file_data + FILE_OFFSET,
+      FILE_SIZE - FILE_OFFSET) == 0);
+  ASSERT(memcmp(received + TOTAL_BYTES - 4, TAIL, 4) == 0);
+
+  /* The file position is left alone. */
+  ASSERT(lseek(file_fd, 0, SEEK_CUR) == FILE_SIZE);
+
+  close(file_fd);
+  unlink("test_file");
+  free(file_data);
+  free(received);
+
+  return 0;
+}
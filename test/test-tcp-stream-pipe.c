@@ -0,0 +1,263 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * c1 <-> a ==pipe==> b <-> c2, plus the reverse pipe from b to a. Each
+ * client sends a pattern, the other one must receive exactly that.
+ */
+#define HELLO       "HELLO"
+#define DATA_SIZE   (16 * 1024 * 1024)
+
+typedef struct {
+  uv_tcp_t tcp;
+  uv_connect_t connect_req;
+  uv_write_t write_req;
+  uv_shutdown_t shutdown_req;
+  char* expect;
+  size_t expect_len;
+  size_t received;
+  int eof;
+} client_t;
+
+static uv_loop_t* loop;
+static uv_tcp_t server_a;
+static uv_tcp_t server_b;
+static uv_tcp_t conn_a;
+static uv_tcp_t conn_b;
+static client_t c1;
+static client_t c2;
+static uv_stream_pipe_t pipe_ab;
+static uv_stream_pipe_t pipe_ba;
+static uv_write_t hello_req;
+static uv_shutdown_t shutdown_a;
+static uv_shutdown_t shutdown_b;
+static uv_timer_t read_timer;
+
+static char* data_ab; /* HELLO followed by what c1 sends */
+static char* data_ba;
+static int accepted;
+static int connected;
+static int pipe_cb_called;
+static int pipe_ab_done;
+static int shutdown_cb_called;
+static int close_cb_called;
+
+
+static uv_buf_t alloc_cb(uv_handle_t* handle, size_t size) {
+  return uv_buf_init(malloc(size), size);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void client_read_cb(uv_stream_t* stream, ssize_t nread, uv_buf_t buf) {
+  client_t* c = (client_t*) stream;
+
+  if (nread < 0) {
+    ASSERT(uv_last_error(loop).code == UV_EOF);
+    ASSERT(c->received == c->expect_len);
+    c->eof++;
+    free(buf.base);
+
+    /* Both pipes are done once both clients saw EOF. */
+    if (c1.eof && c2.eof) {
+      uv_close((uv_handle_t*) &c1.tcp, close_cb);
+      uv_close((uv_handle_t*) &c2.tcp, close_cb);
+      uv_close((uv_handle_t*) &conn_a, close_cb);
+      uv_close((uv_handle_t*) &conn_b, close_cb);
+      uv_close((uv_handle_t*) &server_a, close_cb);
+      uv_close((uv_handle_t*) &server_b, close_cb);
+    }
+    return;
+  }
+
+  ASSERT(c->received + nread <= c->expect_len);
+  ASSERT(memcmp(c->expect + c->received, buf.base, nread) == 0);
+  c->received += nread;
+  free(buf.base);
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  shutdown_cb_called++;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void pipe_cb(uv_stream_pipe_t* req, int status) {
+  ASSERT(status == 0);
+  pipe_cb_called++;
+
+  /* src hit EOF, pass it on. */
+  if (req == &pipe_ab) {
+    ASSERT(req->nbytes == DATA_SIZE);
+    pipe_ab_done = 1;
+    ASSERT(0 == uv_shutdown(&shutdown_b, req->dst, shutdown_cb));
+  } else {
+    ASSERT(req->nbytes == DATA_SIZE / 2);
+    ASSERT(0 == uv_shutdown(&shutdown_a, req->dst, shutdown_cb));
+  }
+}
+
+
+static void read_timer_cb(uv_timer_t* handle, int status) {
+  /* Nobody read c2 so far, the pipe must have stalled, not buffered. */
+  ASSERT(pipe_ab_done == 0);
+  ASSERT(pipe_ab.nbytes < DATA_SIZE);
+  ASSERT(conn_b.io.write_queue_size == 0);
+  ASSERT(0 == uv_read_start((uv_stream_t*) &c2.tcp, alloc_cb,
+      client_read_cb));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void maybe_start(void) {
+  uv_buf_t buf;
+
+  if (accepted < 2 || connected < 2) {
+    return;
+  }
+
+  /* Queued before the pipe, so it must arrive first. */
+  buf = uv_buf_init(HELLO, 5);
+  ASSERT(0 == uv_write(&hello_req, (uv_stream_t*) &conn_b, &buf, 1,
+      write_cb));
+
+  ASSERT(0 == uv_stream_pipe(&pipe_ab, (uv_stream_t*) &conn_a,
+      (uv_stream_t*) &conn_b, pipe_cb));
+  ASSERT(0 == uv_stream_pipe(&pipe_ba, (uv_stream_t*) &conn_b,
+      (uv_stream_t*) &conn_a, pipe_cb));
+
+  /* Both ends are taken now. */
+  ASSERT(-1 == uv_stream_pipe(&pipe_ab, (uv_stream_t*) &conn_a,
+      (uv_stream_t*) &conn_b, pipe_cb));
+  ASSERT(uv_last_error(loop).code == UV_EBUSY);
+  ASSERT(-1 == uv_read_start((uv_stream_t*) &conn_a, alloc_cb,
+      client_read_cb));
+
+  buf = uv_buf_init(data_ab + 5, DATA_SIZE);
+  ASSERT(0 == uv_write(&c1.write_req, (uv_stream_t*) &c1.tcp, &buf, 1,
+      write_cb));
+  ASSERT(0 == uv_shutdown(&c1.shutdown_req, (uv_stream_t*) &c1.tcp,
+      shutdown_cb));
+
+  buf = uv_buf_init(data_ba, DATA_SIZE / 2);
+  ASSERT(0 == uv_write(&c2.write_req, (uv_stream_t*) &c2.tcp, &buf, 1,
+      write_cb));
+  ASSERT(0 == uv_shutdown(&c2.shutdown_req, (uv_stream_t*) &c2.tcp,
+      shutdown_cb));
+
+  ASSERT(0 == uv_read_start((uv_stream_t*) &c1.tcp, alloc_cb,
+      client_read_cb));
+
+  ASSERT(0 == uv_timer_init(loop, &read_timer));
+  ASSERT(0 == uv_timer_start(&read_timer, read_timer_cb, 100, 0));
+}
+
+
+static void connection_cb(uv_stream_t* server, int status) {
+  uv_tcp_t* conn = (server == (uv_stream_t*) &server_a) ? &conn_a : &conn_b;
+
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(loop, conn));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) conn));
+  accepted++;
+  maybe_start();
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT(status == 0);
+  connected++;
+  maybe_start();
+}
+
+
+static void start_server(uv_tcp_t* server, int port) {
+  ASSERT(0 == uv_tcp_init(loop, server));
+  ASSERT(0 == uv_tcp_bind(server, uv_ip4_addr("127.0.0.1", port)));
+  ASSERT(0 == uv_listen((uv_stream_t*) server, 128, connection_cb));
+}
+
+
+static void start_client(client_t* c, int port) {
+  ASSERT(0 == uv_tcp_init(loop, &c->tcp));
+  ASSERT(0 == uv_tcp_connect(&c->connect_req, &c->tcp,
+      uv_ip4_addr("127.0.0.1", port), connect_cb));
+}
+
+
+TEST_IMPL(tcp_stream_pipe) {
+  size_t i;
+
+  loop = uv_default_loop();
+
+  data_ab = malloc(5 + DATA_SIZE);
+  data_ba = malloc(DATA_SIZE / 2);
+  ASSERT(data_ab != NULL);
+  ASSERT(data_ba != NULL);
+
+  memcpy(data_ab, HELLO, 5);
+  for (i = 0; i < DATA_SIZE; i++) {
+    data_ab[5 + i] = (char) (i * 13 + (i >> 11));
+  }
+  for (i = 0; i < DATA_SIZE / 2; i++) {
+    data_ba[i] = (char) (i * 7 + (i >> 9));
+  }
+
+  c2.expect = data_ab;
+  c2.expect_len = 5 + DATA_SIZE;
+  c1.expect = data_ba;
+  c1.expect_len = DATA_SIZE / 2;
+
+  start_server(&server_a, TEST_PORT);
+  start_server(&server_b, TEST_PORT_2);
+  start_client(&c1, TEST_PORT);
+  start_client(&c2, TEST_PORT_2);
+
+  ASSERT(0 == uv_run(loop));
+
+  ASSERT(pipe_cb_called == 2);
+  ASSERT(c1.eof == 1);
+  ASSERT(c2.eof == 1);
+  ASSERT(shutdown_cb_called == 4);
+  ASSERT(close_cb_called == 7);
+
+  free(data_ab);
+  free(data_ba);
+
+  return 0;
+}
@@ -0,0 +1,185 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define CHUNK_SIZE        (1024 * 1024)
+#define CHUNKS            32
+#define HIGH_WATERMARK    (4 * CHUNK_SIZE)
+#define LOW_WATERMARK     (1 * CHUNK_SIZE)
+
+
+static char* send_buffer;
+
+static uv_tcp_t client;
+static uv_connect_t connect_req;
+static uv_shutdown_t shutdown_req;
+static uv_write_t write_reqs[CHUNKS];
+
+static int chunks_written = 0;
+static int write_cb_called = 0;
+static int pause_cb_called = 0;
+static int drain_cb_called = 0;
+static int shutdown_cb_called = 0;
+static int close_cb_called = 0;
+static int paused = 0;
+static size_t bytes_received = 0;
+
+
+static void write_more(uv_stream_t* stream);
+
+
+static uv_buf_t alloc_cb(uv_handle_t* handle, size_t size) {
+  uv_buf_t buf;
+  buf.base = (char*)malloc(size);
+  buf.len = size;
+  return buf;
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  ASSERT(handle == (uv_handle_t*)&client);
+  close_cb_called++;
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(req == &shutdown_req);
+  ASSERT(status == 0);
+  ASSERT(client.io.write_queue_size == 0);
+  shutdown_cb_called++;
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, uv_buf_t buf) {
+  if (nread < 0) {
+    ASSERT(uv_last_error(uv_default_loop()).code == UV_EOF);
+    free(buf.base);
+    uv_close((uv_handle_t*)stream, close_cb);
+    return;
+  }
+
+  bytes_received += nread;
+  free(buf.base);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  write_cb_called++;
+}
+
+
+static void pause_cb(uv_stream_t* stream) {
+  ASSERT(stream == (uv_stream_t*)&client);
+  ASSERT(!paused);
+  ASSERT(stream->io.write_queue_size >= HIGH_WATERMARK);
+  paused = 1;
+  pause_cb_called++;
+}
+
+
+static void drain_cb(uv_stream_t* stream) {
+  ASSERT(stream == (uv_stream_t*)&client);
+  ASSERT(paused);
+  ASSERT(stream->io.write_queue_size <= LOW_WATERMARK);
+  paused = 0;
+  drain_cb_called++;
+
+  write_more(stream);
+}
+
+
+/* Writes chunks until the stream tells us to back off. */
+static void write_more(uv_stream_t* stream) {
+  uv_buf_t buf;
+  int r;
+
+  while (!paused && chunks_written < CHUNKS) {
+    buf = uv_buf_init(send_buffer, CHUNK_SIZE);
+    r = uv_write(&write_reqs[chunks_written], stream, &buf, 1, write_cb);
+    ASSERT(r == 0);
+    chunks_written++;
+  }
+
+  if (chunks_written == CHUNKS && !paused) {
+    r = uv_shutdown(&shutdown_req, stream, shutdown_cb);
+    ASSERT(r == 0);
+  }
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_stream_t* stream;
+  int r;
+
+  ASSERT(req == &connect_req);
+  ASSERT(status == 0);
+
+  stream = req->handle;
+
+  r = uv_write_watermarks(stream, HIGH_WATERMARK, LOW_WATERMARK, pause_cb,
+      drain_cb);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(uv_default_loop()).code == UV_EINVAL);
+
+  r = uv_write_watermarks(stream, LOW_WATERMARK, HIGH_WATERMARK, pause_cb,
+      drain_cb);
+  ASSERT(r == 0);
+
+  r = uv_read_start(stream, alloc_cb, read_cb);
+  ASSERT(r == 0);
+
+  write_more(stream);
+}
+
+
+TEST_IMPL(tcp_write_watermarks) {
+  struct sockaddr_in addr = uv_ip4_addr("127.0.0.1", TEST_PORT);
+  int r;
+
+  send_buffer = calloc(1, CHUNK_SIZE);
+  ASSERT(send_buffer != NULL);
+
+  r = uv_tcp_init(uv_default_loop(), &client);
+  ASSERT(r == 0);
+
+  r = uv_tcp_connect(&connect_req, &client, addr, connect_cb);
+  ASSERT(r == 0);
+
+  uv_run(uv_default_loop());
+
+  ASSERT(chunks_written == CHUNKS);
+  ASSERT(write_cb_called == CHUNKS);
+  ASSERT(pause_cb_called > 0);
+  ASSERT(drain_cb_called == pause_cb_called);
+  ASSERT(shutdown_cb_called == 1);
+  ASSERT(close_cb_called == 1);
+  ASSERT(bytes_received == (size_t)CHUNKS * CHUNK_SIZE);
+
+  free(send_buffer);
+
+  return 0;
+}
@@ -0,0 +1,223 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/* Both thread pools get saturated with blocking requests first so that
+ * everything submitted after them is guaranteed to still be queued.
+ */
+#define NUM_BLOCKERS 4 /* UV_THREADPOOL_SIZE and libeio's default */
+#define NUM_TARGETS 8
+
+static uv_work_t blocker_reqs[NUM_BLOCKERS];
+static uv_work_t work_targets[NUM_TARGETS];
+static uv_fs_t fs_blockers[NUM_BLOCKERS];
+static uv_fs_t fs_targets[NUM_TARGETS];
+static uv_getaddrinfo_t getaddrinfo_target;
+
+static volatile int blockers_started;
+static volatile int blockers_released;
+static int target_work_cb_called;
+static int blocker_done_cb_called;
+static int target_done_cb_called;
+static int getaddrinfo_cb_called;
+static int fs_blocker_cb_called;
+static int fs_target_cb_called;
+static int pipe_fds[2];
+static char pipe_buf[NUM_BLOCKERS];
+
+
+static void blocker_work_cb(uv_work_t* req) {
+  __sync_fetch_and_add(&blockers_started, 1);
+  while (!blockers_released) {
+    uv_sleep(1);
+  }
+}
+
+
+static void blocker_done_cb(uv_work_t* req) {
+  ASSERT(uv_last_error(req->loop).code == UV_OK);
+  blocker_done_cb_called++;
+}
+
+
+static void target_work_cb(uv_work_t* req) {
+  target_work_cb_called++;
+}
+
+
+static void target_done_cb(uv_work_t* req) {
+  ASSERT(uv_last_error(req->loop).code == UV_ECANCELED);
+  target_done_cb_called++;
+}
+
+
+static void getaddrinfo_cb(uv_getaddrinfo_t* req,
+                           int status,
+                           struct addrinfo* res) {
+  ASSERT(status == -1);
+  ASSERT(res == NULL);
+  ASSERT(uv_last_error(req->loop).code == UV_ECANCELED);
+  getaddrinfo_cb_called++;
+}
+
+
+TEST_IMPL(threadpool_cancel_work) {
+  uv_loop_t* loop;
+  int i;
+  int r;
+
+  setenv("UV_THREADPOOL_SIZE", "4", 1);
+  loop = uv_default_loop();
+
+  /* Let the blockers take every thread, DNS included. */
+  r = uv_lane_set_limit(loop, UV_LANE_WORK, 0);
+  ASSERT(r == 0);
+
+  for (i = 0; i < NUM_BLOCKERS; i++) {
+    r = uv_queue_work(loop, &blocker_reqs[i], blocker_work_cb,
+        blocker_done_cb);
+    ASSERT(r == 0);
+  }
+
+  while (blockers_started < NUM_BLOCKERS) {
+    uv_sleep(1);
+  }
+
+  for (i = 0; i < NUM_TARGETS; i++) {
+    r = uv_queue_work(loop, &work_targets[i], target_work_cb,
+        target_done_cb);
+    ASSERT(r == 0);
+  }
+
+  for (i = 0; i < NUM_TARGETS; i++) {
+    r = uv_cancel(loop, (uv_req_t*) &work_targets[i]);
+    ASSERT(r == 0);
+  }
+
+  r = uv_getaddrinfo(loop, &getaddrinfo_target, getaddrinfo_cb, "localhost",
+      NULL, NULL);
+  ASSERT(r == 0);
+  r = uv_cancel(loop, (uv_req_t*) &getaddrinfo_target);
+  ASSERT(r == 0);
+
+  /* Already running. */
+  r = uv_cancel(loop, (uv_req_t*) &blocker_reqs[0]);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBUSY);
+
+  /* Already cancelled. */
+  r = uv_cancel(loop, (uv_req_t*) &work_targets[0]);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EBUSY);
+
+  blockers_released = 1;
+
+  r = uv_run(loop);
+  ASSERT(r == 0);
+
+  ASSERT(target_work_cb_called == 0);
+  ASSERT(target_done_cb_called == NUM_TARGETS);
+  ASSERT(blocker_done_cb_called == NUM_BLOCKERS);
+  ASSERT(getaddrinfo_cb_called == 1);
+
+  /* Done, nothing to cancel any more. */
+  r = uv_cancel(loop, (uv_req_t*) &work_targets[0]);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+
+  r = uv_cancel(loop, (uv_req_t*) &getaddrinfo_target);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+
+  return 0;
+}
+
+
+static void fs_blocker_cb(uv_fs_t* req) {
+  ASSERT(req->result == 1);
+  uv_fs_req_cleanup(req);
+  fs_blocker_cb_called++;
+}
+
+
+static void fs_target_cb(uv_fs_t* req) {
+  ASSERT(req->result == -1);
+  ASSERT(req->errorno == UV_ECANCELED);
+  uv_fs_req_cleanup(req);
+  fs_target_cb_called++;
+}
+
+
+TEST_IMPL(threadpool_cancel_fs) {
+  uv_loop_t* loop;
+  uv_fs_t sync_req;
+  int i;
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(pipe(pipe_fds) == 0);
+
+  /* Reads from an empty pipe tie up every libeio thread. */
+  for (i = 0; i < NUM_BLOCKERS; i++) {
+    r = uv_fs_read(loop, &fs_blockers[i], pipe_fds[0], pipe_buf + i, 1, -1,
+        fs_blocker_cb);
+    ASSERT(r == 0);
+  }
+
+  for (i = 0; i < NUM_TARGETS; i++) {
+    r = uv_fs_stat(loop, &fs_targets[i], ".", fs_target_cb);
+    ASSERT(r == 0);
+    r = uv_cancel(loop, (uv_req_t*) &fs_targets[i]);
+    ASSERT(r == 0);
+  }
+
+  /* Synchronous requests are never in flight. */
+  r = uv_fs_stat(loop, &sync_req, ".", NULL);
+  ASSERT(r == 0);
+  r = uv_cancel(loop, (uv_req_t*) &sync_req);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+  uv_fs_req_cleanup(&sync_req);
+
+  ASSERT(write(pipe_fds[1], "abcd", NUM_BLOCKERS) == NUM_BLOCKERS);
+
+  r = uv_run(loop);
+  ASSERT(r == 0);
+
+  ASSERT(fs_blocker_cb_called == NUM_BLOCKERS);
+  ASSERT(fs_target_cb_called == NUM_TARGETS);
+
+  /* Finished requests can't be cancelled. */
+  r = uv_cancel(loop, (uv_req_t*) &fs_targets[0]);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+
+  return 0;
+}
@@ -22,6 +22,8 @@
 #include "uv.h"
 #include "task.h"
 
+#include <stdlib.h>
+
 static int work_cb_count;
 static int after_work_cb_count;
 static uv_work_t work_req;
@@ -55,3 +57,167 @@ TEST_IMPL(threadpool_queue_work_simple) {
 
   return 0;
 }
+
+
+#define MANY_WORK_REQS 10000
+
+static uv_work_t many_reqs[MANY_WORK_REQS];
+static int many_work_done[MANY_WORK_REQS];
+static int many_after_work_cb_count;
+
+
+static void many_work_cb(uv_work_t* req) {
+  __sync_fetch_and_add(&many_work_done[req - many_reqs], 1);
+}
+
+
+static void many_after_work_cb(uv_work_t* req) {
+  ASSERT(req->type == UV_WORK);
+  ASSERT(many_work_done[req - many_reqs] == 1);
+  many_after_work_cb_count++;
+}
+
+
+TEST_IMPL(threadpool_queue_work_many) {
+  int i;
+  int r;
+
+  for (i = 0; i < MANY_WORK_REQS; i++) {
+    r = uv_queue_work(uv_default_loop(), &many_reqs[i], many_work_cb,
+        many_after_work_cb);
+    ASSERT(r == 0);
+  }
+
+  uv_run(uv_default_loop());
+
+  ASSERT(many_after_work_cb_count == MANY_WORK_REQS);
+
+  return 0;
+}
+
+
+/* Lanes are unix-only for now. */
+#ifndef _WIN32
+
+#define LANE_WORK_REQS 32
+
+static uv_work_t lane_reqs[LANE_WORK_REQS];
+static volatile int lane_running;
+static volatile int lane_max_running;
+static int lane_after_work_cb_count;
+
+
+static void lane_work_cb(uv_work_t* req) {
+  int n;
+
+  n = __sync_add_and_fetch(&lane_running, 1);
+  if (n > lane_max_running) {
+    lane_max_running = n;
+  }
+
+  uv_sleep(1);
+  __sync_fetch_and_sub(&lane_running, 1);
+}
+
+
+static void lane_after_work_cb(uv_work_t* req) {
+  lane_after_work_cb_count++;
+}
+
+
+TEST_IMPL(threadpool_lane_limit) {
+  uv_loop_t* loop;
+  int i;
+  int r;
+
+  loop = uv_default_loop();
+
+  r = uv_lane_set_limit(loop, UV_LANE_WORK, 2);
+  ASSERT(r == 0);
+
+  for (i = 0; i < LANE_WORK_REQS; i++) {
+    r = uv_queue_work(loop, &lane_reqs[i], lane_work_cb, lane_after_work_cb);
+    ASSERT(r == 0);
+  }
+
+  /* Parked in the lane, so the cancellation is certain. */
+  r = uv_cancel(loop, (uv_req_t*) &lane_reqs[LANE_WORK_REQS - 1]);
+  ASSERT(r == 0);
+
+  uv_run(loop);
+
+  ASSERT(lane_after_work_cb_count == LANE_WORK_REQS);
+  ASSERT(lane_max_running <= 2);
+  ASSERT(lane_max_running > 0);
+
+  r = uv_lane_set_limit(loop, (uv_lane_t) 42, 1);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_EINVAL);
+
+  /* libeio's pool is shared by all loops. */
+  r = uv_lane_set_limit(loop, UV_LANE_FS, 1);
+  ASSERT(r == -1);
+  ASSERT(uv_last_error(loop).code == UV_ENOTSUP);
+
+  return 0;
+}
+
+
+#define RESERVE_POOL_SIZE 4
+
+static uv_work_t reserve_reqs[RESERVE_POOL_SIZE];
+static uv_getaddrinfo_t reserve_getaddrinfo_req;
+static volatile int reserve_released;
+static int reserve_after_work_cb_count;
+static int reserve_getaddrinfo_cb_count;
+
+
+static void reserve_work_cb(uv_work_t* req) {
+  while (!reserve_released) {
+    uv_sleep(1);
+  }
+}
+
+
+static void reserve_after_work_cb(uv_work_t* req) {
+  ASSERT(reserve_getaddrinfo_cb_count == 1);
+  reserve_after_work_cb_count++;
+}
+
+
+static void reserve_getaddrinfo_cb(uv_getaddrinfo_t* req, int status,
+    struct addrinfo* res) {
+  reserve_getaddrinfo_cb_count++;
+  reserve_released = 1;
+  uv_freeaddrinfo(res);
+}
+
+
+/* As much blocking work as there are threads doesn't hold up DNS. */
+TEST_IMPL(threadpool_dns_reserve) {
+  uv_loop_t* loop;
+  int i;
+  int r;
+
+  setenv("UV_THREADPOOL_SIZE", "4", 1);
+  loop = uv_default_loop();
+
+  for (i = 0; i < RESERVE_POOL_SIZE; i++) {
+    r = uv_queue_work(loop, &reserve_reqs[i], reserve_work_cb,
+        reserve_after_work_cb);
+    ASSERT(r == 0);
+  }
+
+  r = uv_getaddrinfo(loop, &reserve_getaddrinfo_req, reserve_getaddrinfo_cb,
+      "localhost", NULL, NULL);
+  ASSERT(r == 0);
+
+  uv_run(loop);
+
+  ASSERT(reserve_getaddrinfo_cb_count == 1);
+  ASSERT(reserve_after_work_cb_count == RESERVE_POOL_SIZE);
+
+  return 0;
+}
+
+#endif
@@ -6,7 +6,9 @@
           '_LARGEFILE_SOURCE',
           '_FILE_OFFSET_BITS=64',
           '_GNU_SOURCE',
-          'EIO_STACKSIZE=262144'
+          'EIO_STACKSIZE=262144',
+          # Finish cancelled requests too, see config-unix.mk.
+          'EIO_FINISH(req)=((req)->finish ? (req)->finish (req) : 0)',
         ],
         'conditions': [
           ['OS=="solaris"', {
@@ -45,6 +47,7 @@
         'src/uv-common.c',
         'src/uv-common.h',
         'src/ares/ares_cancel.c',
+        'src/ares/ares__buf_pool.c',
         'src/ares/ares__close_sockets.c',
         'src/ares/ares_data.c',
         'src/ares/ares_data.h',
@@ -59,6 +62,7 @@
         'src/ares/ares_gethostbyaddr.c',
         'src/ares/ares_gethostbyname.c',
         'src/ares/ares__get_hostent.c',
+        'src/ares/ares__hosts_file.c',
         'src/ares/ares_getnameinfo.c',
         'src/ares/ares_getopt.c',
         'src/ares/ares_getopt.h',
@@ -74,6 +78,7 @@
         'src/ares/ares_nowarn.h',
         'src/ares/ares_options.c',
         'src/ares/ares_parse_aaaa_reply.c',
+        'src/ares/ares_parse_hostent_reply.c',
         'src/ares/ares_parse_a_reply.c',
         'src/ares/ares_parse_mx_reply.c',
         'src/ares/ares_parse_ns_reply.c',
@@ -176,14 +181,17 @@
             'src/unix/core.c',
             'src/unix/io.c',
             'src/unix/io.h',
+            'src/unix/post.c',
             'src/unix/uv-eio.c',
             'src/unix/uv-eio.h',
             'src/unix/fs.c',
+            'src/unix/getaddrinfo.c',
             'src/unix/udp.c',
             'src/unix/tcp.c',
             'src/unix/pipe.c',
             'src/unix/tty.c',
             'src/unix/stream.c',
+            'src/unix/threadpool.c',
             'src/unix/cares.c',
             'src/unix/dl.c',
             'src/unix/error.c',
@@ -331,6 +339,12 @@
           'sources': [
             'test/runner-unix.c',
             'test/runner-unix.h',
+            'test/test-tcp-write-watermarks.c',
+            'test/test-post.c',
+            'test/test-threadpool-cancel.c',
+            'test/test-tcp-connect-name.c',
+            'test/test-tcp-sendfile.c',
+            'test/test-tcp-stream-pipe.c',
           ],
         }],
         [ 'OS=="solaris"', { # make test-fs.c compile, needs _POSIX_C_SOURCE
@@ -358,9 +372,11 @@
         'test/benchmark-ping-pongs.c',
         'test/benchmark-pound.c',
         'test/benchmark-pump.c',
+        'test/benchmark-resolver.c',
         'test/benchmark-sizes.c',
         'test/benchmark-spawn.c',
         'test/benchmark-tcp-write-batch.c',
+        'test/benchmark-threadpool.c',
         'test/benchmark-udp-packet-storm.c',
         'test/dns-server.c',
         'test/echo-server.c',
@@ -382,6 +398,8 @@
           'sources': [
             'test/runner-unix.c',
             'test/runner-unix.h',
+            'test/benchmark-post.c',
+            'test/benchmark-fs-walk.c',
           ]
         }]
       ],